@@ -23,9 +23,18 @@
 #include <cstdint>
 
 #include <glHelpers.h>
+#include <glslCulling.h>
+#include <glslFastMath.h>
+#include <meshOptimizer.h>
 
 using namespace glsl_math;
 
+// The window is not resizable, so the projection is known at compile time.
+static constexpr int windowWidth = 1280;
+static constexpr int windowHeight = 720;
+static constexpr mat4 projection =
+    ctPerspectiveProjection(90.0, windowWidth/static_cast<double>(windowHeight), 0.1, 100.0);
+
 static void errorCallback(int error, const char* description)
 {
     fprintf(stderr, "Error: %s\n", description);
@@ -85,24 +94,51 @@ struct Workspace
     std::vector<float> vertexData;
 };
 
-void genGridIndices(Workspace& wks, GLMesh& mesh, uint32_t res)
+// Quads between every step-th grid line (the last ones stretched to the
+// edge), so coarser levels of detail reuse the vertices of the full grid.
+void appendGridQuads(std::vector<uint32_t>& indices, uint32_t res, uint32_t step)
 {
-    wks.indexData.resize(res * res * 6);
-    for (uint32_t k = 0, vi = 0, y = 0; y < res; ++y, ++vi)
+    std::vector<uint32_t> lines;
+    for (uint32_t i = 0; i < res; i += step)
+        lines.push_back(i);
+    lines.push_back(res);
+    for (size_t y = 0; y + 1 < lines.size(); ++y)
     {
-        for (uint32_t x = 0; x < res; ++x, ++vi, k += 6)
+        for (size_t x = 0; x + 1 < lines.size(); ++x)
         {
-            wks.indexData[k] = vi;
-            wks.indexData[k + 1] = vi + 1;
-            wks.indexData[k + 2] = vi + res + 1;
-            wks.indexData[k + 3] = vi + 1;
-            wks.indexData[k + 4] = vi + res + 2;
-            wks.indexData[k + 5] = vi + res + 1;
+            const uint32_t v00 = lines[y] * (res + 1) + lines[x], v01 = lines[y] * (res + 1) + lines[x + 1];
+            const uint32_t v10 = lines[y + 1] * (res + 1) + lines[x], v11 = lines[y + 1] * (res + 1) + lines[x + 1];
+            const uint32_t quad[6] = { v00, v01, v10, v01, v11, v10 };
+            indices.insert(indices.end(), quad, quad + 6);
         }
     }
+}
+
+void genGridIndices(Workspace& wks, GLMesh& mesh, uint32_t res)
+{
+    const GLuint vertexCount = (res + 1) * (res + 1);
+    std::vector<GLMesh::Lod> lods;
+    wks.indexData.clear();
+    for (uint32_t step = 1; step <= res / 8; step *= 2)
+    {
+        const GLuint first = static_cast<GLuint>(wks.indexData.size());
+        appendGridQuads(wks.indexData, res, step);
+        const GLuint count = static_cast<GLuint>(wks.indexData.size()) - first;
+        // Row-major quads miss the vertex cache on every new row.
+        const float acmr = vertexCacheAcmr(&wks.indexData[first], count, vertexCount);
+        optimizeVertexCache(&wks.indexData[first], &wks.indexData[first], count, vertexCount);
+        if (step == 1)
+            printf("grid ACMR %.3f -> %.3f\n", acmr, vertexCacheAcmr(&wks.indexData[first], count, vertexCount));
+        // The second derivative of the waves (see genGridVertices) stays
+        // under .3 * 128 per unit of u or v squared, so over cells of size
+        // h linear interpolation is off by h^2 / 8 times that at most.
+        const float h = (step > 1) ? step / static_cast<float>(res) : 0.0f;
+        lods.push_back(GLMesh::Lod{ first, count, 4.8f * h * h });
+    }
     {
         const bool autoUnbind = mesh.bind();
         mesh.updateIndices(wks.indexData.data(), wks.indexData.size());
+        mesh.lods = lods;
         if (autoUnbind)
             mesh.unbind();
     }
@@ -111,37 +147,50 @@ void genGridIndices(Workspace& wks, GLMesh& mesh, uint32_t res)
 void genGridVertices(Workspace& wks, GLMesh& mesh, uint32_t res, float time)
 {
     uint32_t stride = 4 + 4 + 3 + 4;
-    wks.vertexData.resize((res + 1) * (res + 1) * stride);
+    const uint32_t count = (res + 1) * (res + 1);
+    // A streaming mesh is written in place, others through wks.vertexData.
+    float* data = nullptr;
+#if GLPersistentMappingSupported
+    if (mesh.vertexStream.mapped)
+        data = mesh.mapVertices(GLMesh::PTNC, count);
+#endif
+    if (!data)
+    {
+        wks.vertexData.resize(count * stride);
+        data = wks.vertexData.data();
+    }
     for (uint32_t k = 0, vi = 0, y = 0; y <= res; ++y, ++vi)
     {
         const float v = y / static_cast<float>(res);
+        const float phase = fast::sin(v*8.f + time);
         for (uint32_t x = 0; x <= res; ++x, ++vi, k += stride)
         {
             const float u = x / static_cast<float>(res);
 
-            wks.vertexData[k] = u * 2 - 1;
-            wks.vertexData[k + 1] = v * 2 - 1;
-            wks.vertexData[k + 2] = sin(u*8.f + sin(v*8.f + time)) * .3f;
-            wks.vertexData[k + 3] = 1;
+            data[k] = u * 2 - 1;
+            data[k + 1] = v * 2 - 1;
+            data[k + 2] = fast::sin(u*8.f + phase) * .3f;
+            data[k + 3] = 1;
 
-            wks.vertexData[k + 4] = u;
-            wks.vertexData[k + 5] = v;
-            wks.vertexData[k + 6] = 0;
-            wks.vertexData[k + 7] = 1;
+            data[k + 4] = u;
+            data[k + 5] = v;
+            data[k + 6] = 0;
+            data[k + 7] = 1;
 
-            wks.vertexData[k + 8] = 0;
-            wks.vertexData[k + 9] = 0;
-            wks.vertexData[k + 10] = 1;
+            data[k + 8] = 0;
+            data[k + 9] = 0;
+            data[k + 10] = 1;
 
-            wks.vertexData[k + 11] = 1;
-            wks.vertexData[k + 12] = 1;
-            wks.vertexData[k + 13] = 1;
-            wks.vertexData[k + 14] = 1;
+            data[k + 11] = 1;
+            data[k + 12] = 1;
+            data[k + 13] = 1;
+            data[k + 14] = 1;
         }
     }
+    if (data == wks.vertexData.data())
     {
         const bool autoUnbind = mesh.bind();
-        mesh.updateVertices(GLMesh::PTNC, wks.vertexData.data(), wks.vertexData.size());
+        mesh.updateVertices(GLMesh::PTNC, wks.vertexData.data(), count);
         if (autoUnbind)
             mesh.unbind();
     }
@@ -315,7 +364,7 @@ int main(int argc, char** argv)
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
 
-    window = glfwCreateWindow(1280, 720, "GLFW OpenGL3 Test", NULL, NULL);
+    window = glfwCreateWindow(windowWidth, windowHeight, "GLFW OpenGL3 Test", NULL, NULL);
     if (!window)
     {
         glfwTerminate();
@@ -433,6 +482,10 @@ int main(int argc, char** argv)
     #define UseIndirect 0
     GLTexture texture = genTextureChecker(128, 128, 32, 32, false);
     Workspace wks;
+  #if GLPersistentMappingSupported
+    // The vertices change every frame, the indices never.
+    grid_mesh.initStreaming(GLMesh::PTNC, grid_vertex_count, 0);
+  #endif
     genGridIndices(wks, grid_mesh, grid_res);
 #endif
 
@@ -445,8 +498,6 @@ int main(int argc, char** argv)
 
     int frameWidth, frameHeight;
     glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
-    const mat4 projection =
-        perspectiveProjection(90.0, frameWidth/static_cast<double>(frameHeight), 0.1, 100.0);
     setProjectionMatrix(shader_program, projection);
 
     // Create mesh data.
@@ -482,7 +533,8 @@ int main(int argc, char** argv)
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        setModelViewMatrix(shader_program, modelView, true);
+        // only rotations and translations: the normal matrix is its 3x3 part
+        setModelViewMatrix(shader_program, transform(modelView, transform::Rigid), true);
 
 #if GLComputeSupported
     #if UseIndirect
@@ -541,8 +593,13 @@ int main(int argc, char** argv)
         genGridVertices(wks, grid_mesh, grid_res, curr_time);
 #endif
 
+        // The grid spans [-1, 1] x [-1, 1] with waves of amplitude .3.
+        const bool gridVisible = isVisible(frustum(projection * modelView),
+            aabb(vec3(-1, -1, -.3), vec3(1, 1, .3)));
+
         glUseProgram(shader_program);
 #if UseIndirect
+        if (gridVisible)
         {
             const bool autoUnbind = grid_mesh.bind();
             glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cmdbo);
@@ -552,7 +609,9 @@ int main(int argc, char** argv)
                 grid_mesh.unbind();
         }
 #else
-        grid_mesh.render();
+        // Coarser grids (without the compute path) when the waves are far.
+        if (gridVisible)
+            grid_mesh.renderLod(grid_mesh.selectLod(projection, modelView, vec3(0), 1.45, frameHeight));
 #endif
 
         // Display and process events through callbacks.
@@ -0,0 +1,178 @@
+// Accuracy and throughput of glslFastMath.h against libm
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <chrono>
+#include <vector>
+
+#include <glslFastMath.h>
+
+using namespace glsl_math;
+
+static const size_t SampleCount = 1 << 16;
+static const int Repeats = 20;
+
+struct Range
+{
+    double lo, hi;
+    bool logarithmic;
+};
+
+static std::vector<float> samples(const Range& range, uint32_t seed)
+{
+    std::vector<float> ret(SampleCount);
+    for (size_t i = 0; i < SampleCount; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const double t = (seed >> 8) / 16777216.0;
+        ret[i] = static_cast<float>(range.logarithmic
+            ? range.lo * ::pow(range.hi / range.lo, t)
+            : range.lo + (range.hi - range.lo) * t);
+    }
+    return ret;
+}
+
+// Best time of Repeats runs in nanoseconds per element.
+template <typename F>
+static double timeNs(F f)
+{
+    double best = 1e30;
+    for (int k = 0; k < Repeats; ++k)
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        f();
+        const auto t1 = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        best = (ns < best) ? ns : best;
+    }
+    return best / SampleCount;
+}
+
+static float sink;
+
+template <typename P>
+static P load(const float* p) { return P::load(p); }
+template <>
+float load<float>(const float* p) { return *p; }
+
+template <typename P>
+static void store(const P& v, float* p) { v.store(p); }
+static void store(float v, float* p) { *p = v; }
+
+// Errors are relative, or absolute for |reference| < 1 unless relative is set.
+struct Report
+{
+    const char* name;
+    Range x, y;
+    bool relative;
+    double (*reference)(double, double);
+};
+
+// Prints the maximum error and the throughput of f applied to the samples
+// in steps of P (float, floatx4 or floatx8); returns ns per element.
+template <typename P, typename F>
+static double measure(const Report& report, const std::vector<float>& x, const std::vector<float>& y,
+    const char* type, const char* tier, double libmNs, F f)
+{
+    constexpr size_t L = sizeof(P) / sizeof(float);
+    std::vector<float> out(x.size());
+    const double ns = timeNs([&]() {
+        for (size_t i = 0; i < x.size(); i += L)
+            store(f(load<P>(&x[i]), load<P>(&y[i])), &out[i]);
+        sink += out[0];
+    });
+    double maxErr = 0;
+    for (size_t i = 0; i < x.size(); ++i)
+    {
+        const double r = report.reference(x[i], y[i]);
+        const double e = ::fabs(out[i] - r) / (report.relative ? ::fabs(r) : max(1.0, ::fabs(r)));
+        maxErr = (e > maxErr) ? e : maxErr;
+    }
+    printf("%-6s %-8s %-7s %10.2e %8.2f %7.1fx\n", report.name, type, tier, maxErr, ns,
+        (libmNs > 0) ? libmNs / ns : 1.0);
+    return ns;
+}
+
+static double measureLibm(const Report& report, int index, const std::vector<float>& x, const std::vector<float>& y)
+{
+    const auto m = [&](float (*f)(float, float)) { return measure<float>(report, x, y, "float", "libm", 0, f); };
+    switch (index)
+    {
+    case 0: return m([](float x, float) { return sinf(x); });
+    case 1: return m([](float x, float) { return cosf(x); });
+    case 2: return m([](float x, float) { return acosf(x); });
+    case 3: return m([](float x, float) { return expf(x); });
+    case 4: return m([](float x, float) { return logf(x); });
+    case 5: return m([](float x, float y) { return powf(x, y); });
+    default: return m([](float x, float) { return 1 / sqrtf(x); });
+    }
+}
+
+template <typename P, fast::Precision Q>
+static void measureFast(const Report& report, int index, const std::vector<float>& x, const std::vector<float>& y,
+    const char* type, double libmNs)
+{
+    static const char* tiers[] = { "Low", "Medium", "High" };
+    const char* tier = tiers[Q];
+    switch (index)
+    {
+    case 0: measure<P>(report, x, y, type, tier, libmNs, [](const P& x, const P&) { return fast::sin<Q>(x); }); break;
+    case 1: measure<P>(report, x, y, type, tier, libmNs, [](const P& x, const P&) { return fast::cos<Q>(x); }); break;
+    case 2: measure<P>(report, x, y, type, tier, libmNs, [](const P& x, const P&) { return fast::acos<Q>(x); }); break;
+    case 3: measure<P>(report, x, y, type, tier, libmNs, [](const P& x, const P&) { return fast::exp<Q>(x); }); break;
+    case 4: measure<P>(report, x, y, type, tier, libmNs, [](const P& x, const P&) { return fast::log<Q>(x); }); break;
+    case 5: measure<P>(report, x, y, type, tier, libmNs, [](const P& x, const P& y) { return fast::pow<Q>(x, y); }); break;
+    default: measure<P>(report, x, y, type, tier, libmNs, [](const P& x, const P&) { return fast::rsqrt<Q>(x); }); break;
+    }
+}
+
+template <typename P>
+static void measureTiers(const Report& report, int index, const std::vector<float>& x, const std::vector<float>& y,
+    const char* type, double libmNs)
+{
+    measureFast<P, fast::Low>(report, index, x, y, type, libmNs);
+    measureFast<P, fast::Medium>(report, index, x, y, type, libmNs);
+    measureFast<P, fast::High>(report, index, x, y, type, libmNs);
+}
+
+int main(int argc, char** argv)
+{
+    const Report reports[] = {
+        { "sin", { -1e4, 1e4, false }, { 0, 0, false }, false, [](double x, double) { return ::sin(x); } },
+        { "cos", { -1e4, 1e4, false }, { 0, 0, false }, false, [](double x, double) { return ::cos(x); } },
+        { "acos", { -1, 1, false }, { 0, 0, false }, false, [](double x, double) { return ::acos(x); } },
+        { "exp", { -87.3, 88.3, false }, { 0, 0, false }, true, [](double x, double) { return ::exp(x); } },
+        { "log", { 1e-37, 1e37, true }, { 0, 0, false }, false, [](double x, double) { return ::log(x); } },
+        { "pow", { 1e-2, 1e2, true }, { -4, 4, false }, true, [](double x, double y) { return ::pow(x, y); } },
+        { "rsqrt", { 1e-30, 1e30, true }, { 0, 0, false }, true, [](double x, double) { return 1 / ::sqrt(x); } },
+    };
+
+    printf("%-6s %-8s %-7s %10s %8s %8s\n", "func", "type", "tier", "max err", "ns/elem", "vs libm");
+    for (int i = 0; i < 7; ++i)
+    {
+        const Report& report = reports[i];
+        const std::vector<float> x = samples(report.x, 1 + i);
+        const std::vector<float> y = samples(report.y, 100 + i);
+        const double libmNs = measureLibm(report, i, x, y);
+        measureTiers<float>(report, i, x, y, "float", libmNs);
+        measureTiers<floatx4>(report, i, x, y, "floatx4", libmNs);
+        measureTiers<floatx8>(report, i, x, y, "floatx8", libmNs);
+    }
+    return (sink == 12345.0f) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+// CPU/GPU noise consistency test
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Bakes fractal noise with GLNoiseBaker, reads the textures back and
+// compares them with fractal2dGrid/fractal3dGrid. Prints the largest
+// differences and exits with 1 when they are above tolerance. Needs a
+// GL 4.3 context only, e.g. Mesa llvmpipe without a GPU:
+//
+//   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./noiseTest
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <glHelpers.h>
+#include <fractalNoise.h>
+
+using namespace glsl_math;
+
+// The GPU may contract and round differently, and the gradients grow with
+// the frequency of the last octave.
+static const float ValueTolerance = 1e-3f;
+static const float GradientTolerance = 1e-2f;
+
+static void errorCallback(int error, const char* description)
+{
+    fprintf(stderr, "Error: %s\n", description);
+}
+
+#if GLComputeSupported
+struct Case
+{
+    const char* name;
+    FractalNoise f;
+};
+
+static std::vector<Case> cases()
+{
+    std::vector<Case> ret(3);
+    ret[0].name = "fBm";
+    ret[0].f.frequency = 0.05f;
+    ret[1].name = "ridged, warped";
+    ret[1].f.type = FractalNoise::Ridged;
+    ret[1].f.frequency = 0.03f;
+    ret[1].f.warp = 2.0f;
+    ret[2].name = "turbulence";
+    ret[2].f.type = FractalNoise::Turbulence;
+    ret[2].f.octaves = 4;
+    ret[2].f.frequency = 0.08f;
+    return ret;
+}
+
+// gpu holds n RGBA texels (value, gradient), grad components - 1 floats
+// per texel.
+static bool compare(const char* name, const float* gpu, const float* value, const float* grad,
+    size_t n, int components, bool gradients)
+{
+    float valueError = 0, gradError = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        valueError = fmaxf(valueError, fabsf(gpu[4 * i] - value[i]));
+        if (gradients)
+            for (int k = 0; k < components - 1; ++k)
+            {
+                const float g = grad[(components - 1) * i + k];
+                gradError = fmaxf(gradError, fabsf(gpu[4 * i + 1 + k] - g) / (1 + fabsf(g)));
+            }
+    }
+    const bool ok = valueError <= ValueTolerance && gradError <= GradientTolerance;
+    printf("%-32s value %.2e  gradient %.2e  %s\n", name, valueError, gradError, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static bool run()
+{
+    const PerlinNoise noise(5);
+    GLNoiseBaker baker(noise);
+    bool ok = true;
+
+    const GLuint w = 96, h = 64, d = 24;
+    std::vector<float> value(w * h * d), grad(3 * w * h * d), gpu(4 * w * h * d);
+    const vec3f origin(-17.5f, 4.25f, 130.0f), step(0.75f, 0.5f, 1.25f);
+
+    for (const Case& c : cases())
+    {
+        char name[64];
+        fractal2dGrid(noise, c.f, origin.x, origin.y, step.x, step.y, w, h, value.data(), grad.data());
+        for (GLuint internalFormat : { GL_R32F, GL_RGBA32F })
+        {
+            GLTexture texture(GL_TEXTURE_2D, (internalFormat == GL_R32F) ? GL_RED : GL_RGBA, internalFormat,
+                GL_FLOAT, GL_NEAREST, GL_NEAREST);
+            texture.setTexStorage2D(w, h, 1);
+            ok = baker.bake2D(texture, w, h, c.f, vec2f(origin.x, origin.y), vec2f(step.x, step.y)) && ok;
+            glBindTexture(GL_TEXTURE_2D, texture.texture);
+            std::fill(gpu.begin(), gpu.end(), 0.0f);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, gpu.data());
+            texture.destroy();
+            snprintf(name, sizeof(name), "2D %s%s", c.name, (internalFormat == GL_R32F) ? " r32f" : "");
+            ok = compare(name, gpu.data(), value.data(), grad.data(), w * h, 3, internalFormat != GL_R32F) && ok;
+        }
+
+        fractal3dGrid(noise, c.f, origin.x, origin.y, origin.z, step.x, step.y, step.z, w, h, d,
+            value.data(), grad.data());
+        GLTexture texture(GL_TEXTURE_3D, GL_RGBA, GL_RGBA32F, GL_FLOAT, GL_NEAREST, GL_NEAREST);
+        texture.setTexStorage3D(w, h, d, 1);
+        ok = baker.bake3D(texture, w, h, d, c.f, origin, step) && ok;
+        glBindTexture(GL_TEXTURE_3D, texture.texture);
+        glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_FLOAT, gpu.data());
+        texture.destroy();
+        snprintf(name, sizeof(name), "3D %s", c.name);
+        ok = compare(name, gpu.data(), value.data(), grad.data(), w * h * d, 4, true) && ok;
+    }
+
+    baker.destroy();
+    return ok && validateGL();
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    glfwSetErrorCallback(errorCallback);
+
+    if (!glfwInit())
+        exit(EXIT_FAILURE);
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "noiseTest", NULL, NULL);
+    if (!window)
+    {
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+
+#if GLComputeSupported
+    const bool ok = run();
+#else
+    printf("compute shaders not supported\n");
+    const bool ok = true;
+#endif
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,229 @@
+// Perlin noise and fractal sums of it, the same steps as PerlinNoise and
+// fractal2d/3d in utils (perlinNoise.cpp, fractalNoise.cpp), so a field
+// sampled here matches the CPU one up to float rounding.
+//
+// Shaders load it with
+//
+//   #include "perlinNoise.glsl"
+//
+// after their #version line (see FileBuffer::expandIncludes) and bind
+// PerlinNoise::permutation() (permutationSize bytes) as a shader storage
+// buffer at PerlinNoiseBinding.
+
+#ifndef PerlinNoiseBinding
+#define PerlinNoiseBinding 7
+#endif
+
+layout (std430, binding = PerlinNoiseBinding) readonly buffer PerlinNoisePermutation {
+  uint perlinPermutation[];
+};
+
+const int FractalFBm = 0;
+const int FractalRidged = 1;
+const int FractalTurbulence = 2;
+
+// Same fields as FractalNoise in fractalNoise.h.
+struct FractalNoise {
+  int type;
+  int octaves;
+  float frequency;
+  float lacunarity;
+  float gain;
+  float ridgeOffset;
+  float warp;
+  int warpOctaves;
+};
+
+// gradient vectors of fgrad()
+const vec3 perlinGradients[16] = vec3[](
+  vec3( 1, 1, 0), vec3(-1, 1, 0), vec3( 1,-1, 0), vec3(-1,-1, 0),
+  vec3( 1, 0, 1), vec3(-1, 0, 1), vec3( 1, 0,-1), vec3(-1, 0,-1),
+  vec3( 0, 1, 1), vec3( 0,-1, 1), vec3( 0, 1,-1), vec3( 0,-1,-1),
+  vec3( 1, 1, 0), vec3(-1, 1, 0), vec3( 0, 1,-1), vec3( 0,-1,-1));
+
+uint perlinPerm(uint i)
+{
+  return (perlinPermutation[i >> 2] >> ((i & 3u) << 3)) & 255u;
+}
+
+// floormod256 of integral p: the low byte of two's complement p.
+uint perlinFloorMod(float p)
+{
+  return uint(int(p)) & 255u;
+}
+
+// Corner value and gradient, (value, d/dx, d/dy[, d/dz]).
+vec3 perlinCorner(uint h, vec2 p)
+{
+  vec2 g = perlinGradients[h & 15u].xy;
+  return vec3(dot(g, p), g);
+}
+
+vec4 perlinCorner(uint h, vec3 p)
+{
+  vec3 g = perlinGradients[h & 15u];
+  return vec4(dot(g, p), g);
+}
+
+// (b - a)*t + a on value and gradient; dt is fade'(f) on the axis of t.
+vec3 perlinLerp(vec3 a, vec3 b, float t, vec3 dt)
+{
+  return (b - a)*t + a + (b.x - a.x)*dt;
+}
+
+vec4 perlinLerp(vec4 a, vec4 b, float t, vec4 dt)
+{
+  return (b - a)*t + a + (b.x - a.x)*dt;
+}
+
+float noise2d(vec2 p, out vec2 grad)
+{
+  vec2 i = floor(p), f = p - i;
+  vec2 t = (3.0 - 2.0*f)*f*f;
+  vec2 dt = 6.0*f*(1.0 - f);
+  uint l0 = perlinFloorMod(i.x), l1 = perlinFloorMod(i.y);
+  uint a = perlinPerm(l0) + l1, b = perlinPerm(l0 + 1u) + l1;
+  vec3 f0 = perlinCorner(perlinPerm(perlinPerm(a)), f);
+  vec3 f1 = perlinCorner(perlinPerm(perlinPerm(b)), f - vec2(1, 0));
+  vec3 f2 = perlinCorner(perlinPerm(perlinPerm(a + 1u)), f - vec2(0, 1));
+  vec3 f3 = perlinCorner(perlinPerm(perlinPerm(b + 1u)), f - vec2(1, 1));
+  vec3 dx = vec3(0, dt.x, 0);
+  vec3 r = perlinLerp(perlinLerp(f0, f1, t.x, dx), perlinLerp(f2, f3, t.x, dx), t.y, vec3(0, 0, dt.y));
+  grad = r.yz;
+  return r.x;
+}
+
+float noise3d(vec3 p, out vec3 grad)
+{
+  vec3 i = floor(p), f = p - i;
+  vec3 t = (3.0 - 2.0*f)*f*f;
+  vec3 dt = 6.0*f*(1.0 - f);
+  uint l0 = perlinFloorMod(i.x), l1 = perlinFloorMod(i.y), l2 = perlinFloorMod(i.z);
+  uint a = perlinPerm(l0) + l1, b = perlinPerm(l0 + 1u) + l1;
+  uint a0 = perlinPerm(a) + l2, a1 = perlinPerm(b) + l2;
+  uint a2 = perlinPerm(a + 1u) + l2, a3 = perlinPerm(b + 1u) + l2;
+  vec4 f0 = perlinCorner(perlinPerm(a0), f);
+  vec4 f1 = perlinCorner(perlinPerm(a1), f - vec3(1, 0, 0));
+  vec4 f2 = perlinCorner(perlinPerm(a2), f - vec3(0, 1, 0));
+  vec4 f3 = perlinCorner(perlinPerm(a3), f - vec3(1, 1, 0));
+  vec4 f4 = perlinCorner(perlinPerm(a0 + 1u), f - vec3(0, 0, 1));
+  vec4 f5 = perlinCorner(perlinPerm(a1 + 1u), f - vec3(1, 0, 1));
+  vec4 f6 = perlinCorner(perlinPerm(a2 + 1u), f - vec3(0, 1, 1));
+  vec4 f7 = perlinCorner(perlinPerm(a3 + 1u), f - vec3(1, 1, 1));
+  vec4 dx = vec4(0, dt.x, 0, 0), dy = vec4(0, 0, dt.y, 0);
+  vec4 g0 = perlinLerp(perlinLerp(f0, f1, t.x, dx), perlinLerp(f2, f3, t.x, dx), t.y, dy);
+  vec4 g1 = perlinLerp(perlinLerp(f4, f5, t.x, dx), perlinLerp(f6, f7, t.x, dx), t.y, dy);
+  vec4 r = perlinLerp(g0, g1, t.z, vec4(0, 0, 0, dt.z));
+  grad = r.yzw;
+  return r.x;
+}
+
+float noise2d(vec2 p)
+{
+  vec2 grad;
+  return noise2d(p, grad);
+}
+
+float noise3d(vec3 p)
+{
+  vec3 grad;
+  return noise3d(p, grad);
+}
+
+// One octave of fractal2d/3d: adds value n with gradient dn.
+void fractalAdd(int type, float ridgeOffset, float amplitude, float n, vec3 dn,
+  inout float sum, inout vec3 dsum, inout float weight, inout vec3 dweight)
+{
+  float s = (n < 0.0) ? -1.0 : 1.0;
+  if (type == FractalFBm) {
+    sum += amplitude * n;
+    dsum += amplitude * dn;
+  } else if (type == FractalTurbulence) {
+    sum += amplitude * abs(n);
+    dsum += amplitude * s * dn;
+  } else {
+    float a = ridgeOffset - abs(n);
+    float r = a * a;
+    vec3 dr = -2.0 * a * s * dn;
+    sum += amplitude * r * weight;
+    dsum += amplitude * (dr * weight + r * dweight);
+    dweight = (r > 0.0 && r < 1.0) ? dr : vec3(0);
+    weight = clamp(r, 0.0, 1.0);
+  }
+}
+
+float fractalOctaves(FractalNoise f, int type, int octaves, vec2 p, out vec2 grad)
+{
+  float sum = 0.0, weight = 1.0, amplitude = 1.0, frequency = f.frequency;
+  vec3 dsum = vec3(0), dweight = vec3(0);
+  for (int k = 0; k < octaves; ++k) {
+    vec2 dn;
+    float n = noise2d(p * frequency, dn);
+    fractalAdd(type, f.ridgeOffset, amplitude, n, vec3(dn * frequency, 0), sum, dsum, weight, dweight);
+    amplitude *= f.gain;
+    frequency *= f.lacunarity;
+  }
+  grad = dsum.xy;
+  return sum;
+}
+
+float fractalOctaves(FractalNoise f, int type, int octaves, vec3 p, out vec3 grad)
+{
+  float sum = 0.0, weight = 1.0, amplitude = 1.0, frequency = f.frequency;
+  vec3 dsum = vec3(0), dweight = vec3(0);
+  for (int k = 0; k < octaves; ++k) {
+    vec3 dn;
+    float n = noise3d(p * frequency, dn);
+    fractalAdd(type, f.ridgeOffset, amplitude, n, dn * frequency, sum, dsum, weight, dweight);
+    amplitude *= f.gain;
+    frequency *= f.lacunarity;
+  }
+  grad = dsum;
+  return sum;
+}
+
+float fractal2d(FractalNoise f, vec2 p, out vec2 grad)
+{
+  mat2 dq = mat2(0); // columns: gradients of the warp offsets
+  if (f.warp != 0.0) {
+    vec2 q, g;
+    q.x = fractalOctaves(f, FractalFBm, f.warpOctaves, p, g);
+    dq[0] = g;
+    q.y = fractalOctaves(f, FractalFBm, f.warpOctaves, p + vec2(5.2, 1.3), g);
+    dq[1] = g;
+    p += f.warp * q;
+  }
+  float v = fractalOctaves(f, f.type, f.octaves, p, grad);
+  grad += f.warp * (dq * grad);
+  return v;
+}
+
+float fractal3d(FractalNoise f, vec3 p, out vec3 grad)
+{
+  mat3 dq = mat3(0);
+  if (f.warp != 0.0) {
+    vec3 q, g;
+    q.x = fractalOctaves(f, FractalFBm, f.warpOctaves, p, g);
+    dq[0] = g;
+    q.y = fractalOctaves(f, FractalFBm, f.warpOctaves, p + vec3(5.2, 1.3, 2.8), g);
+    dq[1] = g;
+    q.z = fractalOctaves(f, FractalFBm, f.warpOctaves, p + vec3(1.7, 9.2, 4.1), g);
+    dq[2] = g;
+    p += f.warp * q;
+  }
+  float v = fractalOctaves(f, f.type, f.octaves, p, grad);
+  grad += f.warp * (dq * grad);
+  return v;
+}
+
+float fractal2d(FractalNoise f, vec2 p)
+{
+  vec2 grad;
+  return fractal2d(f, p, grad);
+}
+
+float fractal3d(FractalNoise f, vec3 p)
+{
+  vec3 grad;
+  return fractal3d(f, p, grad);
+}
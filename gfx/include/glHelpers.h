@@ -17,6 +17,7 @@
 #pragma once
 
 #include <glslMath.h>
+#include <glslCulling.h>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -27,8 +28,16 @@
 #define GLComputeSupported 0
 #endif
 
+#ifdef GL_MAP_PERSISTENT_BIT
+#define GLPersistentMappingSupported 1
+#else
+#define GLPersistentMappingSupported 0
+#endif
+
 #include <vector>
 
+struct Meshlet; // meshOptimizer.h
+
 bool validateGL();
 
 GLuint compileShader(GLenum type, const char* text);
@@ -49,6 +58,46 @@ void setUniformf(GLuint uloc, const glsl_math::mat4& m);
 void setProjectionMatrix(GLuint program, const glsl_math::mat4& m);
 
 void setModelViewMatrix(GLuint program, const glsl_math::mat4& m, bool normal_matrix);
+// Uploads the cached normal matrix of m (no inversion for unchanged or rigid m).
+void setModelViewMatrix(GLuint program, const glsl_math::transform& m, bool normal_matrix);
+
+#if GLPersistentMappingSupported
+// Buffer for data rewritten every frame: immutable storage of regionCount
+// regions, mapped once (persistent, coherent) and written in turns, so the
+// CPU fills one region while the GPU may still read the other two. Each
+// region gets a fence after the commands reading it, and acquire() waits
+// for it before handing the region out again.
+class GLStreamBuffer
+{
+public:
+    static constexpr GLuint regionCount = 3;
+
+    GLStreamBuffer();
+
+    // (Re)creates the buffer with regions of regionSize bytes. Returns
+    // false without GL 4.4 (glBufferStorage) or when the new buffer cannot
+    // be mapped, keeping the current one.
+    bool init(GLsizeiptr regionSize);
+
+    void destroy();
+
+    // Moves to the next region and returns its memory.
+    void* acquire();
+
+    // Fences the current region, call after the commands reading it.
+    void fence();
+
+    GLintptr offset() const { return current * regionSize; }
+
+    GLuint buffer;
+    GLsizeiptr regionSize;
+    GLuint current;
+    char* mapped;
+    GLsync fences[regionCount];
+    // acquire() calls that had to wait for the GPU.
+    GLuint stalls;
+};
+#endif
 
 class GLMesh
 {
@@ -60,13 +109,26 @@ public:
         XYZUV, // 12 + 8
         XYZUVN, // 12 + 8 + 12
         XYZUVNC, // 12 + 8 + 12 + 16
-        PTNC // 16 + 16 + 12 + 16 (4d pos, 4d tex, 3d norm, 4d color)
+        PTNC, // 16 + 16 + 12 + 16 (4d pos, 4d tex, 3d norm, 4d color)
+        // Packed versions of the above: half positions (w included) and
+        // texture coordinates, 2_10_10_10 snorm normals, RGBA8 unorm colors,
+        // read by the same shaders. Half positions keep 11 significant bits,
+        // fine for vertices in local space near the origin.
+        XYZUVN_PACKED, // 8 + 4 + 4
+        XYZUVNC_PACKED, // 8 + 4 + 4 + 4
+        PTNC_PACKED // 8 + 8 + 4 + 4
     };
     enum Primitive
     {
         LINES = 0,
         TRIANGLES
     };
+    // Bytes per vertex.
+    static GLuint stride(Format format);
+    static bool isPacked(Format format) { return format >= XYZUVN_PACKED; }
+
+    // Vertex counts are in vertices (GLMesh::stride bytes each), index
+    // counts in indices.
     GLMesh();
     GLMesh(Format format, GLuint vertexCount, GLuint indexCount, Primitive primitive = TRIANGLES);
     GLMesh(Format format, const GLfloat* vertexData, GLuint vertexCount,
@@ -77,10 +139,37 @@ public:
     void initComputeIndices(GLuint newIndexCount);
 #endif
 
+    // Replace the contents, growing the buffers by half at least when they
+    // are too small and orphaning them otherwise, so updates neither
+    // reallocate every time nor wait for draws of the previous contents.
     void updateVertices(Format format, const GLfloat* vertexData, GLuint vertexCount);
 
+    // Indices are stored in 16 bits when the mesh has at most 65536
+    // vertices. Larger meshes are split into chunks of primitives spanning
+    // at most 65536 vertices each, 16-bit relative to the chunk baseVertex,
+    // unless the indices are too scattered for that to pay off.
     void updateIndices(const GLuint* indexData, GLuint indexCount, Primitive primitive = TRIANGLES);
 
+    // Grows the buffers to hold maxVertexCount vertices of format and
+    // maxIndexCount indices (of 32 bits) up front, keeping the contents.
+    void reserve(Format format, GLuint maxVertexCount, GLuint maxIndexCount);
+
+#if GLPersistentMappingSupported
+    // Streaming mode for geometry rewritten every frame: the vertex buffer
+    // (maxVertexCount > 0) and the index buffer (maxIndexCount > 0) become
+    // GLStreamBuffer rings. updateVertices and updateIndices then copy into
+    // mapped memory instead of calling glBufferSubData, or the data can be
+    // written in place into mapVertices/mapIndices before render(). Counts
+    // are in vertices and indices as in updateVertices/updateIndices, larger updates
+    // reallocate the ring. Returns false without GL 4.4.
+    bool initStreaming(Format format, GLuint maxVertexCount, GLuint maxIndexCount);
+
+    // Null when the ring cannot grow to the count, the previous one stays;
+    // updateVertices/updateIndices then go back to a plain buffer.
+    GLfloat* mapVertices(Format format, GLuint vertexCount);
+    GLuint* mapIndices(GLuint indexCount, Primitive primitive = TRIANGLES);
+#endif
+
     void destroy();
 
     void updateVertexAttributes();
@@ -89,17 +178,153 @@ public:
 
     void unbind();
 
+    // Draws the finest level of detail when there are lods.
     void render();
 
+    // Level of detail: indices [firstIndex, firstIndex + count) draw the
+    // mesh within error (in vertex position units) of the full one.
+    struct Lod
+    {
+        GLuint firstIndex;
+        GLuint count;
+        float error;
+    };
+
+    // All indices when there are no lods.
+    void renderLod(size_t level);
+
+    void renderRange(GLuint firstIndex, GLuint count);
+
+    // Coarsest of lods whose error spans at most pixelError pixels of a
+    // viewport viewportHeight pixels high, at the nearest point of the
+    // bounding sphere (center, radius in mesh coordinates) seen through
+    // modelView and projection (perspective or orthographic). Level 0 when
+    // the sphere reaches the eye.
+    size_t selectLod(const glsl_math::mat4& projection, const glsl_math::mat4& modelView,
+        const glsl_math::vec3& center, double radius, double viewportHeight, double pixelError = 1) const;
+
+#if GLComputeSupported
+    // Draws drawCount GLDrawCommand records from commandBuffer with one
+    // glMultiDrawElementsIndirect, e.g. the meshlets of meshletCommands.
+    void renderIndirect(GLuint commandBuffer, GLsizei drawCount);
+#endif
+
+    // Bytes per index.
+    GLuint indexSize() const { return (indexType == GL_UNSIGNED_SHORT) ? 2 : 4; }
+
+    // Range of indices drawn with glDrawElementsBaseVertex.
+    struct Chunk
+    {
+        GLuint firstIndex;
+        GLuint count;
+        GLint baseVertex;
+    };
+
     Format format;
     Primitive primitive;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT; streamed and compute-generated
+    // indices are always 32-bit.
+    GLenum indexType;
+    // Empty when the mesh is drawn in one call with baseVertex 0.
+    std::vector<Chunk> chunks;
+    // Finest first, all in the index buffer. Empty when all indices draw
+    // one level; updating the indices clears them.
+    std::vector<Lod> lods;
     GLuint vertexCount;
+    // Allocated bytes of vertexBuffer and indexBuffer (outside streaming).
+    GLuint vertexCapacity;
     GLuint vertexBuffer;
     GLuint indexCount;
+    GLuint indexCapacity;
     GLuint indexBuffer;
     GLuint arrayBuffer;
+    // Byte offsets of the data in vertexBuffer and indexBuffer.
+    GLuint vertexOffset;
+    GLuint indexOffset;
     bool isBound;
+#if GLPersistentMappingSupported
+    GLStreamBuffer vertexStream;
+    GLStreamBuffer indexStream;
+#endif
+};
+
+#if GLComputeSupported
+// DrawElementsIndirectCommand, same layout as Cmd in gendraw.comp.
+struct GLDrawCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLuint baseVertex;
+    GLuint baseInstance;
+};
+
+// Draw ranges of the meshlets of mesh (built on the indices it was given,
+// see buildMeshlets): one command per meshlet with baseInstance set to the
+// meshlet number, two where it straddles 16-bit chunks of the mesh.
+// Replaces the contents of commands.
+void meshletCommands(const GLMesh& mesh, const Meshlet* meshlets, size_t count,
+    std::vector<GLDrawCommand>& commands);
+
+// Sets instanceCount of the commands to 0 where the meshlet is outside f or
+// faces away from eye (both in the mesh coordinates), to 1 otherwise.
+// Returns the number of visible commands.
+size_t cullMeshletCommands(const glsl_math::frustumf& f, const glsl_math::vec3f& eye, const Meshlet* meshlets,
+    GLDrawCommand* commands, size_t count);
+
+// Many small meshes of one format suballocated from the buffers of a
+// single GLMesh, so they share one VAO and render() draws all of them with
+// one glMultiDrawElementsIndirect (GL 4.3) instead of a bind and a
+// glDrawElements each. Indices of an added mesh refer to its own vertices
+// (baseVertex does the rest). Buffers grow, at least doubling, when an add
+// does not fit, and the space of removed meshes is reused.
+class GLMeshArena
+{
+public:
+    static constexpr GLuint InvalidId = ~0u;
+
+    GLMeshArena(GLMesh::Format format, GLuint vertexCapacity, GLuint indexCapacity,
+        GLMesh::Primitive primitive = GLMesh::TRIANGLES);
+
+    void destroy();
+
+    // Returns the id of the new mesh.
+    GLuint add(const GLfloat* vertexData, GLuint vertexCount, const GLuint* indexData, GLuint indexCount);
+
+    // Rewrites the vertices of mesh id, vertexData holds as many as given to add.
+    void updateVertices(GLuint id, const GLfloat* vertexData);
+
+    void remove(GLuint id);
+
+    // Meshes with instanceCount 0 are skipped, more draw gl_InstanceID copies.
+    void setInstanceCount(GLuint id, GLuint instanceCount);
+
+    GLuint size() const { return static_cast<GLuint>(commands.size()); }
+
+    void render();
+
+    struct Range
+    {
+        GLuint offset;
+        GLuint count;
+    };
+
+    GLMesh mesh;
+    // One command per mesh, in no particular order.
+    std::vector<GLDrawCommand> commands;
+    // commandIndex[id] is the command of mesh id, meshIds the reverse.
+    std::vector<GLuint> commandIndex;
+    std::vector<GLuint> meshIds;
+    std::vector<GLuint> vertexCounts;
+    std::vector<GLuint> freeIds;
+    // Unused vertices and indices, sorted by offset.
+    std::vector<Range> freeVertices;
+    std::vector<Range> freeIndices;
+    GLuint commandBuffer;
+    GLuint commandCapacity;
+    bool commandsChanged;
 };
+#endif
 
 class GLTexture
 {
@@ -165,6 +390,7 @@ public:
     void setTexImageCube(const GLvoid* data, GLuint side, GLuint width, GLuint height, GLuint mipLevel = 0);
 
     void setTexStorage2D(GLuint width, GLuint height, GLuint levels);
+    void setTexStorage3D(GLuint width, GLuint height, GLuint depth, GLuint levels);
 
     void updateSettings();
 
@@ -194,9 +420,57 @@ public:
     FileBuffer(const char* file_name, bool text_mode);
     void append(const char* file_name, bool text_mode);
     void save(const char* file_name, bool text_mode);
+    // Replaces the lines #include "file" of a text buffer with the file
+    // contents, for shaders sharing GLSL code. Returns false, leaving the
+    // buffer as it was, when a file includes itself directly or not.
+    bool expandIncludes();
     std::vector<char> buffer;
 };
 
+#if GLComputeSupported
+class PerlinNoise;
+struct FractalNoise;
+
+// Bakes fractal noise of a PerlinNoise field (see fractalNoise.h) into
+// level 0 of a GL_TEXTURE_2D or GL_TEXTURE_3D with immutable storage, with
+// noiseBake.comp and perlinNoise.glsl. Texel (i, j[, k]) gets the noise at
+// origin + (i, j[, k]) * step like fractal2dGrid/fractal3dGrid: GL_R32F
+// textures the value, GL_RGBA16F and GL_RGBA32F ones (value, gradient).
+class GLNoiseBaker
+{
+public:
+    explicit GLNoiseBaker(const PerlinNoise& noise);
+
+    void destroy();
+
+    // Switches to the permutation of another field.
+    void setNoise(const PerlinNoise& noise);
+
+    bool bake2D(GLTexture& texture, GLuint width, GLuint height, const FractalNoise& f,
+        const glsl_math::vec2f& origin, const glsl_math::vec2f& step);
+    bool bake3D(GLTexture& texture, GLuint width, GLuint height, GLuint depth, const FractalNoise& f,
+        const glsl_math::vec3f& origin, const glsl_math::vec3f& step);
+
+    // Binding of the permutation buffer (PerlinNoiseBinding in the shaders).
+    static constexpr GLuint permutationBinding = 7;
+
+    struct Program
+    {
+        int dims;
+        GLuint internalFormat;
+        GLuint program;
+    };
+
+    GLuint permutationBuffer;
+    std::vector<Program> programs;
+
+private:
+    GLuint program(int dims, GLuint internalFormat);
+    bool bake(GLTexture& texture, int dims, GLuint width, GLuint height, GLuint depth, const FractalNoise& f,
+        const glsl_math::vec3f& origin, const glsl_math::vec3f& step);
+};
+#endif
+
 class MeshBuilder
 {
 public:
@@ -238,8 +512,50 @@ public:
     inline void vertex(double x, double y, double z, double w) { vertex(vec4(x, y, z, w)); }
     void vertex(const vec4& v, const vec4& t, const vec3& n, const vec4& c);
 
+    // Transforms positions and normals of all vertices emitted so far
+    // (packed ones are unpacked, transformed and packed again).
+    void transform(const glsl_math::mat4& m);
+
+    // Shares vertices whose attributes match within the epsilons (cells of
+    // that size, 0 compares bits exactly, see weldVertices) and rewrites
+    // indexData, e.g. 24 corners of a cube of quads to 8 positions, or the
+    // 4 corners meeting at each grid point of flat shaded blocks to 1.
+    // Packed formats are compared bit for bit. Returns the vertex count.
+    GLuint weld(float positionEpsilon = 0, float texCoordEpsilon = 0, float normalEpsilon = 0,
+        float colorEpsilon = 0);
+
+    struct OptimizeReport
+    {
+        float acmrBefore;
+        float acmrAfter;
+    };
+
+    // Reorders the triangles for the post-transform vertex cache and
+    // overdraw, then the vertices in order of first use, dropping unused
+    // ones (see meshOptimizer.h). Does nothing to lines. Returns the ACMR
+    // before and after, the vertex shader runs per miss.
+    OptimizeReport optimize(float overdrawThreshold = 1.05f);
+
+    // Reorders the triangles into meshlets of at most maxTriangles (see
+    // buildMeshlets), to draw with meshletCommands after compile. Does
+    // nothing to lines.
+    void buildMeshlets(std::vector<Meshlet>& meshlets, GLuint maxTriangles = 124);
+
+    // Appends coarser levels of detail of the triangles to indexData, each
+    // simplified from the full mesh (see simplify) to reduction times the
+    // triangles of the previous one, up to maxLevels levels, maxError (in
+    // position units) or until simplification stalls. compile passes them
+    // on as GLMesh::lods. begin, weld, optimize and buildMeshlets drop
+    // the coarser levels, call it again after them. Returns the number of
+    // levels.
+    size_t generateLods(float maxError, size_t maxLevels = 8, float reduction = 0.5f);
+
     GLMesh compile() const;
     void compile(GLMesh& mesh) const;
+#if GLComputeSupported
+    // Adds the mesh to arena (of the same format), returns its id.
+    GLuint compile(GLMeshArena& arena) const;
+#endif
 
     GLMesh::Format format;
 
@@ -249,6 +565,10 @@ public:
     vec4 currColor;
     GLuint currBeginOffset;
 
+    // GLMesh::stride(format) / 4 elements per vertex; for packed formats
+    // they hold the packed 32-bit words bit for bit, not float values.
     std::vector<GLfloat> vertexData;
     std::vector<GLuint> indexData;
+    // Empty until generateLods.
+    std::vector<GLMesh::Lod> lods;
 };
@@ -17,9 +17,18 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
 
 #include "glHelpers.h"
 
+#include <fractalNoise.h>
+#include <glslMathBatch.h>
+#include <glslPacking.h>
+#include <meshOptimizer.h>
+
+#include <algorithm>
+#include <string>
+
 enum ShaderAttribLocation
 {
     PositionAttribLocation = 0,
@@ -218,24 +227,182 @@ void setModelViewMatrix(GLuint program, const glsl_math::mat4& m, bool normal_ma
     setUniformf(uloc, m);
     if (normal_matrix) {
         uloc = glGetUniformLocation(program, "uNormalMatrix");
-        setUniformf(uloc, transpose(inverse(mat3(m))));
+        setUniformf(uloc, normalMatrix(m));
+    }
+}
+
+void setModelViewMatrix(GLuint program, const glsl_math::transform& m, bool normal_matrix)
+{
+    GLuint uloc = glGetUniformLocation(program, "uModelViewMatrix");
+    setUniformf(uloc, m.matrix());
+    if (normal_matrix) {
+        uloc = glGetUniformLocation(program, "uNormalMatrix");
+        setUniformf(uloc, m.normalMatrix());
     }
 }
 
-constexpr static GLuint GLMeshStride[6] = {
-    0,
-    12, // XYZ
-    12 + 8, // XYZUV
-    12 + 8 + 12, // XYZUVN
-    12 + 8 + 12 + 16, // XYZUVNC
-    16 + 16 + 12 + 16 // PTNC
+#if GLPersistentMappingSupported
+constexpr GLuint GLStreamBuffer::regionCount;
+
+GLStreamBuffer::GLStreamBuffer()
+    : buffer(0)
+    , regionSize(0)
+    , current(regionCount - 1)
+    , mapped(nullptr)
+    , stalls(0)
+{
+    for (GLsync& sync : fences)
+        sync = nullptr;
+}
+
+static bool bufferStorageSupported()
+{
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major > 4 || (major == 4 && minor >= 4);
+}
+
+bool GLStreamBuffer::init(GLsizeiptr newRegionSize)
+{
+    if (!bufferStorageSupported())
+        return false;
+
+    // The new ring is mapped before the old one goes, so a failure keeps it.
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLuint newBuffer;
+    glGenBuffers(1, &newBuffer);
+    // Not bound to GL_ELEMENT_ARRAY_BUFFER here, that would change the bound VAO.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, newRegionSize * regionCount, 0, flags);
+    char* newMapped = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, newRegionSize * regionCount,
+        flags));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (!newMapped)
+    {
+        fprintf(stderr, "ERROR: cannot map stream buffer of %ld bytes\n", static_cast<long>(newRegionSize * regionCount));
+        glDeleteBuffers(1, &newBuffer);
+        return false;
+    }
+    destroy();
+    buffer = newBuffer;
+    mapped = newMapped;
+    regionSize = newRegionSize;
+    current = regionCount - 1;
+    return true;
+}
+
+void GLStreamBuffer::destroy()
+{
+    for (GLsync& sync : fences)
+    {
+        if (sync)
+            glDeleteSync(sync);
+        sync = nullptr;
+    }
+    // Deleting the buffer unmaps it; the GPU keeps it until it is done with it.
+    if (buffer)
+        glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    regionSize = 0;
+    mapped = nullptr;
+}
+
+void* GLStreamBuffer::acquire()
+{
+    current = (current + 1) % regionCount;
+    if (GLsync sync = fences[current])
+    {
+        // Normally signalled frames ago. Otherwise flush, the fence may
+        // still sit in the command queue.
+        GLenum result = glClientWaitSync(sync, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+            ++stalls;
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(sync);
+        fences[current] = nullptr;
+    }
+    return mapped + offset();
+}
+
+void GLStreamBuffer::fence()
+{
+    if (fences[current])
+        glDeleteSync(fences[current]);
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+#endif
+
+// One attribute of a vertex format, size 0 when the format has none.
+struct GLMeshAttrib
+{
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    GLuint offset;
 };
 
+// Vertex layouts indexed by GLMesh::Format, attributes indexed by
+// ShaderAttribLocation.
+struct GLMeshLayout
+{
+    GLuint stride;
+    GLMeshAttrib attribs[4];
+};
+
+constexpr static GLMeshLayout GLMeshLayouts[] = {
+    { 0, {} },
+    { 12, { // XYZ
+        { 3, GL_FLOAT, GL_FALSE, 0 } } },
+    { 12 + 8, { // XYZUV
+        { 3, GL_FLOAT, GL_FALSE, 0 },
+        { 2, GL_FLOAT, GL_FALSE, 12 } } },
+    { 12 + 8 + 12, { // XYZUVN
+        { 3, GL_FLOAT, GL_FALSE, 0 },
+        { 2, GL_FLOAT, GL_FALSE, 12 },
+        { 3, GL_FLOAT, GL_FALSE, 20 } } },
+    { 12 + 8 + 12 + 16, { // XYZUVNC
+        { 3, GL_FLOAT, GL_FALSE, 0 },
+        { 2, GL_FLOAT, GL_FALSE, 12 },
+        { 3, GL_FLOAT, GL_FALSE, 20 },
+        { 4, GL_FLOAT, GL_FALSE, 32 } } },
+    { 16 + 16 + 12 + 16, { // PTNC
+        { 4, GL_FLOAT, GL_FALSE, 0 },
+        { 4, GL_FLOAT, GL_FALSE, 16 },
+        { 3, GL_FLOAT, GL_FALSE, 32 },
+        { 4, GL_FLOAT, GL_FALSE, 44 } } },
+    { 8 + 4 + 4, { // XYZUVN_PACKED
+        { 4, GL_HALF_FLOAT, GL_FALSE, 0 },
+        { 2, GL_HALF_FLOAT, GL_FALSE, 8 },
+        { 4, GL_INT_2_10_10_10_REV, GL_TRUE, 12 } } },
+    { 8 + 4 + 4 + 4, { // XYZUVNC_PACKED
+        { 4, GL_HALF_FLOAT, GL_FALSE, 0 },
+        { 2, GL_HALF_FLOAT, GL_FALSE, 8 },
+        { 4, GL_INT_2_10_10_10_REV, GL_TRUE, 12 },
+        { 4, GL_UNSIGNED_BYTE, GL_TRUE, 16 } } },
+    { 8 + 8 + 4 + 4, { // PTNC_PACKED
+        { 4, GL_HALF_FLOAT, GL_FALSE, 0 },
+        { 4, GL_HALF_FLOAT, GL_FALSE, 8 },
+        { 4, GL_INT_2_10_10_10_REV, GL_TRUE, 16 },
+        { 4, GL_UNSIGNED_BYTE, GL_TRUE, 20 } } }
+};
+
+GLuint GLMesh::stride(Format format)
+{
+    return GLMeshLayouts[format].stride;
+}
+
 GLMesh::GLMesh(Format format, GLuint vertexCount, GLuint indexCount, Primitive primitive)
     : format(format)
     , primitive(primitive)
+    , indexType(GL_UNSIGNED_INT)
     , vertexCount(vertexCount)
+    , vertexCapacity(0)
     , indexCount(indexCount)
+    , indexCapacity(0)
+    , vertexOffset(0)
+    , indexOffset(0)
     , isBound(false)
 {
     glGenVertexArrays(1, &arrayBuffer);
@@ -246,6 +413,65 @@ GLMesh::GLMesh(Format format, GLuint vertexCount, GLuint indexCount, Primitive p
     indexBuffer = buffers[1];
 }
 
+// Picks the index type for updateIndices: fills packed with 16-bit indices
+// relative to the baseVertex of their chunk and returns GL_UNSIGNED_SHORT,
+// or returns GL_UNSIGNED_INT when a primitive spans more than 65536
+// vertices or the indices would need too many chunks.
+static GLenum packIndices(const GLuint* indices, GLuint count, GLMesh::Primitive primitive,
+    std::vector<uint16_t>& packed, std::vector<GLMesh::Chunk>& chunks)
+{
+    const GLuint primitiveSize = (primitive == GLMesh::TRIANGLES) ? 3 : 2;
+    chunks.clear();
+    GLuint first = 0, lo = ~0u, hi = 0, totalLo = ~0u, totalHi = 0;
+    for (GLuint i = 0; i < count; i += primitiveSize)
+    {
+        const GLuint end = std::min(i + primitiveSize, count);
+        GLuint primLo = ~0u, primHi = 0;
+        for (GLuint k = i; k < end; ++k)
+        {
+            primLo = std::min(primLo, indices[k]);
+            primHi = std::max(primHi, indices[k]);
+        }
+        if (primHi - primLo > 0xffff)
+        {
+            chunks.clear();
+            return GL_UNSIGNED_INT;
+        }
+        if (std::max(hi, primHi) - std::min(lo, primLo) > 0xffff)
+        {
+            chunks.push_back(GLMesh::Chunk{ first, i - first, static_cast<GLint>(lo) });
+            first = i;
+            lo = primLo;
+            hi = primHi;
+        }
+        else
+        {
+            lo = std::min(lo, primLo);
+            hi = std::max(hi, primHi);
+        }
+        totalLo = std::min(totalLo, primLo);
+        totalHi = std::max(totalHi, primHi);
+    }
+    if (count > first)
+        chunks.push_back(GLMesh::Chunk{ first, count - first, static_cast<GLint>(lo) });
+
+    // Scattered indices jump between windows all the time, the extra draw
+    // calls would cost more than the halved index fetch saves.
+    if (chunks.size() > 4 * ((totalHi - totalLo) / 0x10000 + 1))
+    {
+        chunks.clear();
+        return GL_UNSIGNED_INT;
+    }
+
+    packed.resize(count);
+    for (const GLMesh::Chunk& chunk : chunks)
+        for (GLuint k = chunk.firstIndex; k < chunk.firstIndex + chunk.count; ++k)
+            packed[k] = static_cast<uint16_t>(indices[k] - chunk.baseVertex);
+    if (chunks.size() == 1 && chunks[0].baseVertex == 0)
+        chunks.clear();
+    return GL_UNSIGNED_SHORT;
+}
+
 GLMesh::GLMesh()
     : GLMesh(None, 0, 0, Primitive::TRIANGLES)
 {
@@ -257,36 +483,117 @@ GLMesh::GLMesh(Format format, const GLfloat* vertexData, GLuint vertexCount,
 {
     bind();
 
+    std::vector<uint16_t> packed;
+    indexType = packIndices(indexData, indexCount, primitive, packed, chunks);
+    indexCapacity = indexSize() * indexCount;
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indexCount, indexData, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity,
+        (indexType == GL_UNSIGNED_SHORT) ? static_cast<const void*>(packed.data()) : indexData, GL_STATIC_DRAW);
 
+    vertexCapacity = GLMeshLayouts[format].stride * vertexCount;
     glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * vertexCount, vertexData, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexCapacity, vertexData, GL_STATIC_DRAW);
 
     updateVertexAttributes();
 
     unbind();
 }
 
-#if GLComputeSupported
-void GLMesh::initComputeVertices(Format newFormat, GLuint newVertexCount)
+// Writes size bytes to the start of the buffer bound at target, replacing
+// all of its contents. Storage too small grows by half at least, so a mesh
+// growing a bit per update reallocates only O(log n) times. Otherwise the
+// storage is orphaned: the driver hands out fresh memory instead of waiting
+// for draws still reading the old contents.
+static void uploadBuffer(GLenum target, GLuint& capacity, GLuint size, const void* data)
 {
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, vertexBuffer);
+    if (size > capacity)
+        capacity = std::max(size, capacity + capacity / 2);
+    if (size == capacity)
+    {
+        glBufferData(target, capacity, data, GL_DYNAMIC_DRAW);
+        return;
+    }
+    glBufferData(target, capacity, 0, GL_DYNAMIC_DRAW);
+    if (size > 0)
+        glBufferSubData(target, 0, size, data);
+}
 
-    newVertexCount *= GLMeshStride[newFormat] >> 2;
+// Moves buffer to new storage of capacity bytes keeping its first size
+// bytes. The buffer gets a new name, the caller attaches it again.
+static void reallocateBuffer(GLuint& buffer, GLuint size, GLuint capacity)
+{
+    GLuint newBuffer;
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, 0, GL_DYNAMIC_DRAW);
+    if (size > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    buffer = newBuffer;
+}
 
-    if (newVertexCount > vertexCount)
+void GLMesh::reserve(Format reserveFormat, GLuint maxVertexCount, GLuint maxIndexCount)
+{
+    GLuint vertexBytes = GLMeshLayouts[reserveFormat].stride * maxVertexCount;
+    GLuint indexBytes = sizeof(GLuint) * maxIndexCount;
+
+#if GLPersistentMappingSupported
+    // Rings keep no contents across frames, they are simply recreated.
+    if (vertexStream.mapped)
     {
-        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLfloat) * newVertexCount, 0, GL_DYNAMIC_COPY);
+        if (vertexBytes > vertexStream.regionSize)
+            initStreaming(reserveFormat, maxVertexCount, 0);
+        vertexBytes = 0;
     }
-    else
+    if (indexStream.mapped)
     {
-        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLfloat) * newVertexCount, 0);
+        if (indexBytes > indexStream.regionSize)
+            initStreaming(format, 0, maxIndexCount);
+        indexBytes = 0;
     }
+#endif
 
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    if (vertexBytes <= vertexCapacity && indexBytes <= indexCapacity)
+        return;
+
+    const bool autoUnbind = bind();
+    if (vertexBytes > vertexCapacity)
+    {
+        reallocateBuffer(vertexBuffer, GLMeshLayouts[format].stride * vertexCount, vertexBytes);
+        vertexCapacity = vertexBytes;
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        updateVertexAttributes();
+    }
+    if (indexBytes > indexCapacity)
+    {
+        reallocateBuffer(indexBuffer, indexSize() * indexCount, indexBytes);
+        indexCapacity = indexBytes;
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    }
+    if (autoUnbind)
+        unbind();
+}
 
-    if (newVertexCount > vertexCount || format != newFormat)
+#if GLComputeSupported
+void GLMesh::initComputeVertices(Format newFormat, GLuint newVertexCount)
+{
+    const GLuint size = GLMeshLayouts[newFormat].stride * newVertexCount;
+    const bool grows = size > vertexCapacity;
+
+    if (grows)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, vertexBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, 0, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        vertexCapacity = size;
+    }
+
+    if (grows || format != newFormat)
     {
         format = newFormat;
 
@@ -304,50 +611,67 @@ void GLMesh::initComputeVertices(Format newFormat, GLuint newVertexCount)
 
 void GLMesh::initComputeIndices(GLuint newIndexCount)
 {
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+    const GLuint size = sizeof(GLuint) * newIndexCount;
 
-    if (newIndexCount > indexCount)
+    if (size > indexCapacity)
     {
         // Initialize new GL buffer.
-        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * newIndexCount, 0, GL_DYNAMIC_COPY);
-    }
-    else
-    {
-        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint) * newIndexCount, 0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, 0, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        indexCapacity = size;
     }
 
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
     const bool autoUnbind = bind();
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
     if (autoUnbind)
         unbind();
 
     indexCount = newIndexCount;
+    indexType = GL_UNSIGNED_INT;
+    chunks.clear();
+    lods.clear();
+}
+#endif
+
+#if GLPersistentMappingSupported
+// Replaces a stream ring that failed to grow with an empty plain buffer;
+// the upload that follows allocates it and points the VAO to it.
+static void stopStreaming(GLStreamBuffer& stream, GLuint& buffer, GLuint& capacity, GLuint& offset)
+{
+    stream.destroy();
+    glGenBuffers(1, &buffer);
+    capacity = 0;
+    offset = 0;
 }
 #endif
 
 void GLMesh::updateVertices(Format newFormat, const GLfloat* vertexData, GLuint newVertexCount)
 {
+#if GLPersistentMappingSupported
+    if (vertexStream.mapped)
+    {
+        if (GLfloat* data = mapVertices(newFormat, newVertexCount))
+        {
+            memcpy(data, vertexData, GLMeshLayouts[newFormat].stride * newVertexCount);
+            return;
+        }
+        stopStreaming(vertexStream, vertexBuffer, vertexCapacity, vertexOffset);
+    }
+#endif
+
     const bool autoUnbind = bind();
 
     glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
 
-    if (newVertexCount > vertexCount)
+    const GLuint size = GLMeshLayouts[newFormat].stride * newVertexCount;
+    const bool grows = size > vertexCapacity;
+    uploadBuffer(GL_ARRAY_BUFFER, vertexCapacity, size, vertexData);
+    if (grows || format != newFormat)
     {
-        // Initialize new GL buffer.
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * newVertexCount, vertexData, GL_DYNAMIC_DRAW);
         format = newFormat;
         updateVertexAttributes();
     }
-    else
-    {
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * newVertexCount, vertexData);
-        if (format != newFormat) {
-            format = newFormat;
-            updateVertexAttributes();
-        }
-    }
 
     if (autoUnbind)
         unbind();
@@ -357,25 +681,139 @@ void GLMesh::updateVertices(Format newFormat, const GLfloat* vertexData, GLuint
 
 void GLMesh::updateIndices(const GLuint* indexData, GLuint newIndexCount, Primitive newPrimitive)
 {
+#if GLPersistentMappingSupported
+    if (indexStream.mapped)
+    {
+        if (GLuint* data = mapIndices(newIndexCount, newPrimitive))
+        {
+            memcpy(data, indexData, sizeof(GLuint) * newIndexCount);
+            return;
+        }
+        stopStreaming(indexStream, indexBuffer, indexCapacity, indexOffset);
+    }
+#endif
+
+    std::vector<uint16_t> packed;
+    indexType = packIndices(indexData, newIndexCount, newPrimitive, packed, chunks);
+    lods.clear();
     const bool autoUnbind = bind();
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    if (newIndexCount > indexCount)
+    uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, indexCapacity, indexSize() * newIndexCount,
+        (indexType == GL_UNSIGNED_SHORT) ? static_cast<const void*>(packed.data()) : indexData);
+    if (autoUnbind)
+        unbind();
+    indexCount = newIndexCount;
+    primitive = newPrimitive;
+}
+
+#if GLPersistentMappingSupported
+bool GLMesh::initStreaming(Format newFormat, GLuint maxVertexCount, GLuint maxIndexCount)
+{
+    const bool autoUnbind = bind();
+    bool ok = true;
+    if (maxVertexCount > 0)
     {
-        // Initialize new GL buffer.
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * newIndexCount, indexData, GL_DYNAMIC_DRAW);
+        const GLuint prevBuffer = vertexStream.mapped ? 0 : vertexBuffer;
+        ok = vertexStream.init(GLMeshLayouts[newFormat].stride * maxVertexCount);
+        if (ok)
+        {
+            glDeleteBuffers(1, &prevBuffer);
+            vertexBuffer = vertexStream.buffer;
+            vertexCount = 0;
+            vertexOffset = 0;
+            format = newFormat;
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            updateVertexAttributes();
+        }
     }
-    else
+    if (ok && maxIndexCount > 0)
     {
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(GLuint) * newIndexCount, indexData);
+        const GLuint prevBuffer = indexStream.mapped ? 0 : indexBuffer;
+        ok = indexStream.init(sizeof(GLuint) * maxIndexCount);
+        if (ok)
+        {
+            glDeleteBuffers(1, &prevBuffer);
+            indexBuffer = indexStream.buffer;
+            indexCount = 0;
+            indexOffset = 0;
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        }
     }
     if (autoUnbind)
         unbind();
+    return ok;
+}
+
+// Rings too small for an update grow to twice the size at least. The old
+// buffer is deleted, so nothing waits for the GPU to release it; it stays
+// when the new one cannot be mapped.
+static bool reserveStream(GLStreamBuffer& stream, GLsizeiptr size, bool& reallocated)
+{
+    reallocated = size > stream.regionSize;
+    return !reallocated || stream.init(std::max(size, 2 * stream.regionSize));
+}
+
+GLfloat* GLMesh::mapVertices(Format newFormat, GLuint newVertexCount)
+{
+    assert(vertexStream.mapped);
+    bool reallocated;
+    if (!reserveStream(vertexStream, GLMeshLayouts[newFormat].stride * newVertexCount, reallocated))
+        return nullptr;
+    vertexBuffer = vertexStream.buffer;
+    GLfloat* data = static_cast<GLfloat*>(vertexStream.acquire());
+
+    // The attributes point into the region of this frame.
+    const GLuint newOffset = static_cast<GLuint>(vertexStream.offset());
+    if (reallocated || newOffset != vertexOffset || format != newFormat)
+    {
+        format = newFormat;
+        vertexOffset = newOffset;
+        const bool autoUnbind = bind();
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        updateVertexAttributes();
+        if (autoUnbind)
+            unbind();
+    }
+    vertexCount = newVertexCount;
+    return data;
+}
+
+GLuint* GLMesh::mapIndices(GLuint newIndexCount, Primitive newPrimitive)
+{
+    assert(indexStream.mapped);
+    bool reallocated;
+    if (!reserveStream(indexStream, sizeof(GLuint) * newIndexCount, reallocated))
+        return nullptr;
+    indexBuffer = indexStream.buffer;
+    if (reallocated)
+    {
+        const bool autoUnbind = bind();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        if (autoUnbind)
+            unbind();
+    }
+    GLuint* data = static_cast<GLuint*>(indexStream.acquire());
+    indexOffset = static_cast<GLuint>(indexStream.offset());
     indexCount = newIndexCount;
+    indexType = GL_UNSIGNED_INT;
+    chunks.clear();
+    lods.clear();
     primitive = newPrimitive;
+    return data;
 }
+#endif
 
 void GLMesh::destroy()
 {
+#if GLPersistentMappingSupported
+    // The streams own their buffers.
+    if (vertexStream.mapped)
+        vertexBuffer = 0;
+    if (indexStream.mapped)
+        indexBuffer = 0;
+    vertexStream.destroy();
+    indexStream.destroy();
+#endif
     GLuint buffers[2];
     buffers[0] = vertexBuffer;
     buffers[1] = indexBuffer;
@@ -385,47 +823,21 @@ void GLMesh::destroy()
 
 void GLMesh::updateVertexAttributes()
 {
-    GLuint attrloc;
-    GLuint count;
-    GLuint stride = GLMeshStride[format];
+    const GLMeshLayout& layout = GLMeshLayouts[format];
 
     const bool autoUnbind = bind();
 
-    count = (format == PTNC) ? 4 : 3;
-    //attrloc = glGetAttribLocation(program, "aVertex");
-    attrloc = PositionAttribLocation;
-    glEnableVertexAttribArray(attrloc);
-
-    glVertexAttribPointer(attrloc, count, GL_FLOAT, GL_FALSE, stride, 0);
-    GLuint offset = count << 2;
-
-    if (format >= XYZUV)
+    for (GLuint attrloc = PositionAttribLocation; attrloc <= ColorAttribLocation; ++attrloc)
     {
-        count = (format == PTNC) ? 4 : 2;
-        //attrloc = glGetAttribLocation(program, "aTexCoord");
-        attrloc = TexCoordAttribLocation;
-        glEnableVertexAttribArray(attrloc);
-        glVertexAttribPointer(attrloc, count, GL_FLOAT, GL_FALSE, stride, (void*)offset);
-        offset += count << 2;
-    }
-
-    if (format >= XYZUVN)
-    {
-        count = 3;
-        //attrloc = glGetAttribLocation(program, "aNormal");
-        attrloc = NormalAttribLocation;
-        glEnableVertexAttribArray(attrloc);
-        glVertexAttribPointer(attrloc, count, GL_FLOAT, GL_FALSE, stride, (void*)offset);
-        offset += count << 2;
-    }
-
-    if (format >= XYZUVNC)
-    {
-        count = 4;
-        //attrloc = glGetAttribLocation(program, "aColor");
-        attrloc = ColorAttribLocation;
+        const GLMeshAttrib& attrib = layout.attribs[attrloc];
+        if (attrib.size == 0)
+        {
+            glDisableVertexAttribArray(attrloc);
+            continue;
+        }
         glEnableVertexAttribArray(attrloc);
-        glVertexAttribPointer(attrloc, count, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+        const GLuint offset = vertexOffset + attrib.offset;
+        glVertexAttribPointer(attrloc, attrib.size, attrib.type, attrib.normalized, layout.stride, (void*)offset);
     }
 
     if (autoUnbind)
@@ -451,12 +863,297 @@ void GLMesh::unbind()
 
 void GLMesh::render()
 {
+    renderLod(0);
+}
+
+void GLMesh::renderLod(size_t level)
+{
+    if (lods.empty())
+    {
+        renderRange(0, indexCount);
+        return;
+    }
+    assert(level < lods.size());
+    renderRange(lods[level].firstIndex, lods[level].count);
+}
+
+void GLMesh::renderRange(GLuint firstIndex, GLuint count)
+{
+    const bool autoUnbind = bind();
+    const GLenum mode = (primitive == TRIANGLES) ? GL_TRIANGLES : GL_LINES;
+    if (chunks.empty())
+    {
+        glDrawElements(mode, count, indexType, (void*)(indexOffset + indexSize() * firstIndex));
+    }
+    else
+    {
+        const GLuint end = firstIndex + count;
+        for (const Chunk& chunk : chunks)
+        {
+            const GLuint first = std::max(firstIndex, chunk.firstIndex);
+            const GLuint last = std::min(end, chunk.firstIndex + chunk.count);
+            if (first >= last)
+                continue;
+            const GLuint offset = indexOffset + indexSize() * first;
+            glDrawElementsBaseVertex(mode, last - first, indexType, (void*)offset, chunk.baseVertex);
+        }
+    }
+#if GLPersistentMappingSupported
+    if (vertexStream.mapped)
+        vertexStream.fence();
+    if (indexStream.mapped)
+        indexStream.fence();
+#endif
+    if (autoUnbind)
+        unbind();
+}
+
+size_t GLMesh::selectLod(const glsl_math::mat4& projection, const glsl_math::mat4& modelView,
+    const glsl_math::vec3& center, double radius, double viewportHeight, double pixelError) const
+{
+    using namespace glsl_math;
+    // Errors and the radius are scaled by modelView as well.
+    const double scale = std::max(std::max(length(vec3(modelView[0])), length(vec3(modelView[1]))),
+        length(vec3(modelView[2])));
+    const double nearestZ = (modelView * vec4(center, 1)).z + radius * scale;
+    // Clip w at that depth: the distance for perspective, 1 for orthographic.
+    const double w = projection[2].w * nearestZ + projection[3].w;
+    if (w <= 0)
+        return 0;
+    const double pixelsPerUnit = projection[1].y * viewportHeight * 0.5 * scale / w;
+    size_t level = 0;
+    while (level + 1 < lods.size() && lods[level + 1].error * pixelsPerUnit <= pixelError)
+        ++level;
+    return level;
+}
+
+#if GLComputeSupported
+void GLMesh::renderIndirect(GLuint commandBuffer, GLsizei drawCount)
+{
+    if (drawCount == 0)
+        return;
     const bool autoUnbind = bind();
-    glDrawElements((primitive == TRIANGLES) ? GL_TRIANGLES : GL_LINES, indexCount, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glMultiDrawElementsIndirect((primitive == TRIANGLES) ? GL_TRIANGLES : GL_LINES, indexType, 0, drawCount, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
     if (autoUnbind)
         unbind();
 }
 
+void meshletCommands(const GLMesh& mesh, const Meshlet* meshlets, size_t count,
+    std::vector<GLDrawCommand>& commands)
+{
+    commands.clear();
+    const GLuint indexBase = mesh.indexOffset / mesh.indexSize();
+    const GLMesh::Chunk whole = { 0, mesh.indexCount, 0 };
+    const GLMesh::Chunk* chunk = mesh.chunks.empty() ? &whole : mesh.chunks.data();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const GLuint end = meshlets[i].firstIndex + meshlets[i].indexCount;
+        for (GLuint first = meshlets[i].firstIndex; first < end;)
+        {
+            // meshlets are in index order, so are the chunks
+            while (chunk->firstIndex + chunk->count <= first)
+                ++chunk;
+            const GLuint last = std::min(end, chunk->firstIndex + chunk->count);
+            commands.push_back(GLDrawCommand{ last - first, 1, indexBase + first,
+                static_cast<GLuint>(chunk->baseVertex), static_cast<GLuint>(i) });
+            first = last;
+        }
+    }
+}
+
+size_t cullMeshletCommands(const glsl_math::frustumf& f, const glsl_math::vec3f& eye, const Meshlet* meshlets,
+    GLDrawCommand* commands, size_t count)
+{
+    size_t visible = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Meshlet& m = meshlets[commands[i].baseInstance];
+        const bool isDrawn = isVisible(f, glsl_math::vec3f(m.sphere), m.sphere.w) && !isBackFacing(m, eye);
+        commands[i].instanceCount = isDrawn ? 1 : 0;
+        visible += isDrawn;
+    }
+    return visible;
+}
+
+// First fit. Returns the offset of count free elements taken from free, or
+// GLMeshArena::InvalidId.
+static GLuint allocateRange(std::vector<GLMeshArena::Range>& free, GLuint count)
+{
+    if (count == 0)
+        return 0;
+    for (auto it = free.begin(); it != free.end(); ++it)
+    {
+        if (it->count < count)
+            continue;
+        const GLuint offset = it->offset;
+        it->offset += count;
+        it->count -= count;
+        if (it->count == 0)
+            free.erase(it);
+        return offset;
+    }
+    return GLMeshArena::InvalidId;
+}
+
+// Gives back [offset, offset + count), merged with adjacent free ranges.
+static void freeRange(std::vector<GLMeshArena::Range>& free, GLuint offset, GLuint count)
+{
+    if (count == 0)
+        return;
+    auto it = std::lower_bound(free.begin(), free.end(), offset,
+        [](const GLMeshArena::Range& r, GLuint o) { return r.offset < o; });
+    if (it != free.begin() && (it - 1)->offset + (it - 1)->count == offset)
+    {
+        --it;
+        it->count += count;
+    }
+    else
+    {
+        it = free.insert(it, GLMeshArena::Range{ offset, count });
+    }
+    const auto next = it + 1;
+    if (next != free.end() && it->offset + it->count == next->offset)
+    {
+        it->count += next->count;
+        free.erase(next);
+    }
+}
+
+// Grows the arena by moreVertices and moreIndices at least, doubling it
+// otherwise. mesh.vertexCount and mesh.indexCount hold the capacities, so
+// GLMesh::reserve keeps all of the contents.
+static void growArena(GLMeshArena& arena, GLuint moreVertices, GLuint moreIndices)
+{
+    GLMesh& mesh = arena.mesh;
+    const GLuint vertexCount = moreVertices ? std::max(mesh.vertexCount + moreVertices, 2 * mesh.vertexCount)
+        : mesh.vertexCount;
+    const GLuint indexCount = moreIndices ? std::max(mesh.indexCount + moreIndices, 2 * mesh.indexCount)
+        : mesh.indexCount;
+    mesh.reserve(mesh.format, vertexCount, indexCount);
+    freeRange(arena.freeVertices, mesh.vertexCount, vertexCount - mesh.vertexCount);
+    freeRange(arena.freeIndices, mesh.indexCount, indexCount - mesh.indexCount);
+    mesh.vertexCount = vertexCount;
+    mesh.indexCount = indexCount;
+}
+
+static void writeBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GLMeshArena::GLMeshArena(GLMesh::Format format, GLuint vertexCapacity, GLuint indexCapacity,
+    GLMesh::Primitive primitive)
+    : mesh(format, 0, 0, primitive)
+    , commandCapacity(0)
+    , commandsChanged(false)
+{
+    glGenBuffers(1, &commandBuffer);
+    growArena(*this, vertexCapacity, indexCapacity);
+}
+
+void GLMeshArena::destroy()
+{
+    mesh.destroy();
+    glDeleteBuffers(1, &commandBuffer);
+}
+
+GLuint GLMeshArena::add(const GLfloat* vertexData, GLuint vertexCount, const GLuint* indexData, GLuint indexCount)
+{
+    GLuint baseVertex = allocateRange(freeVertices, vertexCount);
+    if (baseVertex == InvalidId)
+    {
+        growArena(*this, vertexCount, 0);
+        baseVertex = allocateRange(freeVertices, vertexCount);
+    }
+    GLuint firstIndex = allocateRange(freeIndices, indexCount);
+    if (firstIndex == InvalidId)
+    {
+        growArena(*this, 0, indexCount);
+        firstIndex = allocateRange(freeIndices, indexCount);
+    }
+
+    const GLuint stride = GLMeshLayouts[mesh.format].stride;
+    writeBuffer(mesh.vertexBuffer, stride * baseVertex, stride * vertexCount, vertexData);
+    writeBuffer(mesh.indexBuffer, sizeof(GLuint) * firstIndex, sizeof(GLuint) * indexCount, indexData);
+
+    GLuint id;
+    if (freeIds.empty())
+    {
+        id = static_cast<GLuint>(commandIndex.size());
+        commandIndex.push_back(0);
+        vertexCounts.push_back(0);
+    }
+    else
+    {
+        id = freeIds.back();
+        freeIds.pop_back();
+    }
+    commandIndex[id] = static_cast<GLuint>(commands.size());
+    vertexCounts[id] = vertexCount;
+    meshIds.push_back(id);
+    commands.push_back(GLDrawCommand{ indexCount, 1, firstIndex, baseVertex, 0 });
+    commandsChanged = true;
+    return id;
+}
+
+void GLMeshArena::updateVertices(GLuint id, const GLfloat* vertexData)
+{
+    assert(id < commandIndex.size() && commandIndex[id] != InvalidId);
+    const GLuint stride = GLMeshLayouts[mesh.format].stride;
+    writeBuffer(mesh.vertexBuffer, stride * commands[commandIndex[id]].baseVertex, stride * vertexCounts[id],
+        vertexData);
+}
+
+void GLMeshArena::remove(GLuint id)
+{
+    assert(id < commandIndex.size() && commandIndex[id] != InvalidId);
+    const GLuint i = commandIndex[id];
+    freeRange(freeVertices, commands[i].baseVertex, vertexCounts[id]);
+    freeRange(freeIndices, commands[i].firstIndex, commands[i].count);
+
+    // Move the last command into the hole.
+    commands[i] = commands.back();
+    meshIds[i] = meshIds.back();
+    commandIndex[meshIds[i]] = i;
+    commands.pop_back();
+    meshIds.pop_back();
+
+    commandIndex[id] = InvalidId;
+    freeIds.push_back(id);
+    commandsChanged = true;
+}
+
+void GLMeshArena::setInstanceCount(GLuint id, GLuint instanceCount)
+{
+    assert(id < commandIndex.size() && commandIndex[id] != InvalidId);
+    commands[commandIndex[id]].instanceCount = instanceCount;
+    commandsChanged = true;
+}
+
+void GLMeshArena::render()
+{
+    if (commands.empty())
+        return;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    if (commandsChanged)
+    {
+        uploadBuffer(GL_DRAW_INDIRECT_BUFFER, commandCapacity,
+            static_cast<GLuint>(sizeof(GLDrawCommand) * commands.size()), commands.data());
+        commandsChanged = false;
+    }
+    const bool autoUnbind = mesh.bind();
+    glMultiDrawElementsIndirect((mesh.primitive == GLMesh::TRIANGLES) ? GL_TRIANGLES : GL_LINES,
+        GL_UNSIGNED_INT, 0, static_cast<GLsizei>(commands.size()), 0);
+    if (autoUnbind)
+        mesh.unbind();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+#endif
+
 GLTexture::GLTexture(GLuint topology, GLuint format, GLuint internalFormat, GLuint type,
     GLuint minFilter, GLuint magFilter, GLuint wrapS, GLuint wrapT)
     : topology(topology)
@@ -513,6 +1210,13 @@ void GLTexture::setTexStorage2D(GLuint width, GLuint height, GLuint levels)
     glTexStorage2D(topology, levels, internalFormat, width, height);
 }
 
+void GLTexture::setTexStorage3D(GLuint width, GLuint height, GLuint depth, GLuint levels)
+{
+    assert(topology == GL_TEXTURE_3D);
+    glBindTexture(topology, texture);
+    glTexStorage3D(topology, levels, internalFormat, width, height, depth);
+}
+
 void GLTexture::generateMipmap()
 {
     glBindTexture(topology, texture);
@@ -593,6 +1297,53 @@ void FileBuffer::save(const char* file_name, bool text_mode)
     fclose(fp);
 }
 
+// openFiles holds the files being expanded, an #include of one of them
+// would recurse forever.
+static bool expandIncludeLines(std::vector<char>& buffer, std::vector<std::string>& openFiles)
+{
+    if (buffer.empty())
+        return true;
+
+    std::vector<char> text;
+    const char* line = buffer.data();
+    while (*line)
+    {
+        const char* end = strchr(line, '\n');
+        end = end ? end + 1 : line + strlen(line);
+        char file_name[256];
+        const std::string copy(line, end);
+        if (sscanf(copy.c_str(), " #include \"%255[^\"\n]\"", file_name) == 1)
+        {
+            if (std::find(openFiles.begin(), openFiles.end(), file_name) != openFiles.end())
+            {
+                fprintf(stderr, "ERROR: file %s includes itself\n", file_name);
+                return false;
+            }
+            FileBuffer file(file_name, true);
+            openFiles.push_back(file_name);
+            const bool ok = expandIncludeLines(file.buffer, openFiles);
+            openFiles.pop_back();
+            if (!ok)
+                return false;
+            if (file.buffer.size() > 1)
+                text.insert(text.end(), file.buffer.begin(), file.buffer.end() - 1);
+            text.push_back('\n');
+        }
+        else
+            text.insert(text.end(), line, end);
+        line = end;
+    }
+    text.push_back(0);
+    buffer.swap(text);
+    return true;
+}
+
+bool FileBuffer::expandIncludes()
+{
+    std::vector<std::string> openFiles;
+    return expandIncludeLines(buffer, openFiles);
+}
+
 MeshBuilder::MeshBuilder(GLMesh::Format format)
     : format(format)
 {
@@ -608,17 +1359,29 @@ void MeshBuilder::clear()
     currBeginOffset = 0;
     vertexData.resize(0);
     indexData.resize(0);
+    lods.clear();
+}
+
+// Truncates indexData to the finest level of detail: the passes work on
+// one level, generateLods builds the chain again.
+static void dropLods(std::vector<GLuint>& indexData, std::vector<GLMesh::Lod>& lods)
+{
+    if (lods.empty())
+        return;
+    indexData.resize(lods[0].count);
+    lods.clear();
 }
 
 void MeshBuilder::begin(Mode mode)
 {
+    dropLods(indexData, lods);
     currMode = mode;
     currBeginOffset = static_cast<GLuint>(vertexData.size());
 }
 
 void MeshBuilder::end()
 {
-    GLuint vertexSize = GLMeshStride[format] >> 2;
+    GLuint vertexSize = GLMeshLayouts[format].stride >> 2;
     GLuint it = currBeginOffset / vertexSize;
     GLuint itEnd = static_cast<GLuint>(vertexData.size()) / vertexSize;
     assert(it * vertexSize == currBeginOffset);
@@ -679,70 +1442,277 @@ void MeshBuilder::end()
     }
 }
 
-void MeshBuilder::vertex(const vec4& v)
+// Writes value in the type of attrib into the vertex at dst.
+static void packAttrib(const GLMeshAttrib& attrib, const glsl_math::vec4f& value, char* dst)
 {
-    vertexData.push_back(static_cast<float>(v.x));
-    vertexData.push_back(static_cast<float>(v.y));
-    vertexData.push_back(static_cast<float>(v.z));
-    if (format == GLMesh::PTNC) {
-        vertexData.push_back(static_cast<float>(v.w));
+    const float v[4] = { value.x, value.y, value.z, value.w };
+    dst += attrib.offset;
+    switch (attrib.type)
+    {
+    case GL_FLOAT:
+        memcpy(dst, v, sizeof(float) * attrib.size);
+        break;
+    case GL_HALF_FLOAT:
+        for (GLint i = 0; i < attrib.size; ++i)
+        {
+            const uint16_t h = glsl_math::packHalf(v[i]);
+            memcpy(dst + sizeof(h) * i, &h, sizeof(h));
+        }
+        break;
+    case GL_INT_2_10_10_10_REV:
+    {
+        const uint32_t p = glsl_math::packInt2101010Rev(value);
+        memcpy(dst, &p, sizeof(p));
+        break;
+    }
+    case GL_UNSIGNED_BYTE:
+    {
+        const uint32_t p = glsl_math::packUnorm4x8(value);
+        memcpy(dst, &p, sizeof(p));
+        break;
     }
-    if (format >= GLMesh::XYZUV) {
-        vertexData.push_back(static_cast<float>(currTexCoord.x));
-        vertexData.push_back(static_cast<float>(currTexCoord.y));
     }
-    if (format == GLMesh::PTNC) {
-        vertexData.push_back(static_cast<float>(currTexCoord.z));
-        vertexData.push_back(static_cast<float>(currTexCoord.w));
+}
+
+// Reads attrib of the vertex at src, absent components as in GL (0, 0, 0, 1).
+static glsl_math::vec4f unpackAttrib(const GLMeshAttrib& attrib, const char* src)
+{
+    float v[4] = { 0, 0, 0, 1 };
+    src += attrib.offset;
+    switch (attrib.type)
+    {
+    case GL_FLOAT:
+        memcpy(v, src, sizeof(float) * attrib.size);
+        break;
+    case GL_HALF_FLOAT:
+        for (GLint i = 0; i < attrib.size; ++i)
+        {
+            uint16_t h;
+            memcpy(&h, src + sizeof(h) * i, sizeof(h));
+            v[i] = glsl_math::unpackHalf(h);
+        }
+        break;
+    case GL_INT_2_10_10_10_REV:
+    {
+        uint32_t p;
+        memcpy(&p, src, sizeof(p));
+        return glsl_math::unpackInt2101010Rev(p);
     }
-    if (format >= GLMesh::XYZUVN) {
-        vertexData.push_back(static_cast<float>(currNormal.x));
-        vertexData.push_back(static_cast<float>(currNormal.y));
-        vertexData.push_back(static_cast<float>(currNormal.z));
+    case GL_UNSIGNED_BYTE:
+    {
+        uint32_t p;
+        memcpy(&p, src, sizeof(p));
+        return glsl_math::unpackUnorm4x8(p);
     }
-    if (format >= GLMesh::XYZUVNC) {
-        vertexData.push_back(static_cast<float>(currColor.x));
-        vertexData.push_back(static_cast<float>(currColor.y));
-        vertexData.push_back(static_cast<float>(currColor.z));
-        vertexData.push_back(static_cast<float>(currColor.w));
     }
+    return glsl_math::vec4f(v[0], v[1], v[2], v[3]);
+}
+
+void MeshBuilder::vertex(const vec4& v)
+{
+    vertex(v, currTexCoord, currNormal, currColor);
 }
 
 void MeshBuilder::vertex(const vec4& v, const vec4& t, const vec3& n, const vec4& c)
 {
-    vertexData.push_back(static_cast<float>(v.x));
-    vertexData.push_back(static_cast<float>(v.y));
-    vertexData.push_back(static_cast<float>(v.z));
-    if (format == GLMesh::PTNC) {
-        vertexData.push_back(static_cast<float>(v.w));
+    const GLMeshLayout& layout = GLMeshLayouts[format];
+    const size_t offset = vertexData.size();
+    vertexData.resize(offset + (layout.stride >> 2));
+    char* dst = reinterpret_cast<char*>(vertexData.data() + offset);
+    const glsl_math::vec4f values[4] = {
+        glsl_math::vec4f(v), glsl_math::vec4f(t), glsl_math::vec4f(vec4(n, 0)), glsl_math::vec4f(c)
+    };
+    for (GLuint attrloc = PositionAttribLocation; attrloc <= ColorAttribLocation; ++attrloc)
+        if (layout.attribs[attrloc].size)
+            packAttrib(layout.attribs[attrloc], values[attrloc], dst);
+}
+
+void MeshBuilder::transform(const glsl_math::mat4& m)
+{
+    const GLMeshLayout& layout = GLMeshLayouts[format];
+    const GLuint vertexSize = layout.stride >> 2;
+    if (!vertexSize)
+        return;
+    const size_t count = vertexData.size() / vertexSize;
+    const GLMeshAttrib& position = layout.attribs[PositionAttribLocation];
+    const GLMeshAttrib& normal = layout.attribs[NormalAttribLocation];
+    if (position.type == GL_FLOAT)
+    {
+        float* data = vertexData.data();
+        glsl_math::transformPoints(m, data, data, count, vertexSize, position.size);
+        if (normal.size)
+        {
+            const GLuint normalOffset = normal.offset >> 2;
+            glsl_math::transformNormals(m, data + normalOffset, data + normalOffset, count, vertexSize);
+        }
+        return;
+    }
+
+    // Packed: through a float copy, position xyzw and normal xyz per 8 floats.
+    std::vector<float> points(8 * count);
+    char* data = reinterpret_cast<char*>(vertexData.data());
+    for (size_t i = 0; i < count; ++i)
+    {
+        const glsl_math::vec4f p = unpackAttrib(position, data + layout.stride * i);
+        const glsl_math::vec4f n = normal.size ? unpackAttrib(normal, data + layout.stride * i) : p;
+        const float v[8] = { p.x, p.y, p.z, p.w, n.x, n.y, n.z, 0 };
+        memcpy(&points[8 * i], v, sizeof(v));
+    }
+    glsl_math::transformPoints(m, points.data(), points.data(), count, 8, 4);
+    if (normal.size)
+        glsl_math::transformNormals(m, points.data() + 4, points.data() + 4, count, 8);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* v = &points[8 * i];
+        packAttrib(position, glsl_math::vec4f(v[0], v[1], v[2], v[3]), data + layout.stride * i);
+        if (normal.size)
+            packAttrib(normal, glsl_math::vec4f(v[4], v[5], v[6], 0), data + layout.stride * i);
+    }
+}
+
+GLuint MeshBuilder::weld(float positionEpsilon, float texCoordEpsilon, float normalEpsilon, float colorEpsilon)
+{
+    dropLods(indexData, lods);
+    const GLMeshLayout& layout = GLMeshLayouts[format];
+    const GLuint vertexSize = layout.stride >> 2;
+    if (!vertexSize)
+        return 0;
+    std::vector<float> epsilons(vertexSize, 0.0f);
+    if (!GLMesh::isPacked(format))
+    {
+        const float attribEpsilons[4] = { positionEpsilon, texCoordEpsilon, normalEpsilon, colorEpsilon };
+        for (GLuint attrloc = PositionAttribLocation; attrloc <= ColorAttribLocation; ++attrloc)
+        {
+            const GLMeshAttrib& attrib = layout.attribs[attrloc];
+            for (GLint c = 0; c < attrib.size; ++c)
+                epsilons[(attrib.offset >> 2) + c] = attribEpsilons[attrloc];
+        }
+    }
+    const size_t kept = weldVertices(vertexData.data(), vertexSize, indexData.data(), indexData.size(),
+        vertexData.size() / vertexSize, epsilons.data());
+    vertexData.resize(kept * vertexSize);
+    currBeginOffset = static_cast<GLuint>(vertexData.size());
+    return static_cast<GLuint>(kept);
+}
+
+// Positions of packed vertices as 3 floats each, for the passes of
+// meshOptimizer.h.
+static std::vector<float> unpackPositions(const GLMeshLayout& layout, const float* vertexData, size_t vertexCount)
+{
+    const GLMeshAttrib& position = layout.attribs[PositionAttribLocation];
+    std::vector<float> positions(3 * vertexCount);
+    const char* data = reinterpret_cast<const char*>(vertexData);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const glsl_math::vec4f p = unpackAttrib(position, data + layout.stride * i);
+        positions[3 * i] = p.x;
+        positions[3 * i + 1] = p.y;
+        positions[3 * i + 2] = p.z;
     }
-    if (format >= GLMesh::XYZUV) {
-        vertexData.push_back(static_cast<float>(t.x));
-        vertexData.push_back(static_cast<float>(t.y));
+    return positions;
+}
+
+MeshBuilder::OptimizeReport MeshBuilder::optimize(float overdrawThreshold)
+{
+    dropLods(indexData, lods);
+    const GLMeshLayout& layout = GLMeshLayouts[format];
+    const GLuint vertexSize = layout.stride >> 2;
+    const size_t vertexCount = vertexSize ? vertexData.size() / vertexSize : 0;
+    OptimizeReport report;
+    report.acmrBefore = vertexCacheAcmr(indexData.data(), indexData.size(), vertexCount);
+    report.acmrAfter = report.acmrBefore;
+    if (vertexCount == 0 || static_cast<unsigned>(currMode) <= static_cast<unsigned>(LINE_LOOP))
+        return report;
+
+    optimizeVertexCache(indexData.data(), indexData.data(), indexData.size(), vertexCount);
+    const GLMeshAttrib& position = layout.attribs[PositionAttribLocation];
+    if (position.type == GL_FLOAT)
+    {
+        optimizeOverdraw(indexData.data(), indexData.size(), vertexData.data(), vertexSize, vertexCount,
+            overdrawThreshold);
+    }
+    else
+    {
+        const std::vector<float> positions = unpackPositions(layout, vertexData.data(), vertexCount);
+        optimizeOverdraw(indexData.data(), indexData.size(), positions.data(), 3, vertexCount, overdrawThreshold);
     }
-    if (format == GLMesh::PTNC) {
-        vertexData.push_back(static_cast<float>(t.z));
-        vertexData.push_back(static_cast<float>(t.w));
+    report.acmrAfter = vertexCacheAcmr(indexData.data(), indexData.size(), vertexCount);
+
+    const size_t kept = optimizeVertexFetch(vertexData.data(), indexData.data(), indexData.size(), vertexCount,
+        layout.stride);
+    vertexData.resize(kept * vertexSize);
+    currBeginOffset = static_cast<GLuint>(vertexData.size());
+    return report;
+}
+
+void MeshBuilder::buildMeshlets(std::vector<Meshlet>& meshlets, GLuint maxTriangles)
+{
+    dropLods(indexData, lods);
+    meshlets.clear();
+    const GLMeshLayout& layout = GLMeshLayouts[format];
+    const GLuint vertexSize = layout.stride >> 2;
+    const size_t vertexCount = vertexSize ? vertexData.size() / vertexSize : 0;
+    if (vertexCount == 0 || static_cast<unsigned>(currMode) <= static_cast<unsigned>(LINE_LOOP))
+        return;
+
+    const GLMeshAttrib& position = layout.attribs[PositionAttribLocation];
+    if (position.type == GL_FLOAT)
+    {
+        ::buildMeshlets(indexData.data(), indexData.size(), vertexData.data(), vertexSize, vertexCount, meshlets,
+            maxTriangles);
+        return;
     }
-    if (format >= GLMesh::XYZUVN) {
-        vertexData.push_back(static_cast<float>(n.x));
-        vertexData.push_back(static_cast<float>(n.y));
-        vertexData.push_back(static_cast<float>(n.z));
+    const std::vector<float> positions = unpackPositions(layout, vertexData.data(), vertexCount);
+    ::buildMeshlets(indexData.data(), indexData.size(), positions.data(), 3, vertexCount, meshlets, maxTriangles);
+}
+
+size_t MeshBuilder::generateLods(float maxError, size_t maxLevels, float reduction)
+{
+    const GLMeshLayout& layout = GLMeshLayouts[format];
+    const GLuint vertexSize = layout.stride >> 2;
+    const size_t vertexCount = vertexSize ? vertexData.size() / vertexSize : 0;
+    dropLods(indexData, lods);
+    const size_t indexCount = indexData.size();
+    lods.assign(1, GLMesh::Lod{ 0, static_cast<GLuint>(indexCount), 0.0f });
+    if (vertexCount == 0 || static_cast<unsigned>(currMode) <= static_cast<unsigned>(LINE_LOOP))
+        return lods.size();
+
+    std::vector<float> unpacked;
+    const float* positions = vertexData.data();
+    size_t stride = vertexSize;
+    if (layout.attribs[PositionAttribLocation].type != GL_FLOAT)
+    {
+        unpacked = unpackPositions(layout, vertexData.data(), vertexCount);
+        positions = unpacked.data();
+        stride = 3;
     }
-    if (format >= GLMesh::XYZUVNC) {
-        vertexData.push_back(static_cast<float>(c.x));
-        vertexData.push_back(static_cast<float>(c.y));
-        vertexData.push_back(static_cast<float>(c.z));
-        vertexData.push_back(static_cast<float>(c.w));
+    std::vector<GLuint> level(indexCount);
+    while (lods.size() < maxLevels)
+    {
+        const GLMesh::Lod& prev = lods.back();
+        const size_t target = static_cast<size_t>(prev.count / 3 * reduction) * 3;
+        float error;
+        const size_t count = simplify(level.data(), indexData.data(), indexCount, positions, stride, vertexCount,
+            target, maxError, &error);
+        // less than 5% fewer triangles: stuck on the error or the borders
+        if (count == 0 || 20 * count > 19 * prev.count)
+            break;
+        optimizeVertexCache(level.data(), level.data(), count, vertexCount);
+        lods.push_back(GLMesh::Lod{ static_cast<GLuint>(indexData.size()), static_cast<GLuint>(count),
+            std::max(error, prev.error) });
+        indexData.insert(indexData.end(), level.begin(), level.begin() + count);
     }
+    return lods.size();
 }
 
 GLMesh MeshBuilder::compile() const
 {
     const auto primitive = (static_cast<unsigned>(currMode) <= static_cast<unsigned>(LINE_LOOP))
         ? GLMesh::LINES : GLMesh::TRIANGLES;
-    return GLMesh(format, vertexData.data(), vertexData.size(), indexData.data(), indexData.size(),
-        primitive);
+    const GLuint vertexCount = static_cast<GLuint>(vertexData.size()) / (GLMeshLayouts[format].stride >> 2);
+    GLMesh mesh(format, vertexData.data(), vertexCount, indexData.data(), indexData.size(), primitive);
+    mesh.lods = lods;
+    return mesh;
 }
 
 void MeshBuilder::compile(GLMesh& mesh) const
@@ -750,8 +1720,128 @@ void MeshBuilder::compile(GLMesh& mesh) const
     const bool autoUnbind = mesh.bind();
     const auto primitive = (static_cast<unsigned>(currMode) <= static_cast<unsigned>(LINE_LOOP))
         ? GLMesh::LINES : GLMesh::TRIANGLES;
-    mesh.updateVertices(format, vertexData.data(), vertexData.size());
+    const GLuint vertexCount = static_cast<GLuint>(vertexData.size()) / (GLMeshLayouts[format].stride >> 2);
+    mesh.updateVertices(format, vertexData.data(), vertexCount);
     mesh.updateIndices(indexData.data(), indexData.size(), primitive);
+    mesh.lods = lods;
     if (autoUnbind)
         mesh.unbind();
 }
+
+#if GLComputeSupported
+GLuint MeshBuilder::compile(GLMeshArena& arena) const
+{
+    assert(arena.mesh.format == format);
+    const GLuint vertexCount = static_cast<GLuint>(vertexData.size()) / (GLMeshLayouts[format].stride >> 2);
+    // finest level only, the arena draws all indices of a mesh
+    const GLuint indexCount = lods.empty() ? static_cast<GLuint>(indexData.size()) : lods[0].count;
+    return arena.add(vertexData.data(), vertexCount, indexData.data(), indexCount);
+}
+#endif
+
+#if GLComputeSupported
+constexpr GLuint GLNoiseBaker::permutationBinding;
+
+GLNoiseBaker::GLNoiseBaker(const PerlinNoise& noise)
+{
+    glGenBuffers(1, &permutationBuffer);
+    setNoise(noise);
+}
+
+void GLNoiseBaker::destroy()
+{
+    for (const Program& p : programs)
+        glDeleteProgram(p.program);
+    programs.clear();
+    glDeleteBuffers(1, &permutationBuffer);
+}
+
+void GLNoiseBaker::setNoise(const PerlinNoise& noise)
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, permutationBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, PerlinNoise::permutationSize, noise.permutation(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+bool GLNoiseBaker::bake2D(GLTexture& texture, GLuint width, GLuint height, const FractalNoise& f,
+    const glsl_math::vec2f& origin, const glsl_math::vec2f& step)
+{
+    assert(texture.topology == GL_TEXTURE_2D);
+    return bake(texture, 2, width, height, 1, f,
+        glsl_math::vec3f(origin.x, origin.y, 0), glsl_math::vec3f(step.x, step.y, 0));
+}
+
+bool GLNoiseBaker::bake3D(GLTexture& texture, GLuint width, GLuint height, GLuint depth, const FractalNoise& f,
+    const glsl_math::vec3f& origin, const glsl_math::vec3f& step)
+{
+    assert(texture.topology == GL_TEXTURE_3D);
+    return bake(texture, 3, width, height, depth, f, origin, step);
+}
+
+// noiseBake.comp has no #version line, it is compiled once per image type
+// with the version and its parameters defined in front.
+GLuint GLNoiseBaker::program(int dims, GLuint internalFormat)
+{
+    for (const Program& p : programs)
+        if (p.dims == dims && p.internalFormat == internalFormat)
+            return p.program;
+
+    const char* format =
+        (internalFormat == GL_R32F) ? "r32f" :
+        (internalFormat == GL_RGBA16F) ? "rgba16f" :
+        (internalFormat == GL_RGBA32F) ? "rgba32f" : nullptr;
+    if (!format)
+    {
+        fprintf(stderr, "ERROR: cannot bake noise into texture format 0x%x\n", internalFormat);
+        return 0;
+    }
+
+    FileBuffer source("noiseBake.comp", true);
+    if (source.buffer.empty())
+        return 0;
+    if (!source.expandIncludes())
+        return 0;
+
+    char header[256];
+    snprintf(header, sizeof(header),
+        "#version 430\n#define BakeDims %d\n#define BakeFormat %s\n#define PerlinNoiseBinding %u\n",
+        dims, format, permutationBinding);
+    const std::string text = header + std::string(source.buffer.data());
+    const GLuint program = compileComputeProgram(text.c_str());
+    if (program != 0)
+        programs.push_back({ dims, internalFormat, program });
+    return program;
+}
+
+bool GLNoiseBaker::bake(GLTexture& texture, int dims, GLuint width, GLuint height, GLuint depth,
+    const FractalNoise& f, const glsl_math::vec3f& origin, const glsl_math::vec3f& step)
+{
+    const GLuint p = program(dims, texture.internalFormat);
+    if (p == 0)
+        return false;
+
+    glUseProgram(p);
+    glUniform1i(glGetUniformLocation(p, "uNoise.type"), f.type);
+    glUniform1i(glGetUniformLocation(p, "uNoise.octaves"), f.octaves);
+    glUniform1f(glGetUniformLocation(p, "uNoise.frequency"), f.frequency);
+    glUniform1f(glGetUniformLocation(p, "uNoise.lacunarity"), f.lacunarity);
+    glUniform1f(glGetUniformLocation(p, "uNoise.gain"), f.gain);
+    glUniform1f(glGetUniformLocation(p, "uNoise.ridgeOffset"), f.ridgeOffset);
+    glUniform1f(glGetUniformLocation(p, "uNoise.warp"), f.warp);
+    glUniform1i(glGetUniformLocation(p, "uNoise.warpOctaves"), f.warpOctaves);
+    glUniform3f(glGetUniformLocation(p, "uOrigin"), origin.x, origin.y, origin.z);
+    glUniform3f(glGetUniformLocation(p, "uStep"), step.x, step.y, step.z);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, permutationBinding, permutationBuffer);
+    texture.bindImage(p, 0, GL_WRITE_ONLY, 0, dims == 3);
+    if (dims == 2)
+        glDispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+    else
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, (depth + 3) / 4);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, permutationBinding, 0);
+
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT
+        | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    return true;
+}
+#endif
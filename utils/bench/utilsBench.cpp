@@ -0,0 +1,384 @@
+// Micro-benchmarks of the utils library
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Usage: utilsBench [--filter text] [--json out.json]
+//                   [--baseline base.json] [--tolerance 0.10]
+//
+// Prints ns/op and millions of ops per second for each benchmark, the
+// best of several timed runs. --json saves the results; --baseline reads
+// a file saved earlier, prints the ratio to it and exits with 1 when any
+// benchmark got slower by more than the tolerance (10% by default).
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fractalNoise.h>
+#include <glslCulling.h>
+#include <glslMath.h>
+#include <glslMathBatch.h>
+#include <glslPacking.h>
+#include <glslQuat.h>
+#include <perlinNoise.h>
+#include <simplexNoise.h>
+
+using namespace glsl_math;
+
+static const size_t DataSize = 1024; // power of two
+static const int Runs = 7;
+static const double RunSeconds = 0.02;
+
+// Benchmarks add a bit of each result here so the work is not optimized out.
+static volatile float sink;
+
+struct Benchmark
+{
+    const char* name;
+    // Runs ops operations (a multiple of DataSize).
+    std::function<void(size_t ops)> run;
+};
+
+struct Result
+{
+    std::string name;
+    double nsPerOp;
+};
+
+static float randomFloat(uint32_t& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) / 16777216.0f * 2 - 1;
+}
+
+struct Data
+{
+    std::vector<mat4f> mf;
+    std::vector<mat4> md;
+    std::vector<mat3> rotations;
+    std::vector<vec3f> v3;
+    std::vector<quatf> qa, qb, qout;
+    std::vector<float> floats, vertices;
+    // fractal2dGrid output, floats is the input of the other benchmarks
+    std::vector<float> noiseGrid;
+    std::vector<uint16_t> halfs;
+    std::vector<aabbf> boxes;
+    std::vector<uint32_t> indices;
+
+    Data()
+    {
+        uint32_t seed = 1;
+        for (size_t i = 0; i < DataSize; ++i)
+        {
+            mat4 m(1);
+            translate(m, randomFloat(seed), randomFloat(seed), randomFloat(seed));
+            rotate(m, randomFloat(seed) * 180, randomFloat(seed), randomFloat(seed), 1.0f);
+            md.push_back(m);
+            mf.push_back(mat4f(m));
+            rotations.push_back(mat3(m));
+            v3.push_back(vec3f(randomFloat(seed), randomFloat(seed), randomFloat(seed)));
+            qa.push_back(quatRotation(randomFloat(seed) * 180, randomFloat(seed), 1.0f, randomFloat(seed)));
+            qb.push_back(quatRotation(randomFloat(seed) * 180, 1.0f, randomFloat(seed), randomFloat(seed)));
+            const vec3f c = v3.back() * 50.0f;
+            boxes.push_back(aabbf(c - 1.0f, c + 1.0f));
+        }
+        qout.resize(DataSize);
+        for (size_t i = 0; i < DataSize * 15; ++i)
+            floats.push_back(randomFloat(seed) * 100);
+        vertices = floats;
+        halfs.resize(DataSize * 15);
+        indices.resize(DataSize);
+        noiseGrid.resize(32 * 32);
+    }
+};
+
+static std::vector<Benchmark> benchmarks(Data& d)
+{
+    const size_t mask = DataSize - 1;
+    return {
+        { "mat4f multiply", [&](size_t ops) {
+            mat4f acc(1);
+            for (size_t i = 0; i < ops; ++i)
+                acc = d.mf[i & mask] * acc;
+            sink = sink + acc[3].x;
+        } },
+        { "mat4 multiply", [&](size_t ops) {
+            mat4 acc(1);
+            for (size_t i = 0; i < ops; ++i)
+                acc = d.md[i & mask] * acc;
+            sink = sink + static_cast<float>(acc[3].x);
+        } },
+        { "mat4f inverse", [&](size_t ops) {
+            float s = 0;
+            for (size_t i = 0; i < ops; ++i)
+                s += inverse(d.mf[i & mask])[3].x;
+            sink = sink + s;
+        } },
+        { "mat4 inverse", [&](size_t ops) {
+            double s = 0;
+            for (size_t i = 0; i < ops; ++i)
+                s += inverse(d.md[i & mask])[3].x;
+            sink = sink + static_cast<float>(s);
+        } },
+        { "mat4f inverseAffine", [&](size_t ops) {
+            float s = 0;
+            for (size_t i = 0; i < ops; ++i)
+                s += inverseAffine(d.mf[i & mask])[3].x;
+            sink = sink + s;
+        } },
+        { "vec3f normalize", [&](size_t ops) {
+            vec3f s(0);
+            for (size_t i = 0; i < ops; ++i)
+                s += normalize(d.v3[i & mask]);
+            sink = sink + s.x;
+        } },
+        { "mat3 slerp", [&](size_t ops) {
+            double s = 0;
+            mat3 m;
+            for (size_t i = 0; i < ops; ++i)
+            {
+                slerp(m, d.rotations[i & mask], d.rotations[(i + 1) & mask], 0.3);
+                s += m[0].x;
+            }
+            sink = sink + static_cast<float>(s);
+        } },
+        { "quatf slerp", [&](size_t ops) {
+            float s = 0;
+            for (size_t i = 0; i < ops; ++i)
+                s += slerp(d.qa[i & mask], d.qb[i & mask], 0.3f).w;
+            sink = sink + s;
+        } },
+        { "quatf slerp batch", [&](size_t ops) {
+            for (size_t i = 0; i < ops; i += DataSize)
+                slerp(d.qa.data(), d.qb.data(), 0.3f, d.qout.data(), DataSize);
+            sink = sink + d.qout[0].w;
+        } },
+        { "convert mat4", [&](size_t ops) {
+            float m[16], s = 0;
+            for (size_t i = 0; i < ops; ++i)
+            {
+                convert(d.md[i & mask], m);
+                s += m[13];
+            }
+            sink = sink + s;
+        } },
+        { "transformPoints", [&](size_t ops) {
+            for (size_t i = 0; i < ops; i += DataSize)
+                transformPoints(d.mf[i & mask], d.floats.data(), d.vertices.data(), DataSize, 15);
+            sink = sink + d.vertices[0];
+        } },
+        { "packHalf", [&](size_t ops) {
+            for (size_t i = 0; i < ops; i += DataSize)
+                packHalf(d.floats.data(), d.halfs.data(), DataSize);
+            sink = sink + d.halfs[0];
+        } },
+        { "cullBoxes", [&](size_t ops) {
+            const frustumf f(mat4f(perspectiveProjection(60.0, 1.5, 0.5, 100.0)));
+            size_t n = 0;
+            for (size_t i = 0; i < ops; i += DataSize)
+                n += cullBoxes(f, d.boxes.data(), DataSize, d.indices.data());
+            sink = sink + static_cast<float>(n);
+        } },
+        { "noise1d", [&](size_t ops) {
+            float s = 0;
+            for (size_t i = 0; i < ops; ++i)
+                s += noise1d(d.floats[i & mask]);
+            sink = sink + s;
+        } },
+        { "noise2d", [&](size_t ops) {
+            float s = 0;
+            for (size_t i = 0; i < ops; ++i)
+                s += noise2d(d.floats[i & mask], d.floats[(i + 1) & mask]);
+            sink = sink + s;
+        } },
+        { "noise3d", [&](size_t ops) {
+            float s = 0;
+            for (size_t i = 0; i < ops; ++i)
+                s += noise3d(d.floats[i & mask], d.floats[(i + 1) & mask], d.floats[(i + 2) & mask]);
+            sink = sink + s;
+        } },
+        { "simplex3d", [&](size_t ops) {
+            float s = 0;
+            for (size_t i = 0; i < ops; ++i)
+                s += simplex3d(d.floats[i & mask], d.floats[(i + 1) & mask], d.floats[(i + 2) & mask]);
+            sink = sink + s;
+        } },
+        { "simplex4d", [&](size_t ops) {
+            float s = 0;
+            for (size_t i = 0; i < ops; ++i)
+                s += simplex4d(d.floats[i & mask], d.floats[(i + 1) & mask], d.floats[(i + 2) & mask],
+                    d.floats[(i + 3) & mask]);
+            sink = sink + s;
+        } },
+        { "fractal2dGrid fBm", [&](size_t ops) {
+            // 6 octaves per point, a 32 x 32 block per DataSize points
+            FractalNoise f;
+            f.frequency = 1.0f / 64;
+            for (size_t i = 0; i < ops; i += DataSize)
+                fractal2dGrid(PerlinNoise::global(), f, static_cast<float>(i & 0xffff), 0, 1, 1, 32, 32,
+                    d.noiseGrid.data());
+            sink = sink + d.noiseGrid[0];
+        } },
+        { "noise3d 16 fields", [&](size_t ops) {
+            static const std::vector<PerlinNoise> fields = [] {
+                std::vector<PerlinNoise> v;
+                for (uint32_t seed = 1; seed <= 16; ++seed)
+                    v.emplace_back(seed);
+                return v;
+            }();
+            float s = 0;
+            for (size_t i = 0; i < ops; ++i)
+                s += fields[i & 15].noise3d(d.floats[i & mask], d.floats[(i + 1) & mask], d.floats[(i + 2) & mask]);
+            sink = sink + s;
+        } },
+    };
+}
+
+static double seconds(const std::function<void(size_t)>& run, size_t ops)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    run(ops);
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1 - t0).count();
+}
+
+// Best ns/op of Runs runs, each scaled to take about RunSeconds.
+static double measure(const Benchmark& b)
+{
+    size_t ops = DataSize;
+    while (seconds(b.run, ops) < RunSeconds / 4 && ops < (size_t(1) << 40))
+        ops *= 2;
+    double best = 1e30;
+    for (int r = 0; r < Runs; ++r)
+    {
+        const double s = seconds(b.run, ops);
+        best = (s < best) ? s : best;
+    }
+    return best * 1e9 / ops;
+}
+
+static bool writeJson(const char* path, const std::vector<Result>& results)
+{
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return false;
+    fprintf(f, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i)
+        fprintf(f, "    { \"name\": \"%s\", \"ns_per_op\": %.4f, \"mops_per_s\": %.2f }%s\n",
+            results[i].name.c_str(), results[i].nsPerOp, 1e3 / results[i].nsPerOp,
+            (i + 1 < results.size()) ? "," : "");
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+// Reads the name -> ns_per_op pairs of a file written by writeJson.
+static bool readJson(const char* path, std::map<std::string, double>& baseline)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        text.append(buf, n);
+    fclose(f);
+
+    const std::string nameKey = "\"name\": \"";
+    const std::string nsKey = "\"ns_per_op\":";
+    for (size_t pos = text.find(nameKey); pos != std::string::npos; pos = text.find(nameKey, pos))
+    {
+        pos += nameKey.size();
+        const size_t end = text.find('"', pos);
+        const size_t ns = text.find(nsKey, end);
+        if (end == std::string::npos || ns == std::string::npos)
+            return false;
+        baseline[text.substr(pos, end - pos)] = strtod(text.c_str() + ns + nsKey.size(), nullptr);
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = nullptr;
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+    double tolerance = 0.10;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (!strcmp(argv[i], "--baseline") && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--filter text] [--json out.json] "
+                "[--baseline base.json] [--tolerance 0.10]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (baselinePath && !readJson(baselinePath, baseline))
+    {
+        fprintf(stderr, "cannot read baseline %s\n", baselinePath);
+        return EXIT_FAILURE;
+    }
+
+    Data data;
+    std::vector<Result> results;
+    int regressions = 0;
+    printf("%-22s %10s %10s%s\n", "benchmark", "ns/op", "Mops/s", baselinePath ? "   vs baseline" : "");
+    for (const Benchmark& b : benchmarks(data))
+    {
+        if (filter && !strstr(b.name, filter))
+            continue;
+        const double ns = measure(b);
+        results.push_back({ b.name, ns });
+        printf("%-22s %10.3f %10.2f", b.name, ns, 1e3 / ns);
+        const auto base = baseline.find(b.name);
+        if (base != baseline.end())
+        {
+            const double ratio = ns / base->second;
+            const bool slower = ratio > 1 + tolerance;
+            regressions += slower;
+            printf("   %6.2fx%s", ratio, slower ? "  REGRESSION" : "");
+        }
+        printf("\n");
+    }
+
+    if (jsonPath && !writeJson(jsonPath, results))
+    {
+        fprintf(stderr, "cannot write %s\n", jsonPath);
+        return EXIT_FAILURE;
+    }
+    if (regressions)
+    {
+        printf("%d benchmark(s) slower than baseline by more than %.0f%%\n", regressions, tolerance * 100);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
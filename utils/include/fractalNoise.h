@@ -0,0 +1,78 @@
+// Fractal Perlin-noise generators
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <perlinNoise.h>
+
+// Sums of PerlinNoise octaves, octave k sampled at p * frequency * lacunarity^k
+// with amplitude gain^k:
+//
+//   FBm         sum of n
+//   Turbulence  sum of |n|
+//   Ridged      sum of r * w, r = (ridgeOffset - |n|)^2 and w = clamp(r, 0, 1)
+//               of the previous octave (1 for the first one)
+//
+// With warp != 0 the domain is distorted first by warp times fBm of
+// warpOctaves octaves (p' = p + warp * q, q sampled at shifted copies of p).
+// A 4k x 4k heightmap:
+//
+//   FractalNoise f;
+//   f.frequency = 1.0f / 256;
+//   fractal2dGrid(PerlinNoise::global(), f, 0, 0, 1, 1, 4096, 4096, heights.data());
+
+struct FractalNoise
+{
+    enum Type { FBm, Ridged, Turbulence };
+
+    Type type = FBm;
+    int octaves = 6;
+    float frequency = 1.0f;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    float ridgeOffset = 1.0f;
+    float warp = 0.0f;
+    int warpOctaves = 3;
+};
+
+float fractal2d(const PerlinNoise& noise, const FractalNoise& f, float x, float y);
+float fractal3d(const PerlinNoise& noise, const FractalNoise& f, float x, float y, float z);
+
+// Same values with the analytic gradient in grad, e.g. the heightmap
+// normal is normalize(vec3(-grad[0], -grad[1], 1)).
+float fractal2d(const PerlinNoise& noise, const FractalNoise& f, float x, float y, float grad[2]);
+float fractal3d(const PerlinNoise& noise, const FractalNoise& f, float x, float y, float z, float grad[3]);
+
+// Batch and grid versions (same layout as noise2dBatch/noise2dGrid etc.),
+// split into tiles across ThreadPool::global() with the 8-wide noise
+// kernels inside each tile. Results match the functions above up to FMA
+// contraction differences.
+void fractal2dBatch(const PerlinNoise& noise, const FractalNoise& f,
+    const float* x, const float* y, float* out, size_t count);
+void fractal3dBatch(const PerlinNoise& noise, const FractalNoise& f,
+    const float* x, const float* y, const float* z, float* out, size_t count);
+void fractal2dGrid(const PerlinNoise& noise, const FractalNoise& f,
+    float x0, float y0, float dx, float dy, size_t width, size_t height, float* out);
+void fractal3dGrid(const PerlinNoise& noise, const FractalNoise& f,
+    float x0, float y0, float z0, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out);
+
+// Grids with the gradients interleaved in grad (2 or 3 floats per point).
+void fractal2dGrid(const PerlinNoise& noise, const FractalNoise& f,
+    float x0, float y0, float dx, float dy, size_t width, size_t height, float* out, float* grad);
+void fractal3dGrid(const PerlinNoise& noise, const FractalNoise& f,
+    float x0, float y0, float z0, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out, float* grad);
@@ -0,0 +1,108 @@
+// GLSL-like math library - frustum culling
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <glslMath.h>
+
+// Frustum planes of any projection * modelView matrix (perspective or
+// orthographic) and visibility tests of bounding spheres and boxes given
+// in the coordinates the matrix transforms from:
+//
+//   const frustumf f(mat4f(projection * modelView));
+//   const size_t n = cullBoxes(f, bounds.data(), bounds.size(), visible.data());
+//   for (size_t i = 0; i < n; ++i)
+//       meshes[visible[i]].render();
+//
+// The tests are conservative: volumes near a frustum corner may be
+// reported visible although they are outside, never the other way round.
+
+namespace glsl_math
+{
+
+// Axis aligned bounding box.
+template <typename T>
+class taabb {
+public:
+    tvec3<T> min, max;
+    taabb<T>() = default;
+    constexpr taabb<T>(const tvec3<T>& min, const tvec3<T>& max) : min(min), max(max) { }
+};
+
+template <typename T>
+class tfrustum {
+public:
+    enum Plane { Left, Right, Bottom, Top, Near, Far };
+
+    // Normalized planes (n.x, n.y, n.z, d), inside where dot(n, p) + d >= 0.
+    tvec4<T> planes[6];
+
+    tfrustum<T>() = default;
+    // Gribb-Hartmann extraction for OpenGL clip space (-w <= z <= w).
+    explicit tfrustum<T>(const tmat4<T>& m)
+    {
+        const tvec4<T> row[4] = {
+            tvec4<T>(m[0].x, m[1].x, m[2].x, m[3].x),
+            tvec4<T>(m[0].y, m[1].y, m[2].y, m[3].y),
+            tvec4<T>(m[0].z, m[1].z, m[2].z, m[3].z),
+            tvec4<T>(m[0].w, m[1].w, m[2].w, m[3].w) };
+        for (int i = 0; i < 3; ++i)
+        {
+            planes[2 * i] = row[3] + row[i];
+            planes[2 * i + 1] = row[3] - row[i];
+        }
+        for (tvec4<T>& p : planes)
+            p /= length(tvec3<T>(p));
+    }
+};
+
+template <typename T>
+bool isVisible(const tfrustum<T>& f, const tvec3<T>& center, T radius)
+{
+    for (const tvec4<T>& p : f.planes)
+        if (dot(tvec3<T>(p), center) + p.w < -radius)
+            return false;
+    return true;
+}
+
+template <typename T>
+bool isVisible(const tfrustum<T>& f, const taabb<T>& box)
+{
+    for (const tvec4<T>& p : f.planes)
+    {
+        // corner farthest along the plane normal
+        const tvec3<T> c(
+            (p.x > 0) ? box.max.x : box.min.x,
+            (p.y > 0) ? box.max.y : box.min.y,
+            (p.z > 0) ? box.max.z : box.min.z);
+        if (dot(tvec3<T>(p), c) + p.w < 0)
+            return false;
+    }
+    return true;
+}
+
+using aabb = taabb<double>;
+using aabbf = taabb<float>;
+using frustum = tfrustum<double>;
+using frustumf = tfrustum<float>;
+
+// Batch versions testing 8 volumes at a time: write the indices of the
+// visible ones to visible (room for count entries), in increasing order,
+// and return how many there are. Spheres are (center.xyz, radius).
+size_t cullSpheres(const frustumf& f, const vec4f* spheres, size_t count, uint32_t* visible);
+size_t cullBoxes(const frustumf& f, const aabbf* boxes, size_t count, uint32_t* visible);
+
+} // namespace glsl_math
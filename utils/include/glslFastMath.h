@@ -0,0 +1,243 @@
+// GLSL-like math library - fast transcendental functions
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <glslMathPacket.h>
+
+#include <limits>
+
+// Polynomial approximations of sin, cos, acos, exp, log, pow and 1/sqrt that
+// work on float, floatx4 and floatx8 alike (branch-free, so every lane
+// costs the same). The precision tier is the first template argument:
+//
+//   floatx8 s, c;
+//   fast::sincos<fast::Low>(angle, s, c);
+//   vec3x8 n = fast::normalize(cross(a, b));   // Medium
+//
+// Maximum errors against double precision libm, as printed by the
+// fastMathReport app (relative, or absolute where the result is below 1):
+//
+//              Low      Medium   High
+//   sin, cos   4e-4     1.4e-6   9e-8     |x| <= 1e4
+//   acos       4e-5     8e-7     2e-7     |x| <= 1 (clamped)
+//   exp        1e-4     3e-6     1e-7     x in [-87.3, 88.3]
+//   log        1e-5     1.3e-7   9e-8     normal x > 0
+//   rsqrt      3e-4     2.5e-7   1e-7     (2e-3 and 5e-6 without SSE)
+//   pow        1.4e-4   4.6e-6   1.9e-6   |y*log(x)| <= 18
+//
+// pow(x, y) is exp(y*log(x)) for x >= 0, so its error grows with |y*log(x)|.
+// Out of range arguments: exp saturates at 2^127.5 and returns 0 below
+// -87.3, log returns -inf for 0, NaN for negative x and passes +inf through.
+// Denormals are not supported.
+//
+// The speedup comes from the packets (5-25x over libm per element); the float
+// versions give the same results for loop tails and are about as fast as libm.
+
+namespace glsl_math
+{
+namespace fast
+{
+
+enum Precision { Low, Medium, High };
+
+// Minimax polynomials of sin(r)/r - 1, cos(r) - 1 on |r| <= pi/4,
+// exp(r) - 1 on |r| <= ln(2)/2, atanh(s)/s - 1 on |s| <= 3 - 2*sqrt(2)
+// and acos(x)/sqrt(1 - x) on [0, 1].
+
+template <Precision Q, typename P>
+inline P sinPoly(const P& r, const P& r2)
+{
+    P p;
+    if (Q == Low)
+        p = P(-1.6242792e-1f);
+    else if (Q == Medium)
+        p = madd(r2, P(8.1632819e-3f), P(-1.6663390e-1f));
+    else
+        p = madd(r2, madd(r2, P(-1.9515283e-4f), P(8.3321608e-3f)), P(-1.6666655e-1f));
+    return madd(r * r2, p, r);
+}
+
+template <Precision Q, typename P>
+inline P cosPoly(const P& r2)
+{
+    P p;
+    if (Q == Low)
+        p = madd(r2, P(4.0458452e-2f), P(-4.9976056e-1f));
+    else if (Q == Medium)
+        p = madd(r2, madd(r2, P(-1.3591854e-3f), P(4.1655777e-2f)), P(-4.9999885e-1f));
+    else
+        p = madd(r2, madd(r2, madd(r2, P(2.4383567e-5f), P(-1.3886682e-3f)), P(4.1666620e-2f)), P(-5.0000000e-1f));
+    return madd(r2, p, P(1.0f));
+}
+
+template <Precision Q, typename P>
+inline P expPoly(const P& r)
+{
+    P p;
+    if (Q == Low)
+        p = madd(r, madd(r, P(1.6517976e-1f), P(5.0413038e-1f)), P(1.0001958f));
+    else if (Q == Medium)
+        p = madd(r, madd(r, madd(r, P(4.1513847e-2f), P(1.6787473e-1f)), P(5.0003014e-1f)), P(9.9996684e-1f));
+    else
+        p = madd(r, madd(r, madd(r, madd(r, madd(r, P(1.3843654e-3f), P(8.3741553e-3f)),
+            P(4.1668002e-2f)), P(1.6666431e-1f)), P(4.9999994e-1f)), P(1.0000000f));
+    return madd(r, p, P(1.0f));
+}
+
+template <Precision Q, typename P>
+inline P atanhPoly(const P& s)
+{
+    const P z = s * s;
+    P p;
+    if (Q == Low)
+        p = P(3.3830220e-1f);
+    else if (Q == Medium)
+        p = madd(z, P(2.0600997e-1f), P(3.3327811e-1f));
+    else
+        p = madd(z, madd(z, P(1.4935469e-1f), P(1.9988787e-1f)), P(3.3333388e-1f));
+    return madd(s * z, p, s);
+}
+
+template <Precision Q, typename P>
+inline P acosPoly(const P& x)
+{
+    if (Q == Low)
+        return madd(x, madd(x, madd(x, P(-2.0892033e-2f), P(7.6897383e-2f)), P(-2.1287518e-1f)), P(1.5707583f));
+    if (Q == Medium)
+        return madd(x, madd(x, madd(x, madd(x, madd(x, P(-4.9111733e-3f), P(2.0620059e-2f)),
+            P(-4.5927227e-2f)), P(8.8171053e-2f)), P(-2.1454282e-1f)), P(1.5707957f));
+    return madd(x, madd(x, madd(x, madd(x, madd(x, madd(x, madd(x, P(-1.4414803e-3f), P(7.2454492e-3f)),
+        P(-1.7808986e-2f)), P(3.1335471e-2f)), P(-5.0312785e-2f)), P(8.8999265e-2f)), P(-2.1459989e-1f)), P(1.5707963f));
+}
+
+// r = x - j*pi/2 in [-pi/4, pi/4] (Cody-Waite), q = j mod 4.
+template <typename P>
+inline P reduceHalfPi(const P& x, P& q)
+{
+    const P j = floor(madd(x, P(6.3661977e-1f), P(0.5f)));
+    q = j - floor(j * P(0.25f)) * P(4.0f);
+    P r = madd(j, P(-1.5703125f), x);
+    r = madd(j, P(-4.8375129699707031e-4f), r);
+    return madd(j, P(-7.5497899548918822e-8f), r);
+}
+
+template <Precision Q = Medium, typename P>
+inline void sincos(const P& x, P& s, P& c)
+{
+    P q;
+    const P r = reduceHalfPi(x, q);
+    const P r2 = r * r;
+    const P ps = sinPoly<Q>(r, r2);
+    const P pc = cosPoly<Q>(r2);
+    const auto odd = (q == P(1.0f)) | (q == P(3.0f));
+    s = select(odd, pc, ps);
+    c = select(odd, ps, pc);
+    s = select(q >= P(2.0f), -s, s);
+    c = select((q == P(1.0f)) | (q == P(2.0f)), -c, c);
+}
+
+template <Precision Q = Medium, typename P>
+inline P sin(const P& x)
+{
+    P q;
+    const P r = reduceHalfPi(x, q);
+    const P r2 = r * r;
+    const P s = select((q == P(1.0f)) | (q == P(3.0f)), cosPoly<Q>(r2), sinPoly<Q>(r, r2));
+    return select(q >= P(2.0f), -s, s);
+}
+
+template <Precision Q = Medium, typename P>
+inline P cos(const P& x)
+{
+    P q;
+    const P r = reduceHalfPi(x, q);
+    const P r2 = r * r;
+    const P c = select((q == P(1.0f)) | (q == P(3.0f)), sinPoly<Q>(r, r2), cosPoly<Q>(r2));
+    return select((q == P(1.0f)) | (q == P(2.0f)), -c, c);
+}
+
+template <Precision Q = Medium, typename P>
+inline P acos(const P& x)
+{
+    const P a = min(fabs(x), P(1.0f));
+    const P r = sqrt(P(1.0f) - a) * acosPoly<Q>(a);
+    return select(x < P(0.0f), P(3.14159265f) - r, r);
+}
+
+template <Precision Q = Medium, typename P>
+inline P exp(const P& x)
+{
+    // exp(x) = 2^n * exp(r), r = x - n*ln(2)
+    const P t = min(max(x, P(-87.336544f)), P(88.37f));
+    const P n = floor(madd(t, P(1.4426950f), P(0.5f)));
+    P r = madd(n, P(-0.693359375f), t);
+    r = madd(n, P(2.1219444e-4f), r);
+    return select(x < P(-87.336544f), P(0.0f), expPoly<Q>(r) * exp2i(n));
+}
+
+template <Precision Q = Medium, typename P>
+inline P log(const P& x)
+{
+    // log(x) = e*ln(2) + 2*atanh(f/(2 + f)), x = (1 + f) * 2^e
+    P e;
+    P m = frexp(x, e);
+    const auto small = m < P(7.0710678e-1f);
+    m = select(small, m + m, m);
+    e = select(small, e - P(1.0f), e);
+    const P f = m - P(1.0f);
+    const P s = f / (f + P(2.0f));
+    P r = madd(e, P(-2.1219444e-4f), atanhPoly<Q>(s) * P(2.0f));
+    r = madd(e, P(0.693359375f), r);
+    r = select(x < P(std::numeric_limits<float>::infinity()), r, x);
+    return select(x > P(0.0f), r, select(x == P(0.0f),
+        P(-std::numeric_limits<float>::infinity()), P(std::numeric_limits<float>::quiet_NaN())));
+}
+
+template <Precision Q = Medium, typename P>
+inline P pow(const P& x, const P& y)
+{
+    return exp<Q>(y * log<Q>(x));
+}
+
+template <Precision Q = Medium, typename P>
+inline P rsqrt(const P& x)
+{
+    if (Q == High)
+        return P(1.0f) / sqrt(x);
+    const P r = rsqrtEstimate(x);
+    if (Q == Low)
+        return r;
+    // one Newton-Raphson step
+    return r * madd(P(-0.5f) * x * r, r, P(1.5f));
+}
+
+// 1/sqrt(d) of squared length d, with zero mapped to 0 like glsl_math::normalize.
+template <Precision Q, typename P>
+inline P inverseLength(const P& d)
+{
+    return select(d > P(0.0f), rsqrt<Q>(d), P(0.0f));
+}
+
+template <Precision Q = Medium, typename P>
+inline tvec2<P> normalize(const tvec2<P>& v) { return v * inverseLength<Q>(dot(v, v)); }
+template <Precision Q = Medium, typename P>
+inline tvec3<P> normalize(const tvec3<P>& v) { return v * inverseLength<Q>(dot(v, v)); }
+template <Precision Q = Medium, typename P>
+inline tvec4<P> normalize(const tvec4<P>& v) { return v * inverseLength<Q>(dot(v, v)); }
+
+} // namespace fast
+} // namespace glsl_math
@@ -32,13 +32,35 @@
 #define GlslMathUnitTests 1
 #endif
 
+// SIMD specializations of tmat4<float>/tvec4<float> operations.
+// Define GlslMathSimd to 0 to force the generic scalar templates.
+#ifndef GlslMathSimd
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GlslMathSimd 1
+#else
+#define GlslMathSimd 0
+#endif
+#endif
+
+#if GlslMathSimd
+#if defined(__AVX__)
+#define GlslMathAvx 1
+#include <immintrin.h>
+#else
+#define GlslMathAvx 0
+#include <emmintrin.h>
+#endif
+#else
+#define GlslMathAvx 0
+#endif
+
 namespace glsl_math
 {
 
 template <typename T>
-T min( T x, T y ) { return (x<y)?x:y; }
+constexpr T min( T x, T y ) { return (x<y)?x:y; }
 template <typename T>
-T max( T x, T y ) { return (x>y)?x:y; }
+constexpr T max( T x, T y ) { return (x>y)?x:y; }
 
 #ifndef WIN32
 inline float abs(float x) { return std::abs(x); }
@@ -48,14 +70,14 @@ inline double abs(double x) { return std::abs(x); }
 template <typename T>
 inline T ufmod(T x, T y) { return x - floor(x / y) * y; }
 
-inline int uimod(int x, int y) { return (x<0) ? y-1 - (-x-1)%y : x%y; }
+constexpr int uimod(int x, int y) { return (x<0) ? y-1 - (-x-1)%y : x%y; }
 
 template <typename T>
-T pow2(T x) { return x*x; }
+constexpr T pow2(T x) { return x*x; }
 template <typename T>
-T pow3(T x) { return x*x*x; }
+constexpr T pow3(T x) { return x*x*x; }
 template <typename T>
-T sign(T x)
+constexpr T sign(T x)
 {
     return (x == 0)
         ? static_cast<T>(0)
@@ -63,7 +85,7 @@ T sign(T x)
 }
 
 template <typename T, typename TT>
-T mix(T x, T y, TT t) { return x + (y - x)*t; }
+constexpr T mix(T x, T y, TT t) { return x + (y - x)*t; }
 
 template <typename T>
 T smoothmin(T a, T b, T r)
@@ -87,7 +109,7 @@ template <typename T> class tmat3;
 template <typename T> class tmat4;
 
 #define VEC2_GET(A, B) \
-    tvec2<T> A ## B() const { return tvec2<T>(A, B); }
+    constexpr tvec2<T> A ## B() const { return tvec2<T>(A, B); }
 #define VEC2_GET2(A, B) \
     VEC2_GET(A, B) \
     VEC2_GET(B, A)
@@ -108,7 +130,7 @@ template <typename T> class tmat4;
     VEC2_GET(D, D)
 
 #define VEC3_GET(A, B, C) \
-    tvec3<T> A ## B ## C() const { return tvec3<T>(A, B, C); }
+    constexpr tvec3<T> A ## B ## C() const { return tvec3<T>(A, B, C); }
 #define VEC3_GET2(A, B, C) \
     VEC3_GET(A, B, C) \
     VEC3_GET(A, C, B)
@@ -142,7 +164,7 @@ template <typename T> class tmat4;
     VEC3_GET(D, D, D)
 
 #define VEC4_GET(A, B, C, D) \
-    tvec4<T> A ## B ## C ## D() const { return tvec4<T>(A, B, C, D); }
+    constexpr tvec4<T> A ## B ## C ## D() const { return tvec4<T>(A, B, C, D); }
 #define VEC4_GET2(A, B, C, D) \
     VEC4_GET(A, B, C, D) \
     VEC4_GET(A, B, D, C)
@@ -196,7 +218,7 @@ template <typename T> class tmat4;
     VEC4_GET(D, D, D, D)
 
 #define VEC2_SET(A, B) \
-    void set_ ## A ## B(const tvec2<T>& a) { A = a.x; B = a.y; }
+    constexpr void set_ ## A ## B(const tvec2<T>& a) { A = a.x; B = a.y; }
 #define VEC2_SET2(A, B) \
     VEC2_SET(A, B) \
     VEC2_SET(B, A)
@@ -211,7 +233,7 @@ template <typename T> class tmat4;
     VEC2_SET2(C, D)
 
 #define VEC3_SET(A, B, C) \
-    void set_ ## A ## B ## C(const tvec3<T>& a) { A = a.x; B = a.y; C = a.z; }
+    constexpr void set_ ## A ## B ## C(const tvec3<T>& a) { A = a.x; B = a.y; C = a.z; }
 #define VEC3_SET2(A, B, C) \
     VEC3_SET(A, B, C) \
     VEC3_SET(A, C, B)
@@ -226,7 +248,7 @@ template <typename T> class tmat4;
     VEC3_SET3(B, C, D)
 
 #define VEC4_SET(A, B, C, D) \
-    void set_ ## A ## B ## C ## D(const tvec4<T>& a) { A = a.x; B = a.y; C = a.z; D = a.w; }
+    constexpr void set_ ## A ## B ## C ## D(const tvec4<T>& a) { A = a.x; B = a.y; C = a.z; D = a.w; }
 #define VEC4_SET2(A, B, C, D) \
     VEC4_SET(A, B, C, D) \
     VEC4_SET(A, B, D, C)
@@ -247,49 +269,49 @@ public:
     T x, y;
     tvec2() = default;
     tvec2(const tvec2& v) = default;
-    tvec2(T x, T y) : x(x), y(y) { }
-    tvec2(T v) : x(v), y(v) { }
-    tvec2(const tvec3<T>& v);
-    tvec2(const tvec4<T>& v);
-    tvec2& operator+=(const tvec2& a) { x += a.x; y += a.y; return *this; }
-    tvec2& operator-=(const tvec2& a) { x -= a.x; y -= a.y; return *this; }
-    tvec2& operator*=(const tvec2& a) { x *= a.x; y *= a.y; return *this; }
-    tvec2& operator/=(const tvec2& a) { x /= a.x; y /= a.y; return *this; }
-    tvec2& operator+=(T a) { x += a; y += a; return *this; }
-    tvec2& operator-=(T a) { x -= a; y -= a; return *this; }
-    tvec2& operator*=(T a) { x *= a; y *= a; return *this; }
-    tvec2& operator/=(T a) { x /= a; y /= a; return *this; }
+    constexpr tvec2(T x, T y) : x(x), y(y) { }
+    constexpr tvec2(T v) : x(v), y(v) { }
+    constexpr tvec2(const tvec3<T>& v);
+    constexpr tvec2(const tvec4<T>& v);
+    constexpr tvec2& operator+=(const tvec2& a) { x += a.x; y += a.y; return *this; }
+    constexpr tvec2& operator-=(const tvec2& a) { x -= a.x; y -= a.y; return *this; }
+    constexpr tvec2& operator*=(const tvec2& a) { x *= a.x; y *= a.y; return *this; }
+    constexpr tvec2& operator/=(const tvec2& a) { x /= a.x; y /= a.y; return *this; }
+    constexpr tvec2& operator+=(T a) { x += a; y += a; return *this; }
+    constexpr tvec2& operator-=(T a) { x -= a; y -= a; return *this; }
+    constexpr tvec2& operator*=(T a) { x *= a; y *= a; return *this; }
+    constexpr tvec2& operator/=(T a) { x /= a; y /= a; return *this; }
 
     VEC2_GET22(x, y)
     VEC2_SET2(x, y)
 
     template <typename TT>
-    tvec2(const tvec2<TT>& v) : x(static_cast<T>(v.x)), y(static_cast<T>(v.y)) { }
+    constexpr tvec2(const tvec2<TT>& v) : x(static_cast<T>(v.x)), y(static_cast<T>(v.y)) { }
 };
 template <typename T>
-tvec2<T> operator-(const tvec2<T>& a) { return tvec2<T>(-a.x, -a.y); }
+constexpr tvec2<T> operator-(const tvec2<T>& a) { return tvec2<T>(-a.x, -a.y); }
 template <typename T>
-tvec2<T> operator+(const tvec2<T>& a, const tvec2<T>& b) { return tvec2<T>(a.x + b.x, a.y + b.y); }
+constexpr tvec2<T> operator+(const tvec2<T>& a, const tvec2<T>& b) { return tvec2<T>(a.x + b.x, a.y + b.y); }
 template <typename T>
-tvec2<T> operator-(const tvec2<T>& a, const tvec2<T>& b) { return tvec2<T>(a.x - b.x, a.y - b.y); }
+constexpr tvec2<T> operator-(const tvec2<T>& a, const tvec2<T>& b) { return tvec2<T>(a.x - b.x, a.y - b.y); }
 template <typename T>
-tvec2<T> operator*(const tvec2<T>& a, const tvec2<T>& b) { return tvec2<T>(a.x * b.x, a.y * b.y); }
+constexpr tvec2<T> operator*(const tvec2<T>& a, const tvec2<T>& b) { return tvec2<T>(a.x * b.x, a.y * b.y); }
 template <typename T>
-tvec2<T> operator/(const tvec2<T>& a, const tvec2<T>& b) { return tvec2<T>(a.x / b.x, a.y / b.y); }
+constexpr tvec2<T> operator/(const tvec2<T>& a, const tvec2<T>& b) { return tvec2<T>(a.x / b.x, a.y / b.y); }
 template <typename T>
-tvec2<T> operator+(const tvec2<T>& a, T b) { return tvec2<T>(a.x + b, a.y + b); }
+constexpr tvec2<T> operator+(const tvec2<T>& a, T b) { return tvec2<T>(a.x + b, a.y + b); }
 template <typename T>
-tvec2<T> operator-(const tvec2<T>& a, T b) { return tvec2<T>(a.x - b, a.y - b); }
+constexpr tvec2<T> operator-(const tvec2<T>& a, T b) { return tvec2<T>(a.x - b, a.y - b); }
 template <typename T>
-tvec2<T> operator*(const tvec2<T>& a, T b) { return tvec2<T>(a.x * b, a.y * b); }
+constexpr tvec2<T> operator*(const tvec2<T>& a, T b) { return tvec2<T>(a.x * b, a.y * b); }
 template <typename T>
-tvec2<T> operator*(T b, const tvec2<T>& a) { return tvec2<T>(a.x * b, a.y * b); }
+constexpr tvec2<T> operator*(T b, const tvec2<T>& a) { return tvec2<T>(a.x * b, a.y * b); }
 template <typename T>
-tvec2<T> operator/(const tvec2<T>& a, T b) { return tvec2<T>(a.x / b, a.y / b); }
+constexpr tvec2<T> operator/(const tvec2<T>& a, T b) { return tvec2<T>(a.x / b, a.y / b); }
 template <typename T>
-bool operator==(const tvec2<T>& a, const tvec2<T>& b) { return a.x == b.x && a.y == b.y; }
+constexpr bool operator==(const tvec2<T>& a, const tvec2<T>& b) { return a.x == b.x && a.y == b.y; }
 template <typename T>
-bool operator!=(const tvec2<T>& a, const tvec2<T>& b) { return a.x != b.x || a.y != b.y; }
+constexpr bool operator!=(const tvec2<T>& a, const tvec2<T>& b) { return a.x != b.x || a.y != b.y; }
 
 template <typename T>
 class tvec3 {
@@ -298,20 +320,20 @@ public:
     T x, y, z;
     tvec3<T>() = default;
     tvec3<T>(const tvec3<T>& v) = default;
-    tvec3<T>(const tvec2<T>& v) : x(v.x), y(v.y), z(0) { }
-    tvec3<T>(const tvec2<T>& v, T z) : x(v.x), y(v.y), z(z) { }
-    tvec3<T>(T x, const tvec2<T>& v) : x(x), y(v.x), z(v.y) { }
-    tvec3<T>(T x, T y, T z) : x(x), y(y), z(z) { }
-    tvec3<T>(T v) : x(v), y(v), z(v) { }
-    tvec3<T>(const tvec4<T>& v);
-    tvec3<T>& operator+=(const tvec3<T>& a) { x += a.x; y += a.y; z += a.z; return *this; }
-    tvec3<T>& operator-=(const tvec3<T>& a) { x -= a.x; y -= a.y; z -= a.z; return *this; }
-    tvec3<T>& operator*=(const tvec3<T>& a) { x *= a.x; y *= a.y; z *= a.z; return *this; }
-    tvec3<T>& operator/=(const tvec3<T>& a) { x /= a.x; y /= a.y; z /= a.z; return *this; }
-    tvec3<T>& operator+=(T a) { x += a; y += a; z += a; return *this; }
-    tvec3<T>& operator-=(T a) { x -= a; y -= a; z -= a; return *this; }
-    tvec3<T>& operator*=(T a) { x *= a; y *= a; z *= a; return *this; }
-    tvec3<T>& operator/=(T a) { x /= a; y /= a; z /= a; return *this; }
+    constexpr tvec3<T>(const tvec2<T>& v) : x(v.x), y(v.y), z(0) { }
+    constexpr tvec3<T>(const tvec2<T>& v, T z) : x(v.x), y(v.y), z(z) { }
+    constexpr tvec3<T>(T x, const tvec2<T>& v) : x(x), y(v.x), z(v.y) { }
+    constexpr tvec3<T>(T x, T y, T z) : x(x), y(y), z(z) { }
+    constexpr tvec3<T>(T v) : x(v), y(v), z(v) { }
+    constexpr tvec3<T>(const tvec4<T>& v);
+    constexpr tvec3<T>& operator+=(const tvec3<T>& a) { x += a.x; y += a.y; z += a.z; return *this; }
+    constexpr tvec3<T>& operator-=(const tvec3<T>& a) { x -= a.x; y -= a.y; z -= a.z; return *this; }
+    constexpr tvec3<T>& operator*=(const tvec3<T>& a) { x *= a.x; y *= a.y; z *= a.z; return *this; }
+    constexpr tvec3<T>& operator/=(const tvec3<T>& a) { x /= a.x; y /= a.y; z /= a.z; return *this; }
+    constexpr tvec3<T>& operator+=(T a) { x += a; y += a; z += a; return *this; }
+    constexpr tvec3<T>& operator-=(T a) { x -= a; y -= a; z -= a; return *this; }
+    constexpr tvec3<T>& operator*=(T a) { x *= a; y *= a; z *= a; return *this; }
+    constexpr tvec3<T>& operator/=(T a) { x /= a; y /= a; z /= a; return *this; }
 
     VEC2_GET3(x, y, z)
     VEC2_SET3(x, y, z)
@@ -320,32 +342,32 @@ public:
     VEC3_SET3(x, y, z)
 
     template <typename TT>
-    tvec3(const tvec3<TT>& v) : x(static_cast<T>(v.x)), y(static_cast<T>(v.y)), z(static_cast<T>(v.z)) { }
+    constexpr tvec3(const tvec3<TT>& v) : x(static_cast<T>(v.x)), y(static_cast<T>(v.y)), z(static_cast<T>(v.z)) { }
 };
 template <typename T>
-tvec3<T> operator-(const tvec3<T>& a) { return tvec3<T>(-a.x, -a.y, -a.z); }
+constexpr tvec3<T> operator-(const tvec3<T>& a) { return tvec3<T>(-a.x, -a.y, -a.z); }
 template <typename T>
-tvec3<T> operator+(const tvec3<T>& a, const tvec3<T>& b) { return tvec3<T>(a.x + b.x, a.y + b.y, a.z + b.z); }
+constexpr tvec3<T> operator+(const tvec3<T>& a, const tvec3<T>& b) { return tvec3<T>(a.x + b.x, a.y + b.y, a.z + b.z); }
 template <typename T>
-tvec3<T> operator-(const tvec3<T>& a, const tvec3<T>& b) { return tvec3<T>(a.x - b.x, a.y - b.y, a.z - b.z); }
+constexpr tvec3<T> operator-(const tvec3<T>& a, const tvec3<T>& b) { return tvec3<T>(a.x - b.x, a.y - b.y, a.z - b.z); }
 template <typename T>
-tvec3<T> operator*(const tvec3<T>& a, const tvec3<T>& b) { return tvec3<T>(a.x * b.x, a.y * b.y, a.z * b.z); }
+constexpr tvec3<T> operator*(const tvec3<T>& a, const tvec3<T>& b) { return tvec3<T>(a.x * b.x, a.y * b.y, a.z * b.z); }
 template <typename T>
-tvec3<T> operator/(const tvec3<T>& a, const tvec3<T>& b) { return tvec3<T>(a.x / b.x, a.y / b.y, a.z / b.z); }
+constexpr tvec3<T> operator/(const tvec3<T>& a, const tvec3<T>& b) { return tvec3<T>(a.x / b.x, a.y / b.y, a.z / b.z); }
 template <typename T>
-tvec3<T> operator+(const tvec3<T>& a, T b) { return tvec3<T>(a.x + b, a.y + b, a.z + b); }
+constexpr tvec3<T> operator+(const tvec3<T>& a, T b) { return tvec3<T>(a.x + b, a.y + b, a.z + b); }
 template <typename T>
-tvec3<T> operator-(const tvec3<T>& a, T b) { return tvec3<T>(a.x - b, a.y - b, a.z - b); }
+constexpr tvec3<T> operator-(const tvec3<T>& a, T b) { return tvec3<T>(a.x - b, a.y - b, a.z - b); }
 template <typename T>
-tvec3<T> operator*(const tvec3<T>& a, T b) { return tvec3<T>(a.x * b, a.y * b, a.z * b); }
+constexpr tvec3<T> operator*(const tvec3<T>& a, T b) { return tvec3<T>(a.x * b, a.y * b, a.z * b); }
 template <typename T>
-tvec3<T> operator*(T b, const tvec3<T>& a) { return tvec3<T>(a.x * b, a.y * b, a.z * b); }
+constexpr tvec3<T> operator*(T b, const tvec3<T>& a) { return tvec3<T>(a.x * b, a.y * b, a.z * b); }
 template <typename T>
-tvec3<T> operator/(const tvec3<T>& a, T b) { return tvec3<T>(a.x / b, a.y / b, a.z / b); }
+constexpr tvec3<T> operator/(const tvec3<T>& a, T b) { return tvec3<T>(a.x / b, a.y / b, a.z / b); }
 template <typename T>
-bool operator==(const tvec3<T>& a, const tvec3<T>& b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+constexpr bool operator==(const tvec3<T>& a, const tvec3<T>& b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
 template <typename T>
-bool operator!=(const tvec3<T>& a, const tvec3<T>& b) { return a.x != b.x || a.y != b.y || a.z != b.z; }
+constexpr bool operator!=(const tvec3<T>& a, const tvec3<T>& b) { return a.x != b.x || a.y != b.y || a.z != b.z; }
 
 template <typename T>
 class tvec4 {
@@ -354,24 +376,24 @@ public:
     T x, y, z, w;
     tvec4<T>() = default;
     tvec4<T>(const tvec4<T>& v) = default;
-    tvec4<T>(const tvec3<T>& v) : x(v.x), y(v.y), z(v.z), w(1) { }
-    tvec4<T>(const tvec2<T>& v) : x(v.x), y(v.y), z(0), w(1) { }
-    tvec4<T>(const tvec2<T>& v, const tvec2<T>& u) : x(v.x), y(v.y), z(u.x), w(u.y) { }
-    tvec4<T>(const tvec2<T>& v, T z, T w) : x(v.x), y(v.y), z(z), w(w) { }
-    tvec4<T>(T x, const tvec2<T>& v, T w) : x(x), y(v.x), z(v.y), w(w) { }
-    tvec4<T>(T x, T y, const tvec2<T>& v) : x(x), y(y), z(v.x), w(v.y) { }
-    tvec4<T>(const tvec3<T>& v, T w) : x(v.x), y(v.y), z(v.z), w(w) { }
-    tvec4<T>(T x, const tvec3<T>& v) : x(x), y(v.x), z(v.y), w(v.z) { }
-    tvec4<T>(T x, T y, T z, T w) : x(x), y(y), z(z), w(w) { }
-    tvec4<T>(T v) : x(v), y(v), z(v), w(v) { }
-    tvec4<T>& operator+=(const tvec4<T>& a) { x += a.x; y += a.y; z += a.z; w += a.w; return *this; }
-    tvec4<T>& operator-=(const tvec4<T>& a) { x -= a.x; y -= a.y; z -= a.z; w -= a.w; return *this; }
-    tvec4<T>& operator*=(const tvec4<T>& a) { x *= a.x; y *= a.y; z *= a.z; w *= a.w; return *this; }
-    tvec4<T>& operator/=(const tvec4<T>& a) { x /= a.x; y /= a.y; z /= a.z; w /= a.w; return *this; }
-    tvec4<T>& operator+=(T a) { x += a; y += a; z += a; w += a; return *this; }
-    tvec4<T>& operator-=(T a) { x -= a; y -= a; z -= a; w -= a; return *this; }
-    tvec4<T>& operator*=(T a) { x *= a; y *= a; z *= a; w *= a; return *this; }
-    tvec4<T>& operator/=(T a) { x /= a; y /= a; z /= a; w /= a; return *this; }
+    constexpr tvec4<T>(const tvec3<T>& v) : x(v.x), y(v.y), z(v.z), w(1) { }
+    constexpr tvec4<T>(const tvec2<T>& v) : x(v.x), y(v.y), z(0), w(1) { }
+    constexpr tvec4<T>(const tvec2<T>& v, const tvec2<T>& u) : x(v.x), y(v.y), z(u.x), w(u.y) { }
+    constexpr tvec4<T>(const tvec2<T>& v, T z, T w) : x(v.x), y(v.y), z(z), w(w) { }
+    constexpr tvec4<T>(T x, const tvec2<T>& v, T w) : x(x), y(v.x), z(v.y), w(w) { }
+    constexpr tvec4<T>(T x, T y, const tvec2<T>& v) : x(x), y(y), z(v.x), w(v.y) { }
+    constexpr tvec4<T>(const tvec3<T>& v, T w) : x(v.x), y(v.y), z(v.z), w(w) { }
+    constexpr tvec4<T>(T x, const tvec3<T>& v) : x(x), y(v.x), z(v.y), w(v.z) { }
+    constexpr tvec4<T>(T x, T y, T z, T w) : x(x), y(y), z(z), w(w) { }
+    constexpr tvec4<T>(T v) : x(v), y(v), z(v), w(v) { }
+    constexpr tvec4<T>& operator+=(const tvec4<T>& a) { x += a.x; y += a.y; z += a.z; w += a.w; return *this; }
+    constexpr tvec4<T>& operator-=(const tvec4<T>& a) { x -= a.x; y -= a.y; z -= a.z; w -= a.w; return *this; }
+    constexpr tvec4<T>& operator*=(const tvec4<T>& a) { x *= a.x; y *= a.y; z *= a.z; w *= a.w; return *this; }
+    constexpr tvec4<T>& operator/=(const tvec4<T>& a) { x /= a.x; y /= a.y; z /= a.z; w /= a.w; return *this; }
+    constexpr tvec4<T>& operator+=(T a) { x += a; y += a; z += a; w += a; return *this; }
+    constexpr tvec4<T>& operator-=(T a) { x -= a; y -= a; z -= a; w -= a; return *this; }
+    constexpr tvec4<T>& operator*=(T a) { x *= a; y *= a; z *= a; w *= a; return *this; }
+    constexpr tvec4<T>& operator/=(T a) { x /= a; y /= a; z /= a; w /= a; return *this; }
 
     VEC2_GET4(x, y, z, w)
     VEC2_SET4(x, y, z, w)
@@ -383,32 +405,32 @@ public:
     VEC4_SET4(x, y, z, w)
 
     template <typename TT>
-    tvec4(const tvec4<TT>& v) : x(static_cast<T>(v.x)), y(static_cast<T>(v.y)), z(static_cast<T>(v.z)), w(static_cast<T>(v.w)) { }
+    constexpr tvec4(const tvec4<TT>& v) : x(static_cast<T>(v.x)), y(static_cast<T>(v.y)), z(static_cast<T>(v.z)), w(static_cast<T>(v.w)) { }
 };
 template <typename T>
-tvec4<T> operator-(const tvec4<T>& a) { return tvec4<T>(-a.x, -a.y, -a.z, -a.w); }
+constexpr tvec4<T> operator-(const tvec4<T>& a) { return tvec4<T>(-a.x, -a.y, -a.z, -a.w); }
 template <typename T>
-tvec4<T> operator+(const tvec4<T>& a, const tvec4<T>& b) { return tvec4<T>(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+constexpr tvec4<T> operator+(const tvec4<T>& a, const tvec4<T>& b) { return tvec4<T>(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
 template <typename T>
-tvec4<T> operator-(const tvec4<T>& a, const tvec4<T>& b) { return tvec4<T>(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); }
+constexpr tvec4<T> operator-(const tvec4<T>& a, const tvec4<T>& b) { return tvec4<T>(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); }
 template <typename T>
-tvec4<T> operator*(const tvec4<T>& a, const tvec4<T>& b) { return tvec4<T>(a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w); }
+constexpr tvec4<T> operator*(const tvec4<T>& a, const tvec4<T>& b) { return tvec4<T>(a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w); }
 template <typename T>
-tvec4<T> operator/(const tvec4<T>& a, const tvec4<T>& b) { return tvec4<T>(a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w); }
+constexpr tvec4<T> operator/(const tvec4<T>& a, const tvec4<T>& b) { return tvec4<T>(a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w); }
 template <typename T>
-tvec4<T> operator+(const tvec4<T>& a, T b) { return tvec4<T>(a.x + b, a.y + b, a.z + b, a.w + b); }
+constexpr tvec4<T> operator+(const tvec4<T>& a, T b) { return tvec4<T>(a.x + b, a.y + b, a.z + b, a.w + b); }
 template <typename T>
-tvec4<T> operator-(const tvec4<T>& a, T b) { return tvec4<T>(a.x - b, a.y - b, a.z - b, a.w - b); }
+constexpr tvec4<T> operator-(const tvec4<T>& a, T b) { return tvec4<T>(a.x - b, a.y - b, a.z - b, a.w - b); }
 template <typename T>
-tvec4<T> operator*(const tvec4<T>& a, T b) { return tvec4<T>(a.x * b, a.y * b, a.z * b, a.w * b); }
+constexpr tvec4<T> operator*(const tvec4<T>& a, T b) { return tvec4<T>(a.x * b, a.y * b, a.z * b, a.w * b); }
 template <typename T>
-tvec4<T> operator*(T b, const tvec4<T>& a) { return tvec4<T>(a.x * b, a.y * b, a.z * b, a.w * b); }
+constexpr tvec4<T> operator*(T b, const tvec4<T>& a) { return tvec4<T>(a.x * b, a.y * b, a.z * b, a.w * b); }
 template <typename T>
-tvec4<T> operator/(const tvec4<T>& a, T b) { return tvec4<T>(a.x / b, a.y / b, a.z / b, a.w / b); }
+constexpr tvec4<T> operator/(const tvec4<T>& a, T b) { return tvec4<T>(a.x / b, a.y / b, a.z / b, a.w / b); }
 template <typename T>
-bool operator==(const tvec4<T>& a, const tvec4<T>& b) { return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w; }
+constexpr bool operator==(const tvec4<T>& a, const tvec4<T>& b) { return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w; }
 template <typename T>
-bool operator!=(const tvec4<T>& a, const tvec4<T>& b) { return a.x != b.x || a.y != b.y || a.z != b.z || a.w != b.w; }
+constexpr bool operator!=(const tvec4<T>& a, const tvec4<T>& b) { return a.x != b.x || a.y != b.y || a.z != b.z || a.w != b.w; }
 
 #undef VEC2_GET
 #undef VEC2_GET2
@@ -456,18 +478,18 @@ public:
     tvec2<T> m[2];
     tmat2<T>() = default;
     tmat2<T>(const tmat2<T>& m) = default;
-    tmat2<T>(const tmat3<T>& m);
-    tmat2<T>(const tmat4<T>& m);
-    tmat2<T>(T v) : m{{v,0}, {0,v}} { }
-    tmat2<T>(T xx, T xy, T yx, T yy) : m{{xx,xy}, {yx,yy}} { }
-    tmat2<T>(const tvec2<T>& x, const tvec2<T>& y) : m{x, y} { }
-    tvec2<T>& operator[](size_t index) { return m[index]; }
-    const tvec2<T>& operator[](size_t index) const { return m[index]; }
-    tmat2<T>& operator*=(T s) { m[0] *= s; m[1] *= s; return *this; }
-    tmat2<T>& operator*=(const tmat2<T>& a);
+    constexpr tmat2<T>(const tmat3<T>& m);
+    constexpr tmat2<T>(const tmat4<T>& m);
+    constexpr tmat2<T>(T v) : m{{v,0}, {0,v}} { }
+    constexpr tmat2<T>(T xx, T xy, T yx, T yy) : m{{xx,xy}, {yx,yy}} { }
+    constexpr tmat2<T>(const tvec2<T>& x, const tvec2<T>& y) : m{x, y} { }
+    constexpr tvec2<T>& operator[](size_t index) { return m[index]; }
+    constexpr const tvec2<T>& operator[](size_t index) const { return m[index]; }
+    constexpr tmat2<T>& operator*=(T s) { m[0] *= s; m[1] *= s; return *this; }
+    constexpr tmat2<T>& operator*=(const tmat2<T>& a);
 
     template <typename TT>
-    tmat2(const tmat2<TT>& v) : m{v.m[0], v.m[1]} { }
+    constexpr tmat2(const tmat2<TT>& v) : m{v.m[0], v.m[1]} { }
 };
 
 template <typename T>
@@ -476,10 +498,10 @@ public:
     tvec3<T> m[3];
     tmat3<T>() = default;
     tmat3<T>(const tmat3<T>& m) = default;
-    tmat3<T>(const tmat4<T>& m);
-    tmat3<T>(const tmat2<T>& m) : m{tvec3<T>(m[0], 0), tvec3<T>(m[1], 0), tvec3<T>(0, 0, 1)} { }
-    tmat3<T>(T v) : m{{v, 0, 0}, {0, v, 0}, {0, 0, v}} { }
-    tmat3<T>(T xx, T xy, T xz,
+    constexpr tmat3<T>(const tmat4<T>& m);
+    constexpr tmat3<T>(const tmat2<T>& m) : m{tvec3<T>(m[0], 0), tvec3<T>(m[1], 0), tvec3<T>(0, 0, 1)} { }
+    constexpr tmat3<T>(T v) : m{{v, 0, 0}, {0, v, 0}, {0, 0, v}} { }
+    constexpr tmat3<T>(T xx, T xy, T xz,
          T yx, T yy, T yz,
          T zx, T zy, T zz)
         : m{{xx, xy, xz}
@@ -487,14 +509,14 @@ public:
         ,   {zx, zy, zz}}
     {
     }
-    tmat3<T>(const tvec3<T>& x, const tvec3<T>& y, const tvec3<T>& z) : m{x, y, z} { }
-    tvec3<T>& operator[](size_t index) { return m[index]; }
-    const tvec3<T>& operator[](size_t index) const { return m[index]; }
-    tmat3<T>& operator*=(T s) { m[0] *= s; m[1] *= s; m[2] *= s; return *this; }
-    tmat3<T>& operator*=(const tmat3<T>& a);
+    constexpr tmat3<T>(const tvec3<T>& x, const tvec3<T>& y, const tvec3<T>& z) : m{x, y, z} { }
+    constexpr tvec3<T>& operator[](size_t index) { return m[index]; }
+    constexpr const tvec3<T>& operator[](size_t index) const { return m[index]; }
+    constexpr tmat3<T>& operator*=(T s) { m[0] *= s; m[1] *= s; m[2] *= s; return *this; }
+    constexpr tmat3<T>& operator*=(const tmat3<T>& a);
 
     template <typename TT>
-    tmat3(const tmat3<TT>& v) : m{v.m[0], v.m[1], v.m[2]} { }
+    constexpr tmat3(const tmat3<TT>& v) : m{v.m[0], v.m[1], v.m[2]} { }
 };
 
 template <typename T>
@@ -503,10 +525,10 @@ public:
     tvec4<T> m[4];
     tmat4<T>() = default;
     tmat4<T>(const tmat4<T>& m) = default;
-    tmat4<T>(const tmat3<T>& m) : m{tvec4<T>(m[0], 0), tvec4<T>(m[1], 0), tvec4<T>(m[2], 0), tvec4<T>(0, 0, 0, 1)} { }
-    tmat4<T>(const tmat2<T>& m) : m{tvec4<T>(m[0], 0, 0), tvec4<T>(m[1], 0, 0), tvec4<T>(0, 0, 1, 0), tvec4<T>(0, 0, 0, 1)} { }
-    tmat4<T>(T v) : m{{v, 0, 0, 0}, {0, v, 0, 0}, {0, 0, v, 0}, {0, 0, 0, v}} { }
-    tmat4<T>(T xx, T xy, T xz, T xw,
+    constexpr tmat4<T>(const tmat3<T>& m) : m{tvec4<T>(m[0], 0), tvec4<T>(m[1], 0), tvec4<T>(m[2], 0), tvec4<T>(0, 0, 0, 1)} { }
+    constexpr tmat4<T>(const tmat2<T>& m) : m{tvec4<T>(m[0], 0, 0), tvec4<T>(m[1], 0, 0), tvec4<T>(0, 0, 1, 0), tvec4<T>(0, 0, 0, 1)} { }
+    constexpr tmat4<T>(T v) : m{{v, 0, 0, 0}, {0, v, 0, 0}, {0, 0, v, 0}, {0, 0, 0, v}} { }
+    constexpr tmat4<T>(T xx, T xy, T xz, T xw,
          T yx, T yy, T yz, T yw,
          T zx, T zy, T zz, T zw,
          T wx, T wy, T wz, T ww)
@@ -516,14 +538,14 @@ public:
         ,   {wx, wy, wz, ww}}
     {
     }
-    tmat4<T>(const tvec4<T>& x, const tvec4<T>& y, const tvec4<T>& z, const tvec4<T>& w) : m{x, y, z, w} { }
-    tvec4<T>& operator[](size_t index) { return m[index]; }
-    const tvec4<T>& operator[](size_t index) const { return m[index]; }
-    tmat4<T>& operator*=(T s) { m[0] *= s; m[1] *= s; m[2] *= s; m[3] *= s; return *this; }
-    tmat4<T>& operator*=(const tmat4<T>& a);
+    constexpr tmat4<T>(const tvec4<T>& x, const tvec4<T>& y, const tvec4<T>& z, const tvec4<T>& w) : m{x, y, z, w} { }
+    constexpr tvec4<T>& operator[](size_t index) { return m[index]; }
+    constexpr const tvec4<T>& operator[](size_t index) const { return m[index]; }
+    constexpr tmat4<T>& operator*=(T s) { m[0] *= s; m[1] *= s; m[2] *= s; m[3] *= s; return *this; }
+    constexpr tmat4<T>& operator*=(const tmat4<T>& a);
 
     template <typename TT>
-    tmat4(const tmat4<TT>& v) : m{v.m[0], v.m[1], v.m[2], v.m[4]} { }
+    constexpr tmat4(const tmat4<TT>& v) : m{v.m[0], v.m[1], v.m[2], v.m[3]} { }
 };
 
 static_assert(sizeof(tmat2<float>) == 4 * 4, "invalid tmat2<T> alignment");
@@ -542,21 +564,25 @@ template <typename T>
 tvec4<T> abs(const tvec4<T>& a) { return tvec4<T>(abs(a.x), abs(a.y), abs(a.z), abs(a.w)); }
 
 template <typename T>
-tvec2<T> max(const tvec2<T>& a, const tvec2<T>& b ) { return tvec2<T>(max(a.x,b.x), max(a.y,b.y)); }
+constexpr tvec2<T> max(const tvec2<T>& a, const tvec2<T>& b ) { return tvec2<T>(max(a.x,b.x), max(a.y,b.y)); }
 template <typename T>
-tvec3<T> max(const tvec3<T>& a, const tvec3<T>& b ) { return tvec3<T>(max(a.x,b.x), max(a.y,b.y), max(a.z,b.z)); }
+constexpr tvec3<T> max(const tvec3<T>& a, const tvec3<T>& b ) { return tvec3<T>(max(a.x,b.x), max(a.y,b.y), max(a.z,b.z)); }
 template <typename T>
-tvec4<T> max(const tvec4<T>& a, const tvec4<T>& b ) { return tvec4<T>(max(a.x,b.x), max(a.y,b.y), max(a.z,b.z), max(a.w,b.w)); }
+constexpr tvec4<T> max(const tvec4<T>& a, const tvec4<T>& b ) { return tvec4<T>(max(a.x,b.x), max(a.y,b.y), max(a.z,b.z), max(a.w,b.w)); }
 
 template <typename T>
-tvec2<T> min(const tvec2<T>& a, const tvec2<T>& b ) { return tvec2<T>(min(a.x,b.x), min(a.y,b.y)); }
+constexpr tvec2<T> min(const tvec2<T>& a, const tvec2<T>& b ) { return tvec2<T>(min(a.x,b.x), min(a.y,b.y)); }
 template <typename T>
-tvec3<T> min(const tvec3<T>& a, const tvec3<T>& b ) { return tvec3<T>(min(a.x,b.x), min(a.y,b.y), min(a.z,b.z)); }
+constexpr tvec3<T> min(const tvec3<T>& a, const tvec3<T>& b ) { return tvec3<T>(min(a.x,b.x), min(a.y,b.y), min(a.z,b.z)); }
 template <typename T>
-tvec4<T> min(const tvec4<T>& a, const tvec4<T>& b ) { return tvec4<T>(min(a.x,b.x), min(a.y,b.y), min(a.z,b.z), min(a.w,b.w)); }
+constexpr tvec4<T> min(const tvec4<T>& a, const tvec4<T>& b ) { return tvec4<T>(min(a.x,b.x), min(a.y,b.y), min(a.z,b.z), min(a.w,b.w)); }
 
 inline float floor(float x) { return std::floor(x); }
 inline double floor(double x) { return std::floor(x); }
+inline float sqrt(float x) { return std::sqrt(x); }
+inline double sqrt(double x) { return std::sqrt(x); }
+inline float fabs(float x) { return std::fabs(x); }
+inline double fabs(double x) { return std::fabs(x); }
 template <typename T>
 tvec2<T> floor(const tvec2<T>& v) { return tvec2<T>(floor(v.x), floor(v.y)); }
 template <typename T>
@@ -581,15 +607,15 @@ template <typename T>
 tvec4<T> ceil(const tvec4<T>& v) { return tvec4<T>(::ceil(v.x), ::ceil(v.y), ::ceil(v.z), ::ceil(v.w)); }
 
 template <typename T>
-T cross(const tvec2<T>& a, const tvec2<T>& b) { return a.x*b.y - a.y*b.x; }
+constexpr T cross(const tvec2<T>& a, const tvec2<T>& b) { return a.x*b.y - a.y*b.x; }
 template <typename T>
-tvec3<T> cross(const tvec3<T>& a, const tvec3<T>& b) { return tvec3<T>(a.y*b.z - b.y*a.z, a.z*b.x - b.z*a.x, a.x*b.y - b.x*a.y); }
+constexpr tvec3<T> cross(const tvec3<T>& a, const tvec3<T>& b) { return tvec3<T>(a.y*b.z - b.y*a.z, a.z*b.x - b.z*a.x, a.x*b.y - b.x*a.y); }
 template <typename T>
-T dot(const tvec2<T>& a, const tvec2<T>& b) { return a.x*b.x + a.y*b.y; }
+constexpr T dot(const tvec2<T>& a, const tvec2<T>& b) { return a.x*b.x + a.y*b.y; }
 template <typename T>
-T dot(const tvec3<T>& a, const tvec3<T>& b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+constexpr T dot(const tvec3<T>& a, const tvec3<T>& b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
 template <typename T>
-T dot(const tvec4<T>& a, const tvec4<T>& b) { return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w; }
+constexpr T dot(const tvec4<T>& a, const tvec4<T>& b) { return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w; }
 
 template<typename T>
 typename T::value_type length(const T& a) { return sqrt(dot(a, a)); }
@@ -614,22 +640,22 @@ T reflect(const T& a, const T& b)
 }
 
 template<typename T>
-void identity(T& m) { m = T(1.0); }
+constexpr void identity(T& m) { m = T(1.0); }
 
 template <typename T>
-tvec2<T>::tvec2(const tvec3<T>& v) : x(v.x), y(v.y) { }
+constexpr tvec2<T>::tvec2(const tvec3<T>& v) : x(v.x), y(v.y) { }
 template <typename T>
-tvec2<T>::tvec2(const tvec4<T>& v) : x(v.x), y(v.y) { }
+constexpr tvec2<T>::tvec2(const tvec4<T>& v) : x(v.x), y(v.y) { }
 template <typename T>
-tvec3<T>::tvec3(const tvec4<T>& v) : x(v.x), y(v.y), z(v.z) { }
+constexpr tvec3<T>::tvec3(const tvec4<T>& v) : x(v.x), y(v.y), z(v.z) { }
 
 template <typename T>
-tmat2<T>::tmat2(const tmat3<T>& m) : m{{m[0].x, m[0].y}, {m[1].x, m[1].y}} { }
+constexpr tmat2<T>::tmat2(const tmat3<T>& m) : m{{m[0].x, m[0].y}, {m[1].x, m[1].y}} { }
 template <typename T>
-tmat2<T>::tmat2(const tmat4<T>& m) : m{{m[0].x, m[0].y}, {m[1].x, m[1].y}} { }
+constexpr tmat2<T>::tmat2(const tmat4<T>& m) : m{{m[0].x, m[0].y}, {m[1].x, m[1].y}} { }
 
 template <typename T>
-tmat3<T>::tmat3(const tmat4<T>& m)
+constexpr tmat3<T>::tmat3(const tmat4<T>& m)
     : m{{m[0].x, m[0].y, m[0].z}
     ,   {m[1].x, m[1].y, m[1].z}
     ,   {m[2].x, m[2].y, m[2].z}}
@@ -637,7 +663,7 @@ tmat3<T>::tmat3(const tmat4<T>& m)
 }
 
 template <typename T>
-tvec2<T> operator*(const tmat2<T>& m, const tvec2<T>& v)
+constexpr tvec2<T> operator*(const tmat2<T>& m, const tvec2<T>& v)
 {
     return tvec2<T>(
         m[0].x * v.x + m[1].x * v.y,
@@ -645,7 +671,7 @@ tvec2<T> operator*(const tmat2<T>& m, const tvec2<T>& v)
 }
 
 template <typename T>
-tvec2<T> operator*(const tvec2<T>& v, const tmat2<T>& m)
+constexpr tvec2<T> operator*(const tvec2<T>& v, const tmat2<T>& m)
 {
     return tvec2<T>(
         m[0].x * v.x + m[0].y * v.y,
@@ -653,7 +679,7 @@ tvec2<T> operator*(const tvec2<T>& v, const tmat2<T>& m)
 }
 
 template <typename T>
-tvec3<T> operator*(const tmat3<T>& m, const tvec3<T>& v)
+constexpr tvec3<T> operator*(const tmat3<T>& m, const tvec3<T>& v)
 {
     return tvec3<T>(
         m[0].x * v.x + m[1].x * v.y + m[2].x * v.z,
@@ -662,7 +688,7 @@ tvec3<T> operator*(const tmat3<T>& m, const tvec3<T>& v)
 }
 
 template <typename T>
-tvec3<T> operator*(const tvec3<T>& v, const tmat3<T>& m)
+constexpr tvec3<T> operator*(const tvec3<T>& v, const tmat3<T>& m)
 {
     return tvec3<T>(
         m[0].x * v.x + m[0].y * v.y + m[0].z * v.z,
@@ -671,7 +697,7 @@ tvec3<T> operator*(const tvec3<T>& v, const tmat3<T>& m)
 }
 
 template <typename T>
-tvec4<T> operator*(const tmat4<T>& m, const tvec4<T>& v)
+constexpr tvec4<T> operator*(const tmat4<T>& m, const tvec4<T>& v)
 {
     return tvec4<T>(
         m[0].x * v.x + m[1].x * v.y + m[2].x * v.z + m[3].x * v.w,
@@ -681,7 +707,7 @@ tvec4<T> operator*(const tmat4<T>& m, const tvec4<T>& v)
 }
 
 template <typename T>
-tvec4<T> operator*(const tvec4<T>& v, const tmat4<T>& m)
+constexpr tvec4<T> operator*(const tvec4<T>& v, const tmat4<T>& m)
 {
     return tvec4<T>(
         m[0].x * v.x + m[0].y * v.y + m[0].z * v.z + m[0].w * v.w,
@@ -691,7 +717,7 @@ tvec4<T> operator*(const tvec4<T>& v, const tmat4<T>& m)
 }
 
 template <typename T>
-tmat2<T> operator*(const tmat2<T>& a, const tmat2<T>& b)
+constexpr tmat2<T> operator*(const tmat2<T>& a, const tmat2<T>& b)
 {
     // Multiplication:
     // |00 10| * |00 10| = |0 2|
@@ -706,7 +732,7 @@ tmat2<T> operator*(const tmat2<T>& a, const tmat2<T>& b)
 }
 
 template <typename T>
-tmat3<T> operator*(const tmat3<T>& a, const tmat3<T>& b)
+constexpr tmat3<T> operator*(const tmat3<T>& a, const tmat3<T>& b)
 {
     // Multiplication:
     // |00 10 20|   |00 10 20|   |0 3 6|
@@ -731,7 +757,7 @@ tmat3<T> operator*(const tmat3<T>& a, const tmat3<T>& b)
 }
 
 template <typename T>
-tmat4<T> operator*(const tmat4<T>& a, const tmat4<T>& b)
+constexpr tmat4<T> operator*(const tmat4<T>& a, const tmat4<T>& b)
 {
     // Multiplication:
     // |00 10 20 30|   |00 10 20 30|   |0 4  8 12|
@@ -766,28 +792,28 @@ tmat4<T> operator*(const tmat4<T>& a, const tmat4<T>& b)
 }
 
 template <typename T>
-tmat2<T>& tmat2<T>::operator*=(const tmat2<T>& a)
+constexpr tmat2<T>& tmat2<T>::operator*=(const tmat2<T>& a)
 {
     *this = (*this) * a;
     return *this;
 }
 
 template <typename T>
-tmat3<T>& tmat3<T>::operator*=(const tmat3<T>& a)
+constexpr tmat3<T>& tmat3<T>::operator*=(const tmat3<T>& a)
 {
     *this = (*this) * a;
     return *this;
 }
 
 template <typename T>
-tmat4<T>& tmat4<T>::operator*=(const tmat4<T>& a)
+constexpr tmat4<T>& tmat4<T>::operator*=(const tmat4<T>& a)
 {
     *this = (*this) * a;
     return *this;
 }
 
 template <typename T, typename T1 = T, typename T2 = T>
-void translate(tmat3<T>& m, T1 _x, T2 _y)
+constexpr void translate(tmat3<T>& m, T1 _x, T2 _y)
 {
     T x = static_cast<T>(_x);
     T y = static_cast<T>(_y);
@@ -796,7 +822,7 @@ void translate(tmat3<T>& m, T1 _x, T2 _y)
 }
 
 template <typename T, typename T1 = T, typename T2 = T, typename T3 = T>
-void translate(tmat4<T>& m, T1 _x, T2 _y, T3 _z)
+constexpr void translate(tmat4<T>& m, T1 _x, T2 _y, T3 _z)
 {
     T x = static_cast<T>(_x);
     T y = static_cast<T>(_y);
@@ -806,66 +832,142 @@ void translate(tmat4<T>& m, T1 _x, T2 _y, T3 _z)
     m[3].z += m[0].z * x + m[1].z * y + m[2].z * z;
 }
 
+// Compile-time approximations of the <cmath> functions used by the transforms
+// below. They are slower than the library versions, so use them only where
+// the result can be folded into a constant.
 template <typename T>
-tmat2<T> rotation(T angle)
+constexpr T ctSqrt(T x)
 {
-    T co, si;
+    if (!(x > 0))
+        return 0;
+    T r = x < 1 ? T(1) : x;
+    for (int i = 0; i < 128; ++i) {
+        const T next = (r + x / r) / 2;
+        if (!(next < r))
+            break;
+        r = next;
+    }
+    return r;
+}
 
-    angle *= M_PI / 180.0;
-    co = cos(angle);
-    si = sin(angle);
+constexpr double ctSin(double x)
+{
+    // reduce to [-pi/2, pi/2] and sum the Taylor series
+    const double k = x / (2 * M_PI);
+    x -= 2 * M_PI * static_cast<double>(static_cast<long long>(k < 0 ? k - 0.5 : k + 0.5));
+    if (x > M_PI / 2)
+        x = M_PI - x;
+    else if (x < -M_PI / 2)
+        x = -M_PI - x;
+    const double x2 = x * x;
+    double term = x, sum = x;
+    for (int i = 1; i < 12; ++i) {
+        term *= -x2 / ((2 * i) * (2 * i + 1));
+        sum += term;
+    }
+    return sum;
+}
 
-    T bm0 = co, bm1 = si,
-      bm2 = -si, bm3 = co;
+constexpr double ctCos(double x)
+{
+    return ctSin(x + M_PI / 2);
+}
 
-    return tmat2<T>(bm0, bm1, bm2, bm3);
+template <typename T>
+constexpr T ctSin(T x)
+{
+    return static_cast<T>(ctSin(static_cast<double>(x)));
 }
 
 template <typename T>
-tmat3<T> rotation(T angle, T ax, T ay, T az)
+constexpr T ctCos(T x)
 {
-    T si, co, ti, tx, ty, tz, sx, sy, sz;
+    return static_cast<T>(ctCos(static_cast<double>(x)));
+}
 
-    T ad = sqrt(ax*ax + ay*ay + az*az);
-    if (ad > 0) {
-        ad = 1 / ad;
-        ax *= ad;
-        ay *= ad;
-        az *= ad;
-    }
-    else {
-        return tmat3<T>(1);
-    }
+template <typename T>
+constexpr T ctTan(T x)
+{
+    return static_cast<T>(ctSin(static_cast<double>(x)) / ctCos(static_cast<double>(x)));
+}
 
-    angle *= -M_PI / 180.0;
-    si = sin(angle);
-    co = cos(angle);
-    ti = 1 - co;
+template <typename T>
+constexpr tmat2<T> sinCosRotation(T si, T co)
+{
+    return tmat2<T>(co, si, -si, co);
+}
 
-    tx = ti * ax; ty = ti * ay; tz = ti * az;
-    sx = si * ax; sy = si * ay; sz = si * az;
+// Rotation by the angle given with its sine and cosine, around normalized axis.
+template <typename T>
+constexpr tmat3<T> sinCosRotation(T si, T co, T ax, T ay, T az)
+{
+    const T ti = 1 - co;
+    const T tx = ti * ax, ty = ti * ay, tz = ti * az;
+    const T sx = si * ax, sy = si * ay, sz = si * az;
 
     // derived from multiply(mm,mm,bm)
-    T bm0, bm1, bm2, bm4, bm5, bm6, bm8, bm9, bm10;
+    return tmat3<T>(
+        tx * ax + co, tx * ay - sz, tx * az + sy,
+        tx * ay + sz, ty * ay + co, ty * az - sx,
+        tx * az - sy, ty * az + sx, tz * az + co);
+}
 
-    bm0 = tx * ax + co;
-    bm4 = tx * ay + sz;
-    bm8 = tx * az - sy;
+template <typename T>
+tmat2<T> rotation(T angle)
+{
+    angle *= M_PI / 180.0;
+    return sinCosRotation<T>(sin(angle), cos(angle));
+}
 
-    bm1 = tx * ay - sz;
-    bm5 = ty * ay + co;
-    bm9 = ty * az + sx;
+template <typename T>
+tmat3<T> rotation(T angle, T ax, T ay, T az)
+{
+    const T ad = sqrt(ax*ax + ay*ay + az*az);
+    if (!(ad > 0))
+        return tmat3<T>(1);
+    angle *= -M_PI / 180.0;
+    return sinCosRotation<T>(sin(angle), cos(angle), ax / ad, ay / ad, az / ad);
+}
 
-    bm2 = tx * az + sy;
-    bm6 = ty * az - sx;
-    bm10 = tz * az + co;
+template <typename T>
+constexpr tmat2<T> ctRotation(T angle)
+{
+    angle *= M_PI / 180.0;
+    return sinCosRotation<T>(ctSin(angle), ctCos(angle));
+}
 
-    return tmat3<T>(
-        bm0, bm1, bm2,
-        bm4, bm5, bm6,
-        bm8, bm9, bm10);
+template <typename T>
+constexpr tmat3<T> ctRotation(T angle, T ax, T ay, T az)
+{
+    const T ad = ctSqrt(ax*ax + ay*ay + az*az);
+    if (!(ad > 0))
+        return tmat3<T>(1);
+    angle *= -M_PI / 180.0;
+    return sinCosRotation<T>(ctSin(angle), ctCos(angle), ax / ad, ay / ad, az / ad);
 }
 
+// Sines and cosines of N angles evenly spaced around the full circle.
+// Declare it constexpr to have the table computed by the compiler:
+//   static constexpr SinCosTable<float, 256> table;
+template <typename T, size_t N>
+class SinCosTable
+{
+public:
+    constexpr SinCosTable() : sin{}, cos{}
+    {
+        for (size_t i = 0; i < N; ++i) {
+            const double angle = 2 * M_PI * i / N;
+            sin[i] = static_cast<T>(ctSin(angle));
+            cos[i] = static_cast<T>(ctCos(angle));
+        }
+    }
+
+    constexpr tmat2<T> rotation(size_t index) const { return sinCosRotation(sin[index], cos[index]); }
+
+    T sin[N];
+    T cos[N];
+};
+
 template <typename T, typename T1 = T>
 void rotate(tmat3<T>& m, T1 angle)
 {
@@ -879,7 +981,7 @@ void rotate(tmat4<T>& m, T1 angle, T2 ax, T3 ay, T4 az)
 }
 
 template <typename T>
-tmat2<T> transpose(const tmat2<T>& m)
+constexpr tmat2<T> transpose(const tmat2<T>& m)
 {
     return tmat2<T>(
         m[0].x, m[1].x,
@@ -887,7 +989,7 @@ tmat2<T> transpose(const tmat2<T>& m)
 }
 
 template <typename T>
-tmat3<T> transpose(const tmat3<T>& m)
+constexpr tmat3<T> transpose(const tmat3<T>& m)
 {
     return tmat3<T>(
         m[0].x, m[1].x, m[2].x,
@@ -896,7 +998,7 @@ tmat3<T> transpose(const tmat3<T>& m)
 }
 
 template <typename T>
-tmat4<T> transpose(const tmat4<T>& m)
+constexpr tmat4<T> transpose(const tmat4<T>& m)
 {
     return tmat4<T>(
         m[0].x, m[1].x, m[2].x, m[3].x,
@@ -906,7 +1008,7 @@ tmat4<T> transpose(const tmat4<T>& m)
 }
 
 template <typename T>
-tmat2<T> inverse(const tmat2<T>& m)
+constexpr tmat2<T> inverse(const tmat2<T>& m)
 {
     // column-major order:
     // |a c|
@@ -917,7 +1019,7 @@ tmat2<T> inverse(const tmat2<T>& m)
 }
 
 template <typename T>
-tmat3<T> inverse(const tmat3<T>& m)
+constexpr tmat3<T> inverse(const tmat3<T>& m)
 {
     // column-major order:
     // | ax bx cx | ax bx cx
@@ -1029,6 +1131,198 @@ tmat4<T> inverse(const tmat4<T>& m) {
             dst12*d, dst13*d, dst14*d, dst15*d);
 }
 
+#if GlslMathSimd
+// SSE/AVX specializations for single precision.
+// Products and sums are evaluated in the same order as in the generic
+// templates, so multiplication and transpose give identical results.
+namespace simd
+{
+
+inline __m128 load(const tvec4<float>& v) { return _mm_loadu_ps(&v.x); }
+inline void store(tvec4<float>& v, __m128 r) { _mm_storeu_ps(&v.x, r); }
+
+template <int x, int y, int z, int w>
+inline __m128 swizzle(__m128 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x)); }
+
+template <int x, int y, int z, int w>
+inline __m128 shuffle(__m128 a, __m128 b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x)); }
+
+// m[0]*v.x + m[1]*v.y + m[2]*v.z + m[3]*v.w
+inline __m128 combine(const __m128 m[4], __m128 v)
+{
+    __m128 r = _mm_mul_ps(m[0], swizzle<0, 0, 0, 0>(v));
+    r = _mm_add_ps(r, _mm_mul_ps(m[1], swizzle<1, 1, 1, 1>(v)));
+    r = _mm_add_ps(r, _mm_mul_ps(m[2], swizzle<2, 2, 2, 2>(v)));
+    return _mm_add_ps(r, _mm_mul_ps(m[3], swizzle<3, 3, 3, 3>(v)));
+}
+
+// 2x2 blocks stored as (00, 01, 10, 11).
+inline __m128 mat2Mul(__m128 a, __m128 b)
+{
+    return _mm_add_ps(_mm_mul_ps(a, swizzle<0, 3, 0, 3>(b)),
+        _mm_mul_ps(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+}
+
+// adjugate(a)*b
+inline __m128 mat2AdjMul(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(swizzle<3, 3, 0, 0>(a), b),
+        _mm_mul_ps(swizzle<1, 1, 2, 2>(a), swizzle<2, 3, 0, 1>(b)));
+}
+
+// a*adjugate(b)
+inline __m128 mat2MulAdj(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(a, swizzle<3, 0, 3, 0>(b)),
+        _mm_mul_ps(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+}
+
+} // namespace simd
+
+template <>
+inline tmat4<float> operator*(const tmat4<float>& a, const tmat4<float>& b)
+{
+    tmat4<float> ret;
+#if GlslMathAvx
+    // Two result columns per iteration.
+    const __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[0].x));
+    const __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[1].x));
+    const __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[2].x));
+    const __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[3].x));
+    for (int j = 0; j < 4; j += 2) {
+        const __m256 v = _mm256_loadu_ps(&b[j].x);
+        __m256 r = _mm256_mul_ps(a0, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm256_storeu_ps(&ret[j].x, r);
+    }
+#else
+    const __m128 am[4] = { simd::load(a[0]), simd::load(a[1]), simd::load(a[2]), simd::load(a[3]) };
+    simd::store(ret[0], simd::combine(am, simd::load(b[0])));
+    simd::store(ret[1], simd::combine(am, simd::load(b[1])));
+    simd::store(ret[2], simd::combine(am, simd::load(b[2])));
+    simd::store(ret[3], simd::combine(am, simd::load(b[3])));
+#endif
+    return ret;
+}
+
+template <>
+inline tvec4<float> operator*(const tmat4<float>& m, const tvec4<float>& v)
+{
+    const __m128 mm[4] = { simd::load(m[0]), simd::load(m[1]), simd::load(m[2]), simd::load(m[3]) };
+    tvec4<float> ret;
+    simd::store(ret, simd::combine(mm, simd::load(v)));
+    return ret;
+}
+
+template <>
+inline tvec4<float> operator*(const tvec4<float>& v, const tmat4<float>& m)
+{
+    const __m128 vv = simd::load(v);
+    __m128 p0 = _mm_mul_ps(simd::load(m[0]), vv);
+    __m128 p1 = _mm_mul_ps(simd::load(m[1]), vv);
+    __m128 p2 = _mm_mul_ps(simd::load(m[2]), vv);
+    __m128 p3 = _mm_mul_ps(simd::load(m[3]), vv);
+    _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+    tvec4<float> ret;
+    simd::store(ret, _mm_add_ps(_mm_add_ps(_mm_add_ps(p0, p1), p2), p3));
+    return ret;
+}
+
+template <>
+inline tmat4<float> transpose(const tmat4<float>& m)
+{
+    __m128 c0 = simd::load(m[0]), c1 = simd::load(m[1]), c2 = simd::load(m[2]), c3 = simd::load(m[3]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    tmat4<float> ret;
+    simd::store(ret[0], c0);
+    simd::store(ret[1], c1);
+    simd::store(ret[2], c2);
+    simd::store(ret[3], c3);
+    return ret;
+}
+
+template <>
+inline tmat4<float> inverse(const tmat4<float>& m)
+{
+    // Block-wise inversion using 2x2 sub-matrices:
+    //  M = |A B|   inverse(M) = 1/|M| * |X Y|
+    //      |C D|                        |Z W|
+    // Blocks are taken from the transpose of m, which yields the transpose
+    // of the inverse, stored back in column-major order.
+    using namespace simd;
+    const __m128 c0 = load(m[0]), c1 = load(m[1]), c2 = load(m[2]), c3 = load(m[3]);
+    const __m128 a = _mm_movelh_ps(c0, c1);
+    const __m128 b = _mm_movehl_ps(c1, c0);
+    const __m128 c = _mm_movelh_ps(c2, c3);
+    const __m128 d = _mm_movehl_ps(c3, c2);
+
+    // (|A|, |B|, |C|, |D|)
+    const __m128 detSub = _mm_sub_ps(
+        _mm_mul_ps(shuffle<0, 2, 0, 2>(c0, c2), shuffle<1, 3, 1, 3>(c1, c3)),
+        _mm_mul_ps(shuffle<1, 3, 1, 3>(c0, c2), shuffle<0, 2, 0, 2>(c1, c3)));
+    const __m128 detA = swizzle<0, 0, 0, 0>(detSub);
+    const __m128 detB = swizzle<1, 1, 1, 1>(detSub);
+    const __m128 detC = swizzle<2, 2, 2, 2>(detSub);
+    const __m128 detD = swizzle<3, 3, 3, 3>(detSub);
+
+    const __m128 dc = mat2AdjMul(d, c);
+    const __m128 ab = mat2AdjMul(a, b);
+    __m128 x = _mm_sub_ps(_mm_mul_ps(detD, a), mat2Mul(b, dc));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(detA, d), mat2Mul(c, ab));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(detB, c), mat2MulAdj(d, ab));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(detC, b), mat2MulAdj(a, dc));
+
+    // |M| = |A|*|D| + |B|*|C| - trace(A#B * D#C)
+    __m128 tr = _mm_mul_ps(ab, swizzle<0, 2, 1, 3>(dc));
+    tr = _mm_add_ps(tr, swizzle<1, 0, 3, 2>(tr));
+    tr = _mm_add_ps(tr, swizzle<2, 3, 0, 1>(tr));
+    const __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+    const __m128 rdet = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), det);
+    x = _mm_mul_ps(x, rdet);
+    y = _mm_mul_ps(y, rdet);
+    z = _mm_mul_ps(z, rdet);
+    w = _mm_mul_ps(w, rdet);
+
+    tmat4<float> ret;
+    store(ret[0], shuffle<3, 1, 3, 1>(x, y));
+    store(ret[1], shuffle<2, 0, 2, 0>(x, y));
+    store(ret[2], shuffle<3, 1, 3, 1>(z, w));
+    store(ret[3], shuffle<2, 0, 2, 0>(z, w));
+    return ret;
+}
+#endif
+
+// Inverse of m = |A t| with a general 3x3 A (rotation, scale, shear).
+//                |0 1|
+template <typename T>
+constexpr tmat4<T> inverseAffine(const tmat4<T>& m)
+{
+    const tmat3<T> a = inverse(tmat3<T>(m));
+    return tmat4<T>(tvec4<T>(a[0], 0), tvec4<T>(a[1], 0), tvec4<T>(a[2], 0),
+        tvec4<T>(a * (-tvec3<T>(m[3])), 1));
+}
+
+// Inverse of m = |R t| with orthonormal R (rotation and translation only),
+//                |0 1|
+// e.g. a camera set up by lookAt().
+template <typename T>
+constexpr tmat4<T> inverseRigid(const tmat4<T>& m)
+{
+    const tmat3<T> r = transpose(tmat3<T>(m));
+    return tmat4<T>(tvec4<T>(r[0], 0), tvec4<T>(r[1], 0), tvec4<T>(r[2], 0),
+        tvec4<T>(r * (-tvec3<T>(m[3])), 1));
+}
+
+// Transforms normals by the upper 3x3 part of m.
+template <typename T>
+constexpr tmat3<T> normalMatrix(const tmat4<T>& m)
+{
+    return transpose(inverse(tmat3<T>(m)));
+}
+
 template <typename T>
 void lookAt(tmat4<T>& mat, T px, T py, T pz, T fx, T fy, T fz, T ux, T uy, T uz)
 {
@@ -1194,15 +1488,16 @@ tvec3<T> getCameraPosition(const tmat4<T>& m)
 }
 
 template <typename T>
-void setCameraPosition(tmat4<T>& m, const tvec3<T>& pos)
+constexpr void setCameraPosition(tmat4<T>& m, const tvec3<T>& pos)
 {
     m[3] = tvec4<T>(tmat3<T>(m)*(-pos), 1.0);
 }
 
+// Perspective projection from d = 1 / tan(fovy / 2), shared by the runtime
+// and compile-time variants below.
 template <typename T>
-tmat4<T> perspectiveProjection(T fovy, T aspect, T near_z, T far_z)
+constexpr tmat4<T> focalPerspectiveProjection(T d, T aspect, T near_z, T far_z)
 {
-    const T d = 1.0 / tan(M_PI * fovy / 360.0);
     const T ax = d / aspect;
     const T by = d;
     const T cz = (near_z + far_z) / (near_z - far_z);
@@ -1215,7 +1510,19 @@ tmat4<T> perspectiveProjection(T fovy, T aspect, T near_z, T far_z)
 }
 
 template <typename T>
-tmat4<T> orthographicProjection(T left, T right, T bottom, T top, T near, T far)
+tmat4<T> perspectiveProjection(T fovy, T aspect, T near_z, T far_z)
+{
+    return focalPerspectiveProjection<T>(1.0 / tan(M_PI * fovy / 360.0), aspect, near_z, far_z);
+}
+
+template <typename T>
+constexpr tmat4<T> ctPerspectiveProjection(T fovy, T aspect, T near_z, T far_z)
+{
+    return focalPerspectiveProjection<T>(1.0 / ctTan(M_PI * fovy / 360.0), aspect, near_z, far_z);
+}
+
+template <typename T>
+constexpr tmat4<T> orthographicProjection(T left, T right, T bottom, T top, T near, T far)
 {
     const T tx = -(right + left) / (right - left);
     const T ty = -(top + bottom) / (top - bottom);
@@ -1254,12 +1561,85 @@ void calculate_ray(tvec3<T>& ret_pos, tvec3<T>& ret_dir, T screen_x, T screen_y,
     // Projection transformation:
     //  ndc = view.xyz / view.w
     //  view.xyz = ndc * view.w
+
+    // modelView is affine (see inverseAffine), projection is general.
     ret_pos = getCameraPosition(modelView);
     tvec4<T> clip_dir = tvec4<T>(
         (screen_x - viewX) * 2 / static_cast<T>(viewWidth) - 1,
         (viewY + viewHeight - screen_y) * 2 / static_cast<T>(viewHeight) - 1,
         1, 1);
-    ret_dir = normalize(inverse(modelView) * (inverse(projection) * clip_dir));
+    ret_dir = normalize(inverseAffine(modelView) * (inverse(projection) * clip_dir));
+}
+
+// Matrix with its inverse and normal matrix, computed on first use after
+// each change. Telling the structure of the matrix picks the cheaper
+// inverseAffine()/inverseRigid() and, for Rigid, skips the normal matrix
+// inversion altogether:
+//
+//   transform modelView(m, transform::Rigid);
+//   setModelViewMatrix(program, modelView, true);
+template <typename T>
+class ttransform {
+public:
+    enum Kind { General, Affine, Rigid };
+
+    ttransform<T>() : ttransform<T>(tmat4<T>(1), Rigid) { }
+    explicit ttransform<T>(const tmat4<T>& m, Kind kind = Affine) { set(m, kind); }
+
+    void set(const tmat4<T>& m, Kind kind = Affine)
+    {
+        mat = m;
+        matKind = kind;
+        inverseValid = false;
+        normalValid = false;
+    }
+
+    const tmat4<T>& matrix() const { return mat; }
+    Kind kind() const { return matKind; }
+
+    const tmat4<T>& inverse() const
+    {
+        if (!inverseValid) {
+            inv = (matKind == Rigid) ? inverseRigid(mat)
+                : (matKind == Affine) ? inverseAffine(mat)
+                : glsl_math::inverse(mat);
+            inverseValid = true;
+        }
+        return inv;
+    }
+
+    const tmat3<T>& normalMatrix() const
+    {
+        if (!normalValid) {
+            // reuse the inverse if it is already there
+            normal = (matKind == Rigid) ? tmat3<T>(mat)
+                : inverseValid ? transpose(tmat3<T>(inv))
+                : glsl_math::normalMatrix(mat);
+            normalValid = true;
+        }
+        return normal;
+    }
+
+private:
+    tmat4<T> mat;
+    mutable tmat4<T> inv;
+    mutable tmat3<T> normal;
+    Kind matKind;
+    mutable bool inverseValid;
+    mutable bool normalValid;
+};
+
+// Same as above, using the cached inverses (projection may be General).
+template <typename T>
+void calculate_ray(tvec3<T>& ret_pos, tvec3<T>& ret_dir, T screen_x, T screen_y,
+    const ttransform<T>& modelView, const ttransform<T>& projection, int viewX, int viewY, int viewWidth, int viewHeight)
+{
+    ret_pos = tvec3<T>(modelView.inverse()[3]);
+    tvec4<T> clip_dir = tvec4<T>(
+        (screen_x - viewX) * 2 / static_cast<T>(viewWidth) - 1,
+        (viewY + viewHeight - screen_y) * 2 / static_cast<T>(viewHeight) - 1,
+        1, 1);
+    ret_dir = normalize(modelView.inverse() * (projection.inverse() * clip_dir));
 }
 
 // Conversions.
@@ -1294,12 +1674,14 @@ using vec4 = tvec4<double>;
 using mat2 = tmat2<double>;
 using mat3 = tmat3<double>;
 using mat4 = tmat4<double>;
+using transform = ttransform<double>;
 using vec2f = tvec2<float>;
 using vec3f = tvec3<float>;
 using vec4f = tvec4<float>;
 using mat2f = tmat2<float>;
 using mat3f = tmat3<float>;
 using mat4f = tmat4<float>;
+using transformf = ttransform<float>;
 using ivec2 = tvec2<int>;
 using ivec3 = tvec3<int>;
 using ivec4 = tvec4<int>;
@@ -0,0 +1,46 @@
+// GLSL-like math library - batch transformations of vertex arrays
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <glslMath.h>
+
+namespace glsl_math
+{
+
+// Arrays are interleaved float vertex data as used by GLMesh formats,
+// e.g. for PTNC: stride = 15, positions at data + 0, normals at data + 8;
+// for XYZUVN: stride = 8, positions at data + 0, normals at data + 5.
+// src and dst may point to the same array (in-place transformation).
+// Large arrays are split across ThreadPool::global().
+
+// components = 3: dst.xyz = (m * vec4(src.xyz, 1)).xyz
+// components = 4: dst.xyzw = m * src.xyzw
+void transformPoints(const mat4f& m, const float* src, float* dst,
+    size_t count, size_t stride, size_t components = 3);
+void transformPoints(const mat4& m, const float* src, float* dst,
+    size_t count, size_t stride, size_t components = 3);
+
+// dst.xyz = normalMatrix * src.xyz, optionally renormalized.
+void transformNormals(const mat3f& normalMatrix, const float* src, float* dst,
+    size_t count, size_t stride, bool renormalize = true);
+// Uses transpose(inverse(mat3(m))) as the normal matrix.
+void transformNormals(const mat4f& m, const float* src, float* dst,
+    size_t count, size_t stride, bool renormalize = true);
+void transformNormals(const mat4& m, const float* src, float* dst,
+    size_t count, size_t stride, bool renormalize = true);
+
+} // namespace glsl_math
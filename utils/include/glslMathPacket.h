@@ -0,0 +1,563 @@
+// GLSL-like math library - structure-of-arrays packet types
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <glslMath.h>
+
+#include <cstring>
+
+#if GlslMathSimd && defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+// floatx4/floatx8 hold 4/8 independent float lanes and plug into the
+// tvecN<T> templates, so tvec3<floatx8> (vec3x8) is 8 vec3f in SoA layout:
+//
+//   vec3x8 p, n;
+//   gather(p, vertexData.data(), 15);      // 8 PTNC positions
+//   gather(n, vertexData.data() + 8, 15);  // 8 PTNC normals
+//   n = normalize(n + cross(p, n));
+//   scatter(n, vertexData.data() + 8, 15);
+//
+// Comparisons return masks (maskx4/maskx8) to be used with select().
+// Backends: SSE2 (SSE4.1 floor), AVX (AVX2 gathers) or scalar
+// when GlslMathSimd is 0.
+//
+// madd, exp2i, frexp and rsqrtEstimate are the building blocks of
+// glslFastMath.h; they also have float versions below, so templates written
+// against packets can be instantiated with plain float.
+
+namespace glsl_math
+{
+
+class maskx4;
+class floatx4;
+
+// Branch-free, like the packet versions (random masks mispredict).
+inline float select(bool m, float a, float b)
+{
+    const uint32_t mask = 0u - static_cast<uint32_t>(m);
+    uint32_t i, j;
+    memcpy(&i, &a, sizeof(i));
+    memcpy(&j, &b, sizeof(j));
+    i = (i & mask) | (j & ~mask);
+    float r;
+    memcpy(&r, &i, sizeof(r));
+    return r;
+}
+
+// a*b + c, fused when the target has FMA, as the packet versions, so
+// scalar and packet results keep the same bits.
+inline float madd(float a, float b, float c)
+{
+#if GlslMathSimd && defined(__FMA__)
+    return _mm_cvtss_f32(_mm_fmadd_ss(_mm_set_ss(a), _mm_set_ss(b), _mm_set_ss(c)));
+#else
+    return a * b + c;
+#endif
+}
+
+// 2^n for integral n in [-126, 127].
+inline float exp2i(float n)
+{
+    const uint32_t i = static_cast<uint32_t>(static_cast<int32_t>(n) + 127) << 23;
+    float r;
+    memcpy(&r, &i, sizeof(r));
+    return r;
+}
+
+// x = m * 2^e with |m| in [0.5, 1), for normal (not denormal) finite x != 0.
+inline float frexp(float x, float& e)
+{
+    uint32_t i;
+    memcpy(&i, &x, sizeof(i));
+    e = static_cast<float>(static_cast<int32_t>((i >> 23) & 0xff) - 126);
+    i = (i & ~0x7f800000u) | 0x3f000000u;
+    float m;
+    memcpy(&m, &i, sizeof(m));
+    return m;
+}
+
+// Approximate 1/sqrt(x): 12 bits with SSE, 9 bits otherwise.
+inline float rsqrtEstimate(float x)
+{
+#if GlslMathSimd
+    return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+    uint32_t i;
+    memcpy(&i, &x, sizeof(i));
+    i = 0x5f3759df - (i >> 1);
+    float r;
+    memcpy(&r, &i, sizeof(r));
+    return r * (1.5f - 0.5f * x * r * r);
+#endif
+}
+
+#if GlslMathSimd
+
+class maskx4 {
+public:
+    __m128 v;
+    maskx4() = default;
+    maskx4(__m128 v) : v(v) { }
+    maskx4(bool b) : v(_mm_castsi128_ps(_mm_set1_epi32(b ? -1 : 0))) { }
+};
+
+inline maskx4 operator&(const maskx4& a, const maskx4& b) { return _mm_and_ps(a.v, b.v); }
+inline maskx4 operator|(const maskx4& a, const maskx4& b) { return _mm_or_ps(a.v, b.v); }
+inline maskx4 operator^(const maskx4& a, const maskx4& b) { return _mm_xor_ps(a.v, b.v); }
+inline maskx4 operator~(const maskx4& a) { return _mm_xor_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+inline int movemask(const maskx4& a) { return _mm_movemask_ps(a.v); }
+
+class floatx4 {
+public:
+    static constexpr int size = 4;
+    __m128 v;
+    floatx4() = default;
+    floatx4(__m128 v) : v(v) { }
+    floatx4(float s) : v(_mm_set1_ps(s)) { }
+    floatx4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) { }
+    static floatx4 load(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+    float operator[](int i) const { float t[4]; store(t); return t[i]; }
+    floatx4& operator+=(const floatx4& a) { v = _mm_add_ps(v, a.v); return *this; }
+    floatx4& operator-=(const floatx4& a) { v = _mm_sub_ps(v, a.v); return *this; }
+    floatx4& operator*=(const floatx4& a) { v = _mm_mul_ps(v, a.v); return *this; }
+    floatx4& operator/=(const floatx4& a) { v = _mm_div_ps(v, a.v); return *this; }
+};
+
+inline floatx4 operator-(const floatx4& a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline floatx4 operator+(const floatx4& a, const floatx4& b) { return _mm_add_ps(a.v, b.v); }
+inline floatx4 operator-(const floatx4& a, const floatx4& b) { return _mm_sub_ps(a.v, b.v); }
+inline floatx4 operator*(const floatx4& a, const floatx4& b) { return _mm_mul_ps(a.v, b.v); }
+inline floatx4 operator/(const floatx4& a, const floatx4& b) { return _mm_div_ps(a.v, b.v); }
+inline maskx4 operator<(const floatx4& a, const floatx4& b) { return _mm_cmplt_ps(a.v, b.v); }
+inline maskx4 operator<=(const floatx4& a, const floatx4& b) { return _mm_cmple_ps(a.v, b.v); }
+inline maskx4 operator>(const floatx4& a, const floatx4& b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline maskx4 operator>=(const floatx4& a, const floatx4& b) { return _mm_cmpge_ps(a.v, b.v); }
+inline maskx4 operator==(const floatx4& a, const floatx4& b) { return _mm_cmpeq_ps(a.v, b.v); }
+inline maskx4 operator!=(const floatx4& a, const floatx4& b) { return _mm_cmpneq_ps(a.v, b.v); }
+
+inline floatx4 select(const maskx4& m, const floatx4& a, const floatx4& b)
+{
+    return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v));
+}
+inline floatx4 min(const floatx4& a, const floatx4& b) { return _mm_min_ps(a.v, b.v); }
+inline floatx4 max(const floatx4& a, const floatx4& b) { return _mm_max_ps(a.v, b.v); }
+inline floatx4 abs(const floatx4& a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline floatx4 sqrt(const floatx4& a) { return _mm_sqrt_ps(a.v); }
+inline floatx4 floor(const floatx4& a)
+{
+#if defined(__SSE4_1__)
+    return _mm_floor_ps(a.v);
+#else
+    // Truncate and correct negative values; |a| >= 2^23 is already integral.
+    const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    const __m128 r = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+    return select(abs(a) < floatx4(8388608.0f), floatx4(r), a);
+#endif
+}
+inline floatx4 madd(const floatx4& a, const floatx4& b, const floatx4& c)
+{
+#if defined(__FMA__)
+    return _mm_fmadd_ps(a.v, b.v, c.v);
+#else
+    return _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v);
+#endif
+}
+inline floatx4 exp2i(const floatx4& n)
+{
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n.v), _mm_set1_epi32(127)), 23));
+}
+inline floatx4 frexp(const floatx4& x, floatx4& e)
+{
+    const __m128 exponent = _mm_castsi128_ps(_mm_set1_epi32(0x7f800000));
+    const __m128i i = _mm_srli_epi32(_mm_castps_si128(_mm_and_ps(x.v, exponent)), 23);
+    e = _mm_cvtepi32_ps(_mm_sub_epi32(i, _mm_set1_epi32(126)));
+    return _mm_or_ps(_mm_andnot_ps(exponent, x.v), _mm_set1_ps(0.5f));
+}
+inline floatx4 rsqrtEstimate(const floatx4& a) { return _mm_rsqrt_ps(a.v); }
+
+#else // GlslMathSimd
+
+class maskx4 {
+public:
+    bool v[4];
+    maskx4() = default;
+    maskx4(bool b) : v{b, b, b, b} { }
+    maskx4(bool a, bool b, bool c, bool d) : v{a, b, c, d} { }
+};
+
+inline maskx4 operator&(const maskx4& a, const maskx4& b) { return maskx4(a.v[0] && b.v[0], a.v[1] && b.v[1], a.v[2] && b.v[2], a.v[3] && b.v[3]); }
+inline maskx4 operator|(const maskx4& a, const maskx4& b) { return maskx4(a.v[0] || b.v[0], a.v[1] || b.v[1], a.v[2] || b.v[2], a.v[3] || b.v[3]); }
+inline maskx4 operator^(const maskx4& a, const maskx4& b) { return maskx4(a.v[0] != b.v[0], a.v[1] != b.v[1], a.v[2] != b.v[2], a.v[3] != b.v[3]); }
+inline maskx4 operator~(const maskx4& a) { return maskx4(!a.v[0], !a.v[1], !a.v[2], !a.v[3]); }
+inline int movemask(const maskx4& a) { return a.v[0] | (a.v[1] << 1) | (a.v[2] << 2) | (a.v[3] << 3); }
+
+class floatx4 {
+public:
+    static constexpr int size = 4;
+    float v[4];
+    floatx4() = default;
+    floatx4(float s) : v{s, s, s, s} { }
+    floatx4(float a, float b, float c, float d) : v{a, b, c, d} { }
+    static floatx4 load(const float* p) { return floatx4(p[0], p[1], p[2], p[3]); }
+    void store(float* p) const { p[0] = v[0]; p[1] = v[1]; p[2] = v[2]; p[3] = v[3]; }
+    float operator[](int i) const { return v[i]; }
+    floatx4& operator+=(const floatx4& a) { for (int i = 0; i < 4; ++i) v[i] += a.v[i]; return *this; }
+    floatx4& operator-=(const floatx4& a) { for (int i = 0; i < 4; ++i) v[i] -= a.v[i]; return *this; }
+    floatx4& operator*=(const floatx4& a) { for (int i = 0; i < 4; ++i) v[i] *= a.v[i]; return *this; }
+    floatx4& operator/=(const floatx4& a) { for (int i = 0; i < 4; ++i) v[i] /= a.v[i]; return *this; }
+};
+
+#define FLOATX4_UNARY(EXPR) \
+    floatx4(EXPR(a.v[0]), EXPR(a.v[1]), EXPR(a.v[2]), EXPR(a.v[3]))
+#define FLOATX4_BINARY(OP) \
+    floatx4(a.v[0] OP b.v[0], a.v[1] OP b.v[1], a.v[2] OP b.v[2], a.v[3] OP b.v[3])
+#define FLOATX4_COMPARE(OP) \
+    maskx4(a.v[0] OP b.v[0], a.v[1] OP b.v[1], a.v[2] OP b.v[2], a.v[3] OP b.v[3])
+
+inline floatx4 operator-(const floatx4& a) { return FLOATX4_UNARY(-); }
+inline floatx4 operator+(const floatx4& a, const floatx4& b) { return FLOATX4_BINARY(+); }
+inline floatx4 operator-(const floatx4& a, const floatx4& b) { return FLOATX4_BINARY(-); }
+inline floatx4 operator*(const floatx4& a, const floatx4& b) { return FLOATX4_BINARY(*); }
+inline floatx4 operator/(const floatx4& a, const floatx4& b) { return FLOATX4_BINARY(/); }
+inline maskx4 operator<(const floatx4& a, const floatx4& b) { return FLOATX4_COMPARE(<); }
+inline maskx4 operator<=(const floatx4& a, const floatx4& b) { return FLOATX4_COMPARE(<=); }
+inline maskx4 operator>(const floatx4& a, const floatx4& b) { return FLOATX4_COMPARE(>); }
+inline maskx4 operator>=(const floatx4& a, const floatx4& b) { return FLOATX4_COMPARE(>=); }
+inline maskx4 operator==(const floatx4& a, const floatx4& b) { return FLOATX4_COMPARE(==); }
+inline maskx4 operator!=(const floatx4& a, const floatx4& b) { return FLOATX4_COMPARE(!=); }
+
+inline floatx4 select(const maskx4& m, const floatx4& a, const floatx4& b)
+{
+    return floatx4(m.v[0] ? a.v[0] : b.v[0], m.v[1] ? a.v[1] : b.v[1],
+        m.v[2] ? a.v[2] : b.v[2], m.v[3] ? a.v[3] : b.v[3]);
+}
+inline floatx4 min(const floatx4& a, const floatx4& b) { return select(a < b, a, b); }
+inline floatx4 max(const floatx4& a, const floatx4& b) { return select(a > b, a, b); }
+inline floatx4 abs(const floatx4& a) { return FLOATX4_UNARY(std::fabs); }
+inline floatx4 sqrt(const floatx4& a) { return FLOATX4_UNARY(std::sqrt); }
+inline floatx4 floor(const floatx4& a) { return FLOATX4_UNARY(std::floor); }
+inline floatx4 madd(const floatx4& a, const floatx4& b, const floatx4& c) { return a * b + c; }
+inline floatx4 exp2i(const floatx4& a) { return FLOATX4_UNARY(exp2i); }
+inline floatx4 frexp(const floatx4& x, floatx4& e)
+{
+    return floatx4(frexp(x.v[0], e.v[0]), frexp(x.v[1], e.v[1]), frexp(x.v[2], e.v[2]), frexp(x.v[3], e.v[3]));
+}
+inline floatx4 rsqrtEstimate(const floatx4& a) { return FLOATX4_UNARY(rsqrtEstimate); }
+
+#undef FLOATX4_UNARY
+#undef FLOATX4_BINARY
+#undef FLOATX4_COMPARE
+
+#endif // GlslMathSimd
+
+#if GlslMathAvx
+
+class maskx8 {
+public:
+    __m256 v;
+    maskx8() = default;
+    maskx8(__m256 v) : v(v) { }
+    maskx8(bool b) : v(_mm256_castsi256_ps(_mm256_set1_epi32(b ? -1 : 0))) { }
+};
+
+inline maskx8 operator&(const maskx8& a, const maskx8& b) { return _mm256_and_ps(a.v, b.v); }
+inline maskx8 operator|(const maskx8& a, const maskx8& b) { return _mm256_or_ps(a.v, b.v); }
+inline maskx8 operator^(const maskx8& a, const maskx8& b) { return _mm256_xor_ps(a.v, b.v); }
+inline maskx8 operator~(const maskx8& a) { return _mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+inline int movemask(const maskx8& a) { return _mm256_movemask_ps(a.v); }
+
+class floatx8 {
+public:
+    static constexpr int size = 8;
+    __m256 v;
+    floatx8() = default;
+    floatx8(__m256 v) : v(v) { }
+    floatx8(float s) : v(_mm256_set1_ps(s)) { }
+    floatx8(const floatx4& lo, const floatx4& hi) : v(_mm256_insertf128_ps(_mm256_castps128_ps256(lo.v), hi.v, 1)) { }
+    static floatx8 load(const float* p) { return _mm256_loadu_ps(p); }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+    float operator[](int i) const { float t[8]; store(t); return t[i]; }
+    floatx8& operator+=(const floatx8& a) { v = _mm256_add_ps(v, a.v); return *this; }
+    floatx8& operator-=(const floatx8& a) { v = _mm256_sub_ps(v, a.v); return *this; }
+    floatx8& operator*=(const floatx8& a) { v = _mm256_mul_ps(v, a.v); return *this; }
+    floatx8& operator/=(const floatx8& a) { v = _mm256_div_ps(v, a.v); return *this; }
+};
+
+inline floatx8 operator-(const floatx8& a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline floatx8 operator+(const floatx8& a, const floatx8& b) { return _mm256_add_ps(a.v, b.v); }
+inline floatx8 operator-(const floatx8& a, const floatx8& b) { return _mm256_sub_ps(a.v, b.v); }
+inline floatx8 operator*(const floatx8& a, const floatx8& b) { return _mm256_mul_ps(a.v, b.v); }
+inline floatx8 operator/(const floatx8& a, const floatx8& b) { return _mm256_div_ps(a.v, b.v); }
+inline maskx8 operator<(const floatx8& a, const floatx8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline maskx8 operator<=(const floatx8& a, const floatx8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline maskx8 operator>(const floatx8& a, const floatx8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline maskx8 operator>=(const floatx8& a, const floatx8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline maskx8 operator==(const floatx8& a, const floatx8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+inline maskx8 operator!=(const floatx8& a, const floatx8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ); }
+
+inline floatx8 select(const maskx8& m, const floatx8& a, const floatx8& b) { return _mm256_blendv_ps(b.v, a.v, m.v); }
+inline floatx8 min(const floatx8& a, const floatx8& b) { return _mm256_min_ps(a.v, b.v); }
+inline floatx8 max(const floatx8& a, const floatx8& b) { return _mm256_max_ps(a.v, b.v); }
+inline floatx8 abs(const floatx8& a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline floatx8 sqrt(const floatx8& a) { return _mm256_sqrt_ps(a.v); }
+inline floatx8 floor(const floatx8& a) { return _mm256_floor_ps(a.v); }
+inline floatx8 madd(const floatx8& a, const floatx8& b, const floatx8& c)
+{
+#if defined(__FMA__)
+    return _mm256_fmadd_ps(a.v, b.v, c.v);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v);
+#endif
+}
+inline floatx8 exp2i(const floatx8& n)
+{
+#if defined(__AVX2__)
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127)), 23));
+#else
+    return floatx8(exp2i(floatx4(_mm256_castps256_ps128(n.v))), exp2i(floatx4(_mm256_extractf128_ps(n.v, 1))));
+#endif
+}
+inline floatx8 frexp(const floatx8& x, floatx8& e)
+{
+    const __m256 exponent = _mm256_castsi256_ps(_mm256_set1_epi32(0x7f800000));
+#if defined(__AVX2__)
+    const __m256i i = _mm256_srli_epi32(_mm256_castps_si256(_mm256_and_ps(x.v, exponent)), 23);
+    e = _mm256_cvtepi32_ps(_mm256_sub_epi32(i, _mm256_set1_epi32(126)));
+#else
+    floatx4 lo, hi;
+    frexp(floatx4(_mm256_castps256_ps128(x.v)), lo);
+    frexp(floatx4(_mm256_extractf128_ps(x.v, 1)), hi);
+    e = floatx8(lo, hi);
+#endif
+    return _mm256_or_ps(_mm256_andnot_ps(exponent, x.v), _mm256_set1_ps(0.5f));
+}
+inline floatx8 rsqrtEstimate(const floatx8& a) { return _mm256_rsqrt_ps(a.v); }
+
+#else // GlslMathAvx
+
+// Pair of 4-wide halves.
+class maskx8 {
+public:
+    maskx4 lo, hi;
+    maskx8() = default;
+    maskx8(const maskx4& lo, const maskx4& hi) : lo(lo), hi(hi) { }
+    maskx8(bool b) : lo(b), hi(b) { }
+};
+
+inline maskx8 operator&(const maskx8& a, const maskx8& b) { return maskx8(a.lo & b.lo, a.hi & b.hi); }
+inline maskx8 operator|(const maskx8& a, const maskx8& b) { return maskx8(a.lo | b.lo, a.hi | b.hi); }
+inline maskx8 operator^(const maskx8& a, const maskx8& b) { return maskx8(a.lo ^ b.lo, a.hi ^ b.hi); }
+inline maskx8 operator~(const maskx8& a) { return maskx8(~a.lo, ~a.hi); }
+inline int movemask(const maskx8& a) { return movemask(a.lo) | (movemask(a.hi) << 4); }
+
+class floatx8 {
+public:
+    static constexpr int size = 8;
+    floatx4 lo, hi;
+    floatx8() = default;
+    floatx8(float s) : lo(s), hi(s) { }
+    floatx8(const floatx4& lo, const floatx4& hi) : lo(lo), hi(hi) { }
+    static floatx8 load(const float* p) { return floatx8(floatx4::load(p), floatx4::load(p + 4)); }
+    void store(float* p) const { lo.store(p); hi.store(p + 4); }
+    float operator[](int i) const { return (i < 4) ? lo[i] : hi[i - 4]; }
+    floatx8& operator+=(const floatx8& a) { lo += a.lo; hi += a.hi; return *this; }
+    floatx8& operator-=(const floatx8& a) { lo -= a.lo; hi -= a.hi; return *this; }
+    floatx8& operator*=(const floatx8& a) { lo *= a.lo; hi *= a.hi; return *this; }
+    floatx8& operator/=(const floatx8& a) { lo /= a.lo; hi /= a.hi; return *this; }
+};
+
+inline floatx8 operator-(const floatx8& a) { return floatx8(-a.lo, -a.hi); }
+inline floatx8 operator+(const floatx8& a, const floatx8& b) { return floatx8(a.lo + b.lo, a.hi + b.hi); }
+inline floatx8 operator-(const floatx8& a, const floatx8& b) { return floatx8(a.lo - b.lo, a.hi - b.hi); }
+inline floatx8 operator*(const floatx8& a, const floatx8& b) { return floatx8(a.lo * b.lo, a.hi * b.hi); }
+inline floatx8 operator/(const floatx8& a, const floatx8& b) { return floatx8(a.lo / b.lo, a.hi / b.hi); }
+inline maskx8 operator<(const floatx8& a, const floatx8& b) { return maskx8(a.lo < b.lo, a.hi < b.hi); }
+inline maskx8 operator<=(const floatx8& a, const floatx8& b) { return maskx8(a.lo <= b.lo, a.hi <= b.hi); }
+inline maskx8 operator>(const floatx8& a, const floatx8& b) { return maskx8(a.lo > b.lo, a.hi > b.hi); }
+inline maskx8 operator>=(const floatx8& a, const floatx8& b) { return maskx8(a.lo >= b.lo, a.hi >= b.hi); }
+inline maskx8 operator==(const floatx8& a, const floatx8& b) { return maskx8(a.lo == b.lo, a.hi == b.hi); }
+inline maskx8 operator!=(const floatx8& a, const floatx8& b) { return maskx8(a.lo != b.lo, a.hi != b.hi); }
+
+inline floatx8 select(const maskx8& m, const floatx8& a, const floatx8& b)
+{
+    return floatx8(select(m.lo, a.lo, b.lo), select(m.hi, a.hi, b.hi));
+}
+inline floatx8 min(const floatx8& a, const floatx8& b) { return floatx8(min(a.lo, b.lo), min(a.hi, b.hi)); }
+inline floatx8 max(const floatx8& a, const floatx8& b) { return floatx8(max(a.lo, b.lo), max(a.hi, b.hi)); }
+inline floatx8 abs(const floatx8& a) { return floatx8(abs(a.lo), abs(a.hi)); }
+inline floatx8 sqrt(const floatx8& a) { return floatx8(sqrt(a.lo), sqrt(a.hi)); }
+inline floatx8 floor(const floatx8& a) { return floatx8(floor(a.lo), floor(a.hi)); }
+inline floatx8 madd(const floatx8& a, const floatx8& b, const floatx8& c)
+{
+    return floatx8(madd(a.lo, b.lo, c.lo), madd(a.hi, b.hi, c.hi));
+}
+inline floatx8 exp2i(const floatx8& n) { return floatx8(exp2i(n.lo), exp2i(n.hi)); }
+inline floatx8 frexp(const floatx8& x, floatx8& e) { return floatx8(frexp(x.lo, e.lo), frexp(x.hi, e.hi)); }
+inline floatx8 rsqrtEstimate(const floatx8& a) { return floatx8(rsqrtEstimate(a.lo), rsqrtEstimate(a.hi)); }
+
+#endif // GlslMathAvx
+
+inline bool any(const maskx4& m) { return movemask(m) != 0; }
+inline bool all(const maskx4& m) { return movemask(m) == 0xf; }
+inline bool any(const maskx8& m) { return movemask(m) != 0; }
+inline bool all(const maskx8& m) { return movemask(m) == 0xff; }
+
+// Lane-wise versions of the scalar helpers at the top of glslMath.h.
+#define GLSL_MATH_PACKET_FUNCTIONS(P) \
+    inline P fabs(const P& a) { return abs(a); } \
+    inline P fract(const P& a) { return a - floor(a); } \
+    inline P sign(const P& a) \
+    { \
+        return select(a > P(0.0f), P(1.0f), select(a < P(0.0f), P(-1.0f), P(0.0f))); \
+    } \
+    inline P smoothmin(const P& a, const P& b, const P& r) \
+    { \
+        const P f = max(P(0.0f), P(1.0f) - abs(b - a) / r); \
+        return min(a, b) - r*P(.25f)*f*f; \
+    } \
+    inline P smoothabs(const P& a, const P& r) \
+    { \
+        const P f = max(P(0.0f), P(1.0f) - abs(a + a) / r); \
+        return abs(a) + r*P(.25f)*f*f; \
+    }
+
+GLSL_MATH_PACKET_FUNCTIONS(floatx4)
+GLSL_MATH_PACKET_FUNCTIONS(floatx8)
+
+#undef GLSL_MATH_PACKET_FUNCTIONS
+
+using vec2x4 = tvec2<floatx4>;
+using vec3x4 = tvec3<floatx4>;
+using vec4x4 = tvec4<floatx4>;
+using vec2x8 = tvec2<floatx8>;
+using vec3x8 = tvec3<floatx8>;
+using vec4x8 = tvec4<floatx8>;
+
+// The generic normalize() branches on a zero length; these select instead.
+#define GLSL_MATH_PACKET_NORMALIZE(V, P) \
+    inline V normalize(const V& a) \
+    { \
+        const P d = length(a); \
+        return a * select(d == P(0.0f), P(0.0f), P(1.0f) / d); \
+    }
+
+GLSL_MATH_PACKET_NORMALIZE(vec2x4, floatx4)
+GLSL_MATH_PACKET_NORMALIZE(vec3x4, floatx4)
+GLSL_MATH_PACKET_NORMALIZE(vec4x4, floatx4)
+GLSL_MATH_PACKET_NORMALIZE(vec2x8, floatx8)
+GLSL_MATH_PACKET_NORMALIZE(vec3x8, floatx8)
+GLSL_MATH_PACKET_NORMALIZE(vec4x8, floatx8)
+
+#undef GLSL_MATH_PACKET_NORMALIZE
+
+// Gather/scatter between interleaved vertex arrays and packets.
+// data points at the first component of the attribute in the first vertex,
+// stride is the vertex size in floats (see GLMesh::Format), and only the
+// first count lanes are read/written (missing lanes are loaded as zero).
+
+template <typename P, int N>
+inline bool gatherStrided(P (&)[N], const float*, size_t) { return false; }
+
+#if GlslMathAvx && defined(__AVX2__)
+template <int N>
+inline bool gatherStrided(floatx8 (&out)[N], const float* data, size_t stride)
+{
+    if (stride > 0x7fffffff / 8)
+        return false;
+    const __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+        _mm256_set1_epi32(static_cast<int>(stride)));
+    for (int c = 0; c < N; ++c)
+        out[c] = _mm256_i32gather_ps(data + c, idx, 4);
+    return true;
+}
+#endif
+
+template <typename P, int N>
+inline void gatherLanes(P (&out)[N], const float* data, size_t stride, size_t count)
+{
+    constexpr int L = P::size;
+    if (count >= static_cast<size_t>(L) && gatherStrided(out, data, stride))
+        return;
+    float lanes[N][L];
+    for (int k = 0; k < L; ++k, data += stride)
+        for (int c = 0; c < N; ++c)
+            lanes[c][k] = (static_cast<size_t>(k) < count) ? data[c] : 0.0f;
+    for (int c = 0; c < N; ++c)
+        out[c] = P::load(lanes[c]);
+}
+
+template <typename P, int N>
+inline void scatterLanes(const P (&in)[N], float* data, size_t stride, size_t count)
+{
+    constexpr int L = P::size;
+    float lanes[N][L];
+    for (int c = 0; c < N; ++c)
+        in[c].store(lanes[c]);
+    for (size_t k = 0; k < count && k < static_cast<size_t>(L); ++k, data += stride)
+        for (int c = 0; c < N; ++c)
+            data[c] = lanes[c][k];
+}
+
+template <typename P>
+void gather(tvec2<P>& v, const float* data, size_t stride, size_t count = P::size)
+{
+    P c[2];
+    gatherLanes(c, data, stride, count);
+    v = tvec2<P>(c[0], c[1]);
+}
+
+template <typename P>
+void gather(tvec3<P>& v, const float* data, size_t stride, size_t count = P::size)
+{
+    P c[3];
+    gatherLanes(c, data, stride, count);
+    v = tvec3<P>(c[0], c[1], c[2]);
+}
+
+template <typename P>
+void gather(tvec4<P>& v, const float* data, size_t stride, size_t count = P::size)
+{
+    P c[4];
+    gatherLanes(c, data, stride, count);
+    v = tvec4<P>(c[0], c[1], c[2], c[3]);
+}
+
+template <typename P>
+void scatter(const tvec2<P>& v, float* data, size_t stride, size_t count = P::size)
+{
+    const P c[2] = { v.x, v.y };
+    scatterLanes(c, data, stride, count);
+}
+
+template <typename P>
+void scatter(const tvec3<P>& v, float* data, size_t stride, size_t count = P::size)
+{
+    const P c[3] = { v.x, v.y, v.z };
+    scatterLanes(c, data, stride, count);
+}
+
+template <typename P>
+void scatter(const tvec4<P>& v, float* data, size_t stride, size_t count = P::size)
+{
+    const P c[4] = { v.x, v.y, v.z, v.w };
+    scatterLanes(c, data, stride, count);
+}
+
+} // namespace glsl_math
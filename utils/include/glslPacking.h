@@ -0,0 +1,176 @@
+// GLSL-like math library - packed vertex attribute formats
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <glslMath.h>
+
+#include <cstring>
+
+// Conversions between float and the compact vertex attribute formats of
+// OpenGL, with the GL 4.2 rules for normalized integers:
+//
+//   half      GL_HALF_FLOAT, round to nearest even, overflow to inf
+//   snorm8    GL_BYTE, normalized:  c = round(clamp(f, -1, 1) * 127)
+//   snorm16   GL_SHORT, normalized: c = round(clamp(f, -1, 1) * 32767)
+//   unorm8    GL_UNSIGNED_BYTE, normalized: c = round(clamp(f, 0, 1) * 255),
+//             4x8 packs x into the lowest byte (first in memory)
+//   2_10_10_10  GL_INT_2_10_10_10_REV, normalized: x in bits 0-9,
+//             y in 10-19, z in 20-29 (snorm10), w in 30-31 (-1, 0 or 1)
+//   octahedral  unit normal as 2 snorm16, decoded in the vertex shader:
+//             vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+//             if (n.z < 0) n.xy = (1 - abs(n.yx)) * sign(n.xy);
+//             n = normalize(n);
+//
+// The scalar functions below define the results; the array versions at
+// the end produce the same bits with SSE2 (F16C for half when available),
+// NaN payloads of halves included (quieted, top bits kept as F16C does).
+
+namespace glsl_math
+{
+
+inline uint16_t packHalf(float f)
+{
+    // F. Giesen's float -> half with round to nearest even
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    const uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+    uint32_t h;
+    if (u >= (143u << 23)) // overflow, inf or NaN (quiet, top payload bits kept as F16C does)
+        h = (u > (255u << 23)) ? (0x7e00 | ((u >> 13) & 0x3ff)) : 0x7c00;
+    else if (u < (113u << 23)) // subnormal or zero: let the FPU round
+    {
+        float g;
+        memcpy(&g, &u, sizeof(g));
+        g += 0.5f;
+        memcpy(&h, &g, sizeof(h));
+        h -= 126u << 23;
+    }
+    else // rebias the exponent, round to nearest even
+        h = (u + ((15u - 127u) << 23) + 0xfff + ((u >> 13) & 1)) >> 13;
+    return static_cast<uint16_t>(h | (sign >> 16));
+}
+
+inline float unpackHalf(uint16_t h)
+{
+    uint32_t u = (h & 0x7fffu) << 13;
+    const uint32_t e = u & (0x7c00u << 13);
+    u += (127u - 15u) << 23;
+    float f;
+    if (e == (0x7c00u << 13)) // inf or NaN (quieted as F16C does)
+        u = (u + ((128u - 16u) << 23)) | ((u & 0x7fffffu) ? 0x400000u : 0);
+    else if (e == 0) // subnormal or zero: renormalize
+    {
+        u += 1u << 23;
+        memcpy(&f, &u, sizeof(f));
+        f -= 6.10351563e-05f;
+        memcpy(&u, &f, sizeof(u));
+    }
+    u |= static_cast<uint32_t>(h & 0x8000u) << 16;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// Rounds to nearest even (GL leaves ties to the implementation), which is
+// also what _mm_cvtps_epi32 does in the array versions.
+inline int32_t packSnorm(float f, float scale)
+{
+    const float c = min(max(f, -1.0f), 1.0f) * scale;
+    return static_cast<int32_t>(std::nearbyint(c));
+}
+
+inline int8_t packSnorm8(float f) { return static_cast<int8_t>(packSnorm(f, 127.0f)); }
+inline int16_t packSnorm16(float f) { return static_cast<int16_t>(packSnorm(f, 32767.0f)); }
+inline float unpackSnorm8(int8_t c) { return max(c * (1.0f / 127.0f), -1.0f); }
+inline float unpackSnorm16(int16_t c) { return max(c * (1.0f / 32767.0f), -1.0f); }
+
+inline uint8_t packUnorm8(float f)
+{
+    return static_cast<uint8_t>(std::nearbyint(min(max(f, 0.0f), 1.0f) * 255.0f));
+}
+
+inline float unpackUnorm8(uint8_t c) { return c * (1.0f / 255.0f); }
+
+inline uint32_t packUnorm4x8(const vec4f& v)
+{
+    return packUnorm8(v.x) | (packUnorm8(v.y) << 8) | (packUnorm8(v.z) << 16)
+        | (static_cast<uint32_t>(packUnorm8(v.w)) << 24);
+}
+
+inline vec4f unpackUnorm4x8(uint32_t p)
+{
+    return vec4f(unpackUnorm8(p & 0xff), unpackUnorm8((p >> 8) & 0xff), unpackUnorm8((p >> 16) & 0xff),
+        unpackUnorm8(p >> 24));
+}
+
+inline uint32_t packInt2101010Rev(const vec4f& v)
+{
+    return (static_cast<uint32_t>(packSnorm(v.x, 511.0f)) & 0x3ff)
+        | ((static_cast<uint32_t>(packSnorm(v.y, 511.0f)) & 0x3ff) << 10)
+        | ((static_cast<uint32_t>(packSnorm(v.z, 511.0f)) & 0x3ff) << 20)
+        | (static_cast<uint32_t>(packSnorm(v.w, 1.0f)) << 30);
+}
+
+inline vec4f unpackInt2101010Rev(uint32_t p)
+{
+    // shift each field to the top and back to sign extend it
+    const int32_t x = static_cast<int32_t>(p << 22) >> 22;
+    const int32_t y = static_cast<int32_t>(p << 12) >> 22;
+    const int32_t z = static_cast<int32_t>(p << 2) >> 22;
+    const int32_t w = static_cast<int32_t>(p) >> 30;
+    return vec4f(max(x * (1.0f / 511.0f), -1.0f), max(y * (1.0f / 511.0f), -1.0f),
+        max(z * (1.0f / 511.0f), -1.0f), max(static_cast<float>(w), -1.0f));
+}
+
+// Unit normal to the [-1, 1]^2 octahedral square (not normalized input
+// is fine, zero maps to the +z pole).
+inline vec2f octEncode(const vec3f& n)
+{
+    const float d = fabs(n.x) + fabs(n.y) + fabs(n.z);
+    const float s = (d > 0) ? 1.0f / d : 0.0f;
+    const float x = n.x * s, y = n.y * s;
+    if (n.z >= 0)
+        return vec2f(x, y);
+    return vec2f((1 - fabs(y)) * ((x >= 0) ? 1.0f : -1.0f), (1 - fabs(x)) * ((y >= 0) ? 1.0f : -1.0f));
+}
+
+inline vec3f octDecode(const vec2f& e)
+{
+    vec3f n(e.x, e.y, 1 - fabs(e.x) - fabs(e.y));
+    if (n.z < 0)
+        n = vec3f((1 - fabs(e.y)) * ((e.x >= 0) ? 1.0f : -1.0f), (1 - fabs(e.x)) * ((e.y >= 0) ? 1.0f : -1.0f), n.z);
+    return normalize(n);
+}
+
+// Array versions; src and dst are tightly packed unless a stride (in
+// floats, see GLMesh::Format) is given for the float side.
+void packHalf(const float* src, uint16_t* dst, size_t count);
+void unpackHalf(const uint16_t* src, float* dst, size_t count);
+void packSnorm8(const float* src, int8_t* dst, size_t count);
+void unpackSnorm8(const int8_t* src, float* dst, size_t count);
+void packSnorm16(const float* src, int16_t* dst, size_t count);
+void unpackSnorm16(const int16_t* src, float* dst, size_t count);
+
+// components = 3 packs w = 1 and unpacks only xyz.
+void packInt2101010Rev(const float* src, size_t stride, size_t components, uint32_t* dst, size_t count);
+void unpackInt2101010Rev(const uint32_t* src, float* dst, size_t stride, size_t components, size_t count);
+
+// Normals (xyz at src + i * stride) to 2 snorm16 each, and back.
+void packOctahedral(const float* src, size_t stride, int16_t* dst, size_t count);
+void unpackOctahedral(const int16_t* src, float* dst, size_t stride, size_t count);
+
+} // namespace glsl_math
@@ -0,0 +1,292 @@
+// GLSL-like math library - quaternions and dual quaternions
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <glslMath.h>
+
+// Rotations as unit quaternions (x, y, z, w) = (axis * sin(angle/2), cos(angle/2))
+// and rigid transforms as dual quaternions. Unlike slerp() of tmat3 they
+// interpolate with a few multiply-adds and are renormalized in one step,
+// so animation does not drift away from a rotation:
+//
+//   const quat a = toQuat(mat3(view)), b = quatRotation(90.0, 0.0, 1.0, 0.0);
+//   view = toMat4(slerp(a, b, 0.25));
+//
+// Batch slerp/nlerp over arrays of quatf/dualquatf are declared at the end.
+
+namespace glsl_math
+{
+
+template <typename T>
+class tquat {
+public:
+    using value_type = T;
+    T x, y, z, w;
+    tquat<T>() = default;
+    tquat<T>(const tquat<T>& q) = default;
+    constexpr tquat<T>(T x, T y, T z, T w) : x(x), y(y), z(z), w(w) { }
+    constexpr tquat<T>(const tvec3<T>& v, T w) : x(v.x), y(v.y), z(v.z), w(w) { }
+    // Only for normalize(); a quaternion with all components set to v.
+    explicit constexpr tquat<T>(T v) : x(v), y(v), z(v), w(v) { }
+    constexpr tquat<T>& operator+=(const tquat<T>& a) { x += a.x; y += a.y; z += a.z; w += a.w; return *this; }
+    constexpr tquat<T>& operator-=(const tquat<T>& a) { x -= a.x; y -= a.y; z -= a.z; w -= a.w; return *this; }
+    constexpr tquat<T>& operator*=(T a) { x *= a; y *= a; z *= a; w *= a; return *this; }
+    constexpr tquat<T>& operator*=(const tquat<T>& a);
+
+    constexpr tvec3<T> xyz() const { return tvec3<T>(x, y, z); }
+
+    template <typename TT>
+    constexpr tquat(const tquat<TT>& q) : x(static_cast<T>(q.x)), y(static_cast<T>(q.y)), z(static_cast<T>(q.z)), w(static_cast<T>(q.w)) { }
+};
+
+static_assert(sizeof(tquat<float>) == 4 * 4, "invalid tquat<T> alignment");
+
+template <typename T>
+constexpr tquat<T> operator-(const tquat<T>& a) { return tquat<T>(-a.x, -a.y, -a.z, -a.w); }
+template <typename T>
+constexpr tquat<T> operator+(const tquat<T>& a, const tquat<T>& b) { return tquat<T>(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+template <typename T>
+constexpr tquat<T> operator-(const tquat<T>& a, const tquat<T>& b) { return tquat<T>(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); }
+template <typename T>
+constexpr tquat<T> operator*(const tquat<T>& a, T b) { return tquat<T>(a.x * b, a.y * b, a.z * b, a.w * b); }
+template <typename T>
+constexpr tquat<T> operator*(T b, const tquat<T>& a) { return tquat<T>(a.x * b, a.y * b, a.z * b, a.w * b); }
+template <typename T>
+constexpr bool operator==(const tquat<T>& a, const tquat<T>& b) { return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w; }
+template <typename T>
+constexpr bool operator!=(const tquat<T>& a, const tquat<T>& b) { return a.x != b.x || a.y != b.y || a.z != b.z || a.w != b.w; }
+
+// Hamilton product: a * b rotates by b first, then by a (like matrices).
+template <typename T>
+constexpr tquat<T> operator*(const tquat<T>& a, const tquat<T>& b)
+{
+    return tquat<T>(
+        a.w*b.x + a.x*b.w + a.y*b.z - a.z*b.y,
+        a.w*b.y - a.x*b.z + a.y*b.w + a.z*b.x,
+        a.w*b.z + a.x*b.y - a.y*b.x + a.z*b.w,
+        a.w*b.w - a.x*b.x - a.y*b.y - a.z*b.z);
+}
+
+template <typename T>
+constexpr tquat<T>& tquat<T>::operator*=(const tquat<T>& a)
+{
+    return *this = *this * a;
+}
+
+template <typename T>
+constexpr T dot(const tquat<T>& a, const tquat<T>& b) { return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w; }
+
+template <typename T>
+constexpr tquat<T> conjugate(const tquat<T>& q) { return tquat<T>(-q.x, -q.y, -q.z, q.w); }
+
+template <typename T>
+tquat<T> inverse(const tquat<T>& q) { return conjugate(q) * (static_cast<T>(1) / dot(q, q)); }
+
+// Rotates v by unit quaternion q, same as toMat3(q) * v.
+template <typename T>
+constexpr tvec3<T> operator*(const tquat<T>& q, const tvec3<T>& v)
+{
+    const tvec3<T> u = q.xyz();
+    const tvec3<T> t = static_cast<T>(2) * cross(u, v);
+    return v + q.w * t + cross(u, t);
+}
+
+// Same rotation as rotation(angle, ax, ay, az); angle in degrees.
+template <typename T>
+tquat<T> quatRotation(T angle, T ax, T ay, T az)
+{
+    const T ad = sqrt(ax*ax + ay*ay + az*az);
+    if (!(ad > 0))
+        return tquat<T>(0, 0, 0, 1);
+    angle *= M_PI / 360.0;
+    const T s = std::sin(angle) / ad;
+    return tquat<T>(ax * s, ay * s, az * s, std::cos(angle));
+}
+
+template <typename T>
+constexpr tmat3<T> toMat3(const tquat<T>& q)
+{
+    const T x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+    const T xx = q.x * x2, yy = q.y * y2, zz = q.z * z2;
+    const T xy = q.x * y2, xz = q.x * z2, yz = q.y * z2;
+    const T wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+    return tmat3<T>(
+        1 - yy - zz, xy + wz, xz - wy,
+        xy - wz, 1 - xx - zz, yz + wx,
+        xz + wy, yz - wx, 1 - xx - yy);
+}
+
+template <typename T>
+constexpr tmat4<T> toMat4(const tquat<T>& q)
+{
+    return tmat4<T>(toMat3(q));
+}
+
+// Rotation part of orthonormal m (Shepperd's method, picks the largest
+// diagonal term to stay accurate near 180 degrees).
+template <typename T>
+tquat<T> toQuat(const tmat3<T>& m)
+{
+    const T trace = m[0].x + m[1].y + m[2].z;
+    if (trace > 0)
+    {
+        const T s = sqrt(trace + 1) * 2;
+        return tquat<T>((m[1].z - m[2].y) / s, (m[2].x - m[0].z) / s, (m[0].y - m[1].x) / s, s / 4);
+    }
+    if (m[0].x > m[1].y && m[0].x > m[2].z)
+    {
+        const T s = sqrt(1 + m[0].x - m[1].y - m[2].z) * 2;
+        return tquat<T>(s / 4, (m[1].x + m[0].y) / s, (m[2].x + m[0].z) / s, (m[1].z - m[2].y) / s);
+    }
+    if (m[1].y > m[2].z)
+    {
+        const T s = sqrt(1 + m[1].y - m[0].x - m[2].z) * 2;
+        return tquat<T>((m[1].x + m[0].y) / s, s / 4, (m[2].y + m[1].z) / s, (m[2].x - m[0].z) / s);
+    }
+    const T s = sqrt(1 + m[2].z - m[0].x - m[1].y) * 2;
+    return tquat<T>((m[2].x + m[0].z) / s, (m[2].y + m[1].z) / s, s / 4, (m[0].y - m[1].x) / s);
+}
+
+template <typename T>
+tquat<T> toQuat(const tmat4<T>& m)
+{
+    return toQuat(tmat3<T>(m));
+}
+
+// Normalized linear interpolation along the shorter arc; cheap and
+// good enough for t steps up to ~30 degrees.
+template <typename T>
+tquat<T> nlerp(const tquat<T>& a, const tquat<T>& b, T t)
+{
+    const T tb = (dot(a, b) < 0) ? -t : t;
+    return normalize(a * (1 - t) + b * tb);
+}
+
+// Constant angular velocity interpolation along the shorter arc.
+template <typename T>
+tquat<T> slerp(const tquat<T>& a, const tquat<T>& b, T t)
+{
+    T c = dot(a, b);
+    const T sb = (c < 0) ? -1 : 1;
+    c = min(c * sb, static_cast<T>(1));
+    const T theta = std::acos(c);
+    const T s = std::sin(theta);
+    if (s < static_cast<T>(1e-4))
+        return nlerp(a, b, t);
+    return normalize(a * (std::sin((1 - t) * theta) / s) + b * (sb * std::sin(t * theta) / s));
+}
+
+// Rigid transform: real is the rotation, dual = 0.5 * translation * real.
+template <typename T>
+class tdualquat {
+public:
+    using value_type = T;
+    tquat<T> real, dual;
+    tdualquat<T>() = default;
+    tdualquat<T>(const tdualquat<T>& q) = default;
+    constexpr tdualquat<T>(const tquat<T>& real, const tquat<T>& dual) : real(real), dual(dual) { }
+    constexpr tdualquat<T>(const tquat<T>& rotation, const tvec3<T>& translation)
+        : real(rotation), dual(tquat<T>(translation * static_cast<T>(0.5), 0) * rotation) { }
+
+    template <typename TT>
+    constexpr tdualquat(const tdualquat<TT>& q) : real(q.real), dual(q.dual) { }
+};
+
+static_assert(sizeof(tdualquat<float>) == 8 * 4, "invalid tdualquat<T> alignment");
+
+template <typename T>
+constexpr tdualquat<T> operator+(const tdualquat<T>& a, const tdualquat<T>& b) { return tdualquat<T>(a.real + b.real, a.dual + b.dual); }
+template <typename T>
+constexpr tdualquat<T> operator*(const tdualquat<T>& a, T b) { return tdualquat<T>(a.real * b, a.dual * b); }
+template <typename T>
+constexpr tdualquat<T> operator*(T b, const tdualquat<T>& a) { return tdualquat<T>(a.real * b, a.dual * b); }
+
+// Composition: a * b applies b first, then a.
+template <typename T>
+constexpr tdualquat<T> operator*(const tdualquat<T>& a, const tdualquat<T>& b)
+{
+    return tdualquat<T>(a.real * b.real, a.real * b.dual + a.dual * b.real);
+}
+
+// Inverse of a unit dual quaternion.
+template <typename T>
+constexpr tdualquat<T> conjugate(const tdualquat<T>& q) { return tdualquat<T>(conjugate(q.real), conjugate(q.dual)); }
+
+// Unit real part with the dual part made orthogonal to it.
+template <typename T>
+tdualquat<T> normalize(const tdualquat<T>& q)
+{
+    const T d = sqrt(dot(q.real, q.real));
+    if (d == 0)
+        return tdualquat<T>(tquat<T>(0, 0, 0, 1), tquat<T>(0));
+    const tquat<T> real = q.real * (1 / d);
+    const tquat<T> dual = q.dual * (1 / d);
+    return tdualquat<T>(real, dual - real * dot(real, dual));
+}
+
+template <typename T>
+constexpr tvec3<T> getTranslation(const tdualquat<T>& q)
+{
+    return static_cast<T>(2) * (q.dual * conjugate(q.real)).xyz();
+}
+
+template <typename T>
+constexpr tvec3<T> transformPoint(const tdualquat<T>& q, const tvec3<T>& p)
+{
+    return q.real * p + getTranslation(q);
+}
+
+template <typename T>
+constexpr tmat4<T> toMat4(const tdualquat<T>& q)
+{
+    const tmat3<T> r = toMat3(q.real);
+    return tmat4<T>(tvec4<T>(r[0], 0), tvec4<T>(r[1], 0), tvec4<T>(r[2], 0), tvec4<T>(getTranslation(q), 1));
+}
+
+// m must be a rotation followed by a translation (no scale).
+template <typename T>
+tdualquat<T> toDualQuat(const tmat4<T>& m)
+{
+    return tdualquat<T>(toQuat(tmat3<T>(m)), tvec3<T>(m[3]));
+}
+
+// Dual quaternion linear blending (shorter arc); the cheap counterpart of
+// screw interpolation, exact for pure rotations or pure translations.
+template <typename T>
+tdualquat<T> nlerp(const tdualquat<T>& a, const tdualquat<T>& b, T t)
+{
+    const T tb = (dot(a.real, b.real) < 0) ? -t : t;
+    return normalize(a * (1 - t) + b * tb);
+}
+
+using quat = tquat<double>;
+using quatf = tquat<float>;
+using dualquat = tdualquat<double>;
+using dualquatf = tdualquat<float>;
+
+// Batch interpolation: out[i] = slerp(a[i], b[i], t or t[i]) and so on.
+// Inputs must be normalized; out may alias a or b. Computed 8 at a time
+// with fast::acos/fast::sin (Medium), so results differ from the scalar
+// versions by ~1e-6. Large arrays are split across ThreadPool::global().
+void slerp(const quatf* a, const quatf* b, float t, quatf* out, size_t count);
+void slerp(const quatf* a, const quatf* b, const float* t, quatf* out, size_t count);
+void nlerp(const quatf* a, const quatf* b, float t, quatf* out, size_t count);
+void nlerp(const quatf* a, const quatf* b, const float* t, quatf* out, size_t count);
+void nlerp(const dualquatf* a, const dualquatf* b, float t, dualquatf* out, size_t count);
+void nlerp(const dualquatf* a, const dualquatf* b, const float* t, dualquatf* out, size_t count);
+
+} // namespace glsl_math
@@ -0,0 +1,120 @@
+// Triangle mesh optimization
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <glslMath.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Welding and reordering passes for indexed triangle lists, independent of
+// GL so they run on any index/vertex arrays before upload. The usual order is
+//
+//   vertexCount = weldVertices(vertices, stride, indices, indexCount, vertexCount, epsilons);
+//   optimizeVertexCache(indices, indices, indexCount, vertexCount);
+//   optimizeOverdraw(indices, indexCount, positions, stride, vertexCount);
+//   optimizeVertexFetch(vertices, indices, indexCount, vertexCount, vertexSize);
+//
+// Positions are 3 floats at the start of each vertex of stride floats, as
+// in glslMathBatch.
+
+// Merges vertices of stride floats whose components all fall into the
+// same cells of size epsilons[c] (one per component, 0 compares the bits),
+// keeping the first of each group, compacts vertices and rewrites indices.
+// Vertices closer than epsilon can still land in neighbouring cells, so
+// pick epsilons well above the noise. Expected linear time (hash table).
+// Returns the number of vertices kept.
+size_t weldVertices(float* vertices, size_t stride, uint32_t* indices, size_t indexCount, size_t vertexCount,
+    const float* epsilons);
+
+// Average cache miss ratio: vertices transformed per triangle with a FIFO
+// post-transform cache of cacheSize entries. 3 is the worst case, large
+// regular grids approach 0.5.
+float vertexCacheAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    unsigned cacheSize = 16);
+
+// Reorders triangles for the post-transform vertex cache with Tipsify
+// (Sander, Nehab, Barczak 2007): fans around the cached vertex of most
+// remaining triangles, jumping back to recent vertices at dead ends.
+// Linear time. dst may equal src.
+void optimizeVertexCache(uint32_t* dst, const uint32_t* src, size_t indexCount, size_t vertexCount,
+    unsigned cacheSize = 16);
+
+// Reorders clusters of cache-optimized triangles to reduce overdraw, as in
+// the paper above: the order is split where the cache is cold and again
+// where a cluster ACMR stays within threshold times the mesh ACMR, then
+// clusters facing out of the mesh centroid are drawn first, which is
+// roughly front to back from any view. Cache efficiency drops by about
+// threshold at most.
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t stride,
+    size_t vertexCount, float threshold = 1.05f, unsigned cacheSize = 16);
+
+// Renumbers vertices in order of first use and moves them accordingly, so
+// the vertex fetch walks memory forward. vertices holds vertexCount
+// vertices of vertexSize bytes. Unreferenced vertices are dropped; returns
+// the number of vertices kept.
+size_t optimizeVertexFetch(void* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount,
+    size_t vertexSize);
+
+// Cluster of up to a few dozen to a hundred triangles, contiguous in the
+// index array, with the data to reject it before rasterization. The layout
+// matches a std430 struct of vec4 sphere, vec4 cone and 4 uints, so an
+// array of them can be read by a culling compute pass as is.
+struct Meshlet
+{
+    // Bounding sphere (center.xyz, radius), as in cullSpheres.
+    glsl_math::vec4f sphere;
+    // Normal cone (axis.xyz, cutoff): triangle normals are within the angle
+    // asin(cutoff) of axis. Cutoff 1 when they spread over 90 degrees.
+    glsl_math::vec4f cone;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    uint32_t padding;
+};
+
+// Reorders the triangles into meshlets of at most maxTriangles triangles
+// and maxVertices distinct vertices, each grown greedily from a seed
+// adjacent to the previous one by the triangle adding the fewest new
+// vertices, then nearest to the meshlet centroid, so meshlets are compact
+// and their normal cones narrow. Replaces the contents of meshlets.
+void buildMeshlets(uint32_t* indices, size_t indexCount, const float* positions, size_t stride,
+    size_t vertexCount, std::vector<Meshlet>& meshlets, size_t maxTriangles = 124, size_t maxVertices = 64);
+
+// True when all triangles of m (counter-clockwise front faces) face away
+// from eye, both in the coordinates of the positions. Conservative: the
+// sphere stands in for the triangle positions.
+inline bool isBackFacing(const Meshlet& m, const glsl_math::vec3f& eye)
+{
+    const glsl_math::vec3f d = glsl_math::vec3f(m.sphere) - eye;
+    return dot(d, glsl_math::vec3f(m.cone)) >= m.cone.w * length(d) + m.sphere.w * (1 + m.cone.w);
+}
+
+// Simplifies a triangle list by edge collapses in order of quadric error
+// (Garland, Heckbert 1997). A collapse moves a vertex onto a neighbour, so
+// the result indexes the same vertices and levels of detail can share one
+// vertex buffer. Stops at targetIndexCount indices and takes no collapse
+// leaving a vertex more than targetError (in position units) off the planes
+// of the original triangles and border edges it stands for. Border
+// vertices only slide along the border and vertices sharing their position
+// with another one (attribute seams) stay, so the outline is kept and no
+// cracks open. Writes the indices to dst (may equal indices) and returns
+// their count, the largest such distance goes to resultError when not null.
+size_t simplify(uint32_t* dst, const uint32_t* indices, size_t indexCount, const float* positions, size_t stride,
+    size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError = nullptr);
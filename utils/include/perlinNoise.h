@@ -17,6 +17,64 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
+// Perlin noise field with its own permutation of 0..255 (shuffled from
+// seed), so independent fields can be sampled side by side. The table is
+// stored twice over in bytes, 516 bytes per instance, and stays in L1 even
+// with many fields in use at once.
+class PerlinNoise
+{
+public:
+    explicit PerlinNoise(uint32_t seed = 1);
+
+    float noise1d(float fx) const;
+    float noise2d(float fx, float fy) const;
+    float noise3d(float fx, float fy, float fz) const;
+
+    // Same values, with the analytic gradient (d/dx, d/dy[, d/dz]) in grad.
+    float noise2d(float fx, float fy, float grad[2]) const;
+    float noise3d(float fx, float fy, float fz, float grad[3]) const;
+
+    // Same as the free batch and grid functions below.
+    void noise2dBatch(const float* x, const float* y, float* out, size_t count) const;
+    void noise3dBatch(const float* x, const float* y, const float* z, float* out, size_t count) const;
+    void noise2dGrid(float x0, float y0, float dx, float dy, size_t width, size_t height, float* out) const;
+    void noise3dGrid(float x0, float y0, float z0, float dx, float dy, float dz,
+        size_t width, size_t height, size_t depth, float* out) const;
+
+    // Field used by the free functions (seed 1).
+    static const PerlinNoise& global();
+
+    // The table for uploading to shaders (perlinNoise.glsl), permutationSize bytes.
+    static constexpr size_t permutationSize = 512 + 4;
+    const uint8_t* permutation() const { return perm; }
+
+private:
+    // perm[i] = perm[i + 256], so perm[perm[x] + y + 1] needs no wrapping;
+    // the last 4 bytes are padding for the 32-bit AVX2 gathers.
+    uint8_t perm[permutationSize];
+};
+
+// Free functions sampling PerlinNoise::global().
 float noise1d(float fx);
 float noise2d(float fx, float fy);
 float noise3d(float fx, float fy, float fz);
+
+// Batch versions, 8 points at a time with AVX2 gathers (one by one on other
+// targets). Results are bit-identical to the functions above as long as
+// the compiler does not contract them into FMA (-ffp-contract=fast),
+// otherwise they differ by less than 1e-6.
+
+// out[i] = noise2d(x[i], y[i])
+void noise2dBatch(const float* x, const float* y, float* out, size_t count);
+// out[i] = noise3d(x[i], y[i], z[i])
+void noise3dBatch(const float* x, const float* y, const float* z, float* out, size_t count);
+
+// Regular grids, x varying fastest:
+// out[j*width + i] = noise2d(x0 + i*dx, y0 + j*dy)
+void noise2dGrid(float x0, float y0, float dx, float dy, size_t width, size_t height, float* out);
+// out[(k*height + j)*width + i] = noise3d(x0 + i*dx, y0 + j*dy, z0 + k*dz)
+void noise3dGrid(float x0, float y0, float z0, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out);
@@ -0,0 +1,82 @@
+// Simplex-noise implementation
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <perlinNoise.h>
+
+// Simplex noise field: sums the radial kernels of the N + 1 corners of the
+// simplex containing the point (3 in 2D, 4 in 3D, 5 in 4D) instead of the
+// 2^N corners of a Perlin cell, so it stays cheap in 4D, e.g. for 3D fields
+// animated along w. Values are in [-1, 1] and the field is continuous
+// (kernel radius^2 0.5 in all dimensions).
+//
+// The permutation of 0..255 is the one of PerlinNoise with the same seed,
+// so a PerlinNoise and a SimplexNoise built from one seed share a table.
+class SimplexNoise
+{
+public:
+    explicit SimplexNoise(uint32_t seed = 1);
+
+    float noise2d(float fx, float fy) const;
+    float noise3d(float fx, float fy, float fz) const;
+    float noise4d(float fx, float fy, float fz, float fw) const;
+
+    // Same as the free batch and grid functions below.
+    void noise2dBatch(const float* x, const float* y, float* out, size_t count) const;
+    void noise3dBatch(const float* x, const float* y, const float* z, float* out, size_t count) const;
+    void noise4dBatch(const float* x, const float* y, const float* z, const float* w, float* out, size_t count) const;
+    void noise2dGrid(float x0, float y0, float dx, float dy, size_t width, size_t height, float* out) const;
+    void noise3dGrid(float x0, float y0, float z0, float dx, float dy, float dz,
+        size_t width, size_t height, size_t depth, float* out) const;
+    void noise4dGrid(float x0, float y0, float z0, float w, float dx, float dy, float dz,
+        size_t width, size_t height, size_t depth, float* out) const;
+
+    // Field used by the free functions (seed 1).
+    static const SimplexNoise& global();
+
+private:
+    // Same layout as in PerlinNoise: the permutation twice over plus 4
+    // bytes of padding for the AVX2 gathers.
+    uint8_t perm[PerlinNoise::permutationSize];
+};
+
+// Free functions sampling SimplexNoise::global().
+float simplex2d(float fx, float fy);
+float simplex3d(float fx, float fy, float fz);
+float simplex4d(float fx, float fy, float fz, float fw);
+
+// Batch versions, 8 points at a time with AVX2 (one by one on other
+// targets), bit-identical to the functions above under the same FMA
+// caveat as noise2dBatch.
+
+// out[i] = simplex2d(x[i], y[i])
+void simplex2dBatch(const float* x, const float* y, float* out, size_t count);
+// out[i] = simplex3d(x[i], y[i], z[i])
+void simplex3dBatch(const float* x, const float* y, const float* z, float* out, size_t count);
+// out[i] = simplex4d(x[i], y[i], z[i], w[i])
+void simplex4dBatch(const float* x, const float* y, const float* z, const float* w, float* out, size_t count);
+
+// Regular grids, x varying fastest:
+// out[j*width + i] = simplex2d(x0 + i*dx, y0 + j*dy)
+void simplex2dGrid(float x0, float y0, float dx, float dy, size_t width, size_t height, float* out);
+// out[(k*height + j)*width + i] = simplex3d(x0 + i*dx, y0 + j*dy, z0 + k*dz)
+void simplex3dGrid(float x0, float y0, float z0, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out);
+// A 3D slice of the 4D field at w, e.g. one frame of an animated volume:
+// out[(k*height + j)*width + i] = simplex4d(x0 + i*dx, y0 + j*dy, z0 + k*dz, w)
+void simplex4dGrid(float x0, float y0, float z0, float w, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out);
@@ -0,0 +1,78 @@
+// Simple persistent thread pool
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    using Task = std::function<void(size_t begin, size_t end)>;
+
+    // threadCount = 0 uses one worker per hardware thread
+    // (the calling thread counts as one of them).
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads taking part in parallelFor, including the caller.
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Splits [0, count) into chunks of at most grain items and runs task
+    // on them from all threads; returns when every chunk is done.
+    // Nested calls from inside a task run serially on the calling thread.
+    void parallelFor(size_t count, size_t grain, const Task& task);
+
+    // Same, but below threshold items runs task(0, count) directly on the
+    // calling thread, where the threading overhead is not worth it.
+    template <typename F>
+    void parallelFor(size_t count, size_t grain, size_t threshold, const F& task)
+    {
+        if (count < threshold)
+            task(0, count);
+        else
+            parallelFor(count, grain, Task(task));
+    }
+
+    // Process-wide pool shared by the utils kernels.
+    static ThreadPool& global();
+
+private:
+    void workerLoop();
+    void runChunks();
+
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const Task* task;
+    size_t taskCount;
+    size_t taskGrain;
+    size_t nextItem;
+    size_t pending;
+    uint64_t generation;
+    bool stop;
+};
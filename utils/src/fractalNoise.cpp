@@ -0,0 +1,405 @@
+// Fractal Perlin-noise generators
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <fractalNoise.h>
+#include <threadPool.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Points per tile; the working arrays of a tile live on the stack.
+static constexpr size_t tileSize = 256;
+// Below this many points the threading overhead is not worth it.
+static constexpr size_t parallelThreshold = 1 << 14;
+static constexpr size_t parallelGrain = 1 << 12;
+
+// Shifts of the points the warp field is sampled at, one per axis.
+static const float warpShift[3][3] = {
+    { 0.0f, 0.0f, 0.0f },
+    { 5.2f, 1.3f, 2.8f },
+    { 1.7f, 9.2f, 4.1f } };
+
+// Runs f on [0, count) items of pointsPerItem points each.
+template <typename F>
+static void forRange(size_t count, size_t pointsPerItem, const F& f)
+{
+    ThreadPool::global().parallelFor(count, std::max(parallelGrain / pointsPerItem, size_t(1)),
+        parallelThreshold / pointsPerItem, f);
+}
+
+// Adds one octave value n; the scalar and the tile paths both go through
+// here, in octave order, so they round the same way.
+static inline void accumulate(FractalNoise::Type type, float ridgeOffset, float n, float amplitude,
+    float& sum, float& weight)
+{
+    switch (type)
+    {
+        case FractalNoise::FBm:
+            sum += amplitude * n;
+            break;
+        case FractalNoise::Turbulence:
+            sum += amplitude * std::fabs(n);
+            break;
+        case FractalNoise::Ridged:
+        {
+            float r = ridgeOffset - std::fabs(n);
+            r *= r;
+            sum += amplitude * r * weight;
+            weight = std::min(std::max(r, 0.0f), 1.0f);
+            break;
+        }
+    }
+}
+
+// accumulate() with the gradients of n, of the sum and of the ridge weight.
+template <int D>
+static inline void accumulate(FractalNoise::Type type, float ridgeOffset, float n, const float (&dn)[D],
+    float amplitude, float& sum, float (&dsum)[D], float& weight, float (&dweight)[D])
+{
+    const float s = (n < 0) ? -1.0f : 1.0f;
+    switch (type)
+    {
+        case FractalNoise::FBm:
+            sum += amplitude * n;
+            for (int d = 0; d < D; ++d)
+                dsum[d] += amplitude * dn[d];
+            break;
+        case FractalNoise::Turbulence:
+            sum += amplitude * std::fabs(n);
+            for (int d = 0; d < D; ++d)
+                dsum[d] += amplitude * s * dn[d];
+            break;
+        case FractalNoise::Ridged:
+        {
+            const float a = ridgeOffset - std::fabs(n);
+            const float r = a * a;
+            sum += amplitude * r * weight;
+            for (int d = 0; d < D; ++d)
+            {
+                const float dr = -2.0f * a * s * dn[d];
+                dsum[d] += amplitude * (dr * weight + r * dweight[d]);
+                dweight[d] = (r > 0 && r < 1) ? dr : 0.0f;
+            }
+            weight = std::min(std::max(r, 0.0f), 1.0f);
+            break;
+        }
+    }
+}
+
+static inline float sample(const PerlinNoise& noise, const float (&p)[2])
+{
+    return noise.noise2d(p[0], p[1]);
+}
+
+static inline float sample(const PerlinNoise& noise, const float (&p)[3])
+{
+    return noise.noise3d(p[0], p[1], p[2]);
+}
+
+static inline float sample(const PerlinNoise& noise, const float (&p)[2], float (&grad)[2])
+{
+    return noise.noise2d(p[0], p[1], grad);
+}
+
+static inline float sample(const PerlinNoise& noise, const float (&p)[3], float (&grad)[3])
+{
+    return noise.noise3d(p[0], p[1], p[2], grad);
+}
+
+static inline void sample(const PerlinNoise& noise, const float (&p)[2][tileSize], float* out, size_t n)
+{
+    noise.noise2dBatch(p[0], p[1], out, n);
+}
+
+static inline void sample(const PerlinNoise& noise, const float (&p)[3][tileSize], float* out, size_t n)
+{
+    noise.noise3dBatch(p[0], p[1], p[2], out, n);
+}
+
+template <int D>
+static float octaves(const PerlinNoise& noise, const FractalNoise& f, FractalNoise::Type type, int count,
+    const float (&p)[D])
+{
+    float sum = 0, weight = 1, amplitude = 1, frequency = f.frequency;
+    for (int k = 0; k < count; ++k)
+    {
+        float q[D];
+        for (int d = 0; d < D; ++d)
+            q[d] = p[d] * frequency;
+        accumulate(type, f.ridgeOffset, sample(noise, q), amplitude, sum, weight);
+        amplitude *= f.gain;
+        frequency *= f.lacunarity;
+    }
+    return sum;
+}
+
+template <int D>
+static float fractal(const PerlinNoise& noise, const FractalNoise& f, float (&p)[D])
+{
+    if (f.warp != 0)
+    {
+        float q[D];
+        for (int a = 0; a < D; ++a)
+        {
+            float s[D];
+            for (int d = 0; d < D; ++d)
+                s[d] = p[d] + warpShift[a][d];
+            q[a] = octaves(noise, f, FractalNoise::FBm, f.warpOctaves, s);
+        }
+        for (int d = 0; d < D; ++d)
+            p[d] += f.warp * q[d];
+    }
+    return octaves(noise, f, f.type, f.octaves, p);
+}
+
+// The two functions above with the gradient with respect to p.
+template <int D>
+static float octaves(const PerlinNoise& noise, const FractalNoise& f, FractalNoise::Type type, int count,
+    const float (&p)[D], float (&grad)[D])
+{
+    float sum = 0, weight = 1, amplitude = 1, frequency = f.frequency;
+    float dweight[D];
+    for (int d = 0; d < D; ++d)
+        grad[d] = dweight[d] = 0;
+    for (int k = 0; k < count; ++k)
+    {
+        float q[D], dn[D];
+        for (int d = 0; d < D; ++d)
+            q[d] = p[d] * frequency;
+        const float n = sample(noise, q, dn);
+        for (int d = 0; d < D; ++d)
+            dn[d] *= frequency;
+        accumulate(type, f.ridgeOffset, n, dn, amplitude, sum, grad, weight, dweight);
+        amplitude *= f.gain;
+        frequency *= f.lacunarity;
+    }
+    return sum;
+}
+
+template <int D>
+static float fractal(const PerlinNoise& noise, const FractalNoise& f, float (&p)[D], float (&grad)[D])
+{
+    float dq[D][D]; // dq[a][d] = d q[a] / d p[d]
+    if (f.warp != 0)
+    {
+        float q[D];
+        for (int a = 0; a < D; ++a)
+        {
+            float s[D];
+            for (int d = 0; d < D; ++d)
+                s[d] = p[d] + warpShift[a][d];
+            q[a] = octaves(noise, f, FractalNoise::FBm, f.warpOctaves, s, dq[a]);
+        }
+        for (int d = 0; d < D; ++d)
+            p[d] += f.warp * q[d];
+    }
+    const float v = octaves(noise, f, f.type, f.octaves, p, grad);
+    if (f.warp != 0)
+    {
+        // chain rule through p' = p + warp * q(p)
+        float g[D];
+        for (int d = 0; d < D; ++d)
+        {
+            g[d] = grad[d];
+            for (int a = 0; a < D; ++a)
+                g[d] += f.warp * grad[a] * dq[a][d];
+        }
+        for (int d = 0; d < D; ++d)
+            grad[d] = g[d];
+    }
+    return v;
+}
+
+// Tile versions of the two functions above: n <= tileSize points p[d][i].
+template <int D>
+static void octaves(const PerlinNoise& noise, const FractalNoise& f, FractalNoise::Type type, int count,
+    const float (&p)[D][tileSize], size_t n, float* out)
+{
+    float q[D][tileSize], v[tileSize], weight[tileSize];
+    std::fill(out, out + n, 0.0f);
+    std::fill(weight, weight + n, 1.0f);
+    float amplitude = 1, frequency = f.frequency;
+    for (int k = 0; k < count; ++k)
+    {
+        for (int d = 0; d < D; ++d)
+            for (size_t i = 0; i < n; ++i)
+                q[d][i] = p[d][i] * frequency;
+        sample(noise, q, v, n);
+        for (size_t i = 0; i < n; ++i)
+            accumulate(type, f.ridgeOffset, v[i], amplitude, out[i], weight[i]);
+        amplitude *= f.gain;
+        frequency *= f.lacunarity;
+    }
+}
+
+template <int D>
+static void fractal(const PerlinNoise& noise, const FractalNoise& f, float (&p)[D][tileSize], size_t n, float* out)
+{
+    if (f.warp != 0)
+    {
+        float q[D][tileSize];
+        for (int a = 0; a < D; ++a)
+        {
+            float s[D][tileSize];
+            for (int d = 0; d < D; ++d)
+                for (size_t i = 0; i < n; ++i)
+                    s[d][i] = p[d][i] + warpShift[a][d];
+            octaves(noise, f, FractalNoise::FBm, f.warpOctaves, s, n, q[a]);
+        }
+        for (int d = 0; d < D; ++d)
+            for (size_t i = 0; i < n; ++i)
+                p[d][i] += f.warp * q[d][i];
+    }
+    octaves(noise, f, f.type, f.octaves, p, n, out);
+}
+
+float fractal2d(const PerlinNoise& noise, const FractalNoise& f, float x, float y)
+{
+    float p[2] = { x, y };
+    return fractal(noise, f, p);
+}
+
+float fractal3d(const PerlinNoise& noise, const FractalNoise& f, float x, float y, float z)
+{
+    float p[3] = { x, y, z };
+    return fractal(noise, f, p);
+}
+
+float fractal2d(const PerlinNoise& noise, const FractalNoise& f, float x, float y, float grad[2])
+{
+    float p[2] = { x, y }, g[2];
+    const float v = fractal(noise, f, p, g);
+    grad[0] = g[0];
+    grad[1] = g[1];
+    return v;
+}
+
+float fractal3d(const PerlinNoise& noise, const FractalNoise& f, float x, float y, float z, float grad[3])
+{
+    float p[3] = { x, y, z }, g[3];
+    const float v = fractal(noise, f, p, g);
+    grad[0] = g[0];
+    grad[1] = g[1];
+    grad[2] = g[2];
+    return v;
+}
+
+void fractal2dBatch(const PerlinNoise& noise, const FractalNoise& f,
+    const float* x, const float* y, float* out, size_t count)
+{
+    forRange(count, 1, [&](size_t begin, size_t end) {
+        float p[2][tileSize];
+        for (size_t i = begin; i < end; i += tileSize)
+        {
+            const size_t n = std::min(end - i, tileSize);
+            std::copy(x + i, x + i + n, p[0]);
+            std::copy(y + i, y + i + n, p[1]);
+            fractal(noise, f, p, n, out + i);
+        }
+    });
+}
+
+void fractal3dBatch(const PerlinNoise& noise, const FractalNoise& f,
+    const float* x, const float* y, const float* z, float* out, size_t count)
+{
+    forRange(count, 1, [&](size_t begin, size_t end) {
+        float p[3][tileSize];
+        for (size_t i = begin; i < end; i += tileSize)
+        {
+            const size_t n = std::min(end - i, tileSize);
+            std::copy(x + i, x + i + n, p[0]);
+            std::copy(y + i, y + i + n, p[1]);
+            std::copy(z + i, z + i + n, p[2]);
+            fractal(noise, f, p, n, out + i);
+        }
+    });
+}
+
+// Grid tiles are row segments of up to tileSize points.
+void fractal2dGrid(const PerlinNoise& noise, const FractalNoise& f,
+    float x0, float y0, float dx, float dy, size_t width, size_t height, float* out)
+{
+    forRange(height, width, [&](size_t begin, size_t end) {
+        float p[2][tileSize];
+        for (size_t j = begin; j < end; ++j)
+            for (size_t i0 = 0; i0 < width; i0 += tileSize)
+            {
+                const size_t n = std::min(width - i0, tileSize);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    p[0][i] = x0 + (i0 + i)*dx;
+                    p[1][i] = y0 + j*dy;
+                }
+                fractal(noise, f, p, n, out + j*width + i0);
+            }
+    });
+}
+
+void fractal3dGrid(const PerlinNoise& noise, const FractalNoise& f,
+    float x0, float y0, float z0, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out)
+{
+    forRange(height*depth, width, [&](size_t begin, size_t end) {
+        float p[3][tileSize];
+        for (size_t row = begin; row < end; ++row)
+        {
+            const size_t j = row % height, k = row / height;
+            for (size_t i0 = 0; i0 < width; i0 += tileSize)
+            {
+                const size_t n = std::min(width - i0, tileSize);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    p[0][i] = x0 + (i0 + i)*dx;
+                    p[1][i] = y0 + j*dy;
+                    p[2][i] = z0 + k*dz;
+                }
+                fractal(noise, f, p, n, out + row*width + i0);
+            }
+        }
+    });
+}
+
+// The gradient versions go point by point, the noise gradients have no
+// 8-wide kernels.
+void fractal2dGrid(const PerlinNoise& noise, const FractalNoise& f,
+    float x0, float y0, float dx, float dy, size_t width, size_t height, float* out, float* grad)
+{
+    forRange(height, width, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j)
+            for (size_t i = 0; i < width; ++i)
+            {
+                const size_t k = j*width + i;
+                out[k] = fractal2d(noise, f, x0 + i*dx, y0 + j*dy, grad + 2*k);
+            }
+    });
+}
+
+void fractal3dGrid(const PerlinNoise& noise, const FractalNoise& f,
+    float x0, float y0, float z0, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out, float* grad)
+{
+    forRange(height*depth, width, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row)
+        {
+            const size_t j = row % height, k = row / height;
+            for (size_t i = 0; i < width; ++i)
+            {
+                const size_t n = row*width + i;
+                out[n] = fractal3d(noise, f, x0 + i*dx, y0 + j*dy, z0 + k*dz, grad + 3*n);
+            }
+        }
+    });
+}
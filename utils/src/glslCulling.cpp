@@ -0,0 +1,77 @@
+// GLSL-like math library - batch frustum culling
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <glslCulling.h>
+#include <glslMathPacket.h>
+
+namespace glsl_math
+{
+
+// Appends base + k for every set bit k of mask. Branch-free: every index is
+// written and the output position only advances for the visible ones, so
+// with n <= base + k it never writes past the input count.
+static inline size_t compact(int mask, uint32_t base, int lanes, uint32_t* visible, size_t n)
+{
+    for (int k = 0; k < lanes; ++k)
+    {
+        visible[n] = base + k;
+        n += (mask >> k) & 1;
+    }
+    return n;
+}
+
+size_t cullSpheres(const frustumf& f, const vec4f* spheres, size_t count, uint32_t* visible)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count; i += floatx8::size)
+    {
+        const int lanes = static_cast<int>(min(count - i, static_cast<size_t>(floatx8::size)));
+        vec4x8 s;
+        gather(s, &spheres[i].x, 4, lanes);
+        const vec3x8 c(s.x, s.y, s.z);
+        const floatx8 r = -s.w;
+        maskx8 inside(true);
+        for (const vec4f& p : f.planes)
+            inside = inside & (madd(c.x, floatx8(p.x), madd(c.y, floatx8(p.y), madd(c.z, floatx8(p.z), floatx8(p.w)))) >= r);
+        n = compact(movemask(inside), static_cast<uint32_t>(i), lanes, visible, n);
+    }
+    return n;
+}
+
+size_t cullBoxes(const frustumf& f, const aabbf* boxes, size_t count, uint32_t* visible)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count; i += floatx8::size)
+    {
+        const int lanes = static_cast<int>(min(count - i, static_cast<size_t>(floatx8::size)));
+        vec3x8 lo, hi;
+        gather(lo, &boxes[i].min.x, 6, lanes);
+        gather(hi, &boxes[i].max.x, 6, lanes);
+        maskx8 inside(true);
+        for (const vec4f& p : f.planes)
+        {
+            // the farthest corner is picked per plane, not per lane
+            const floatx8& x = (p.x > 0) ? hi.x : lo.x;
+            const floatx8& y = (p.y > 0) ? hi.y : lo.y;
+            const floatx8& z = (p.z > 0) ? hi.z : lo.z;
+            inside = inside & (madd(x, floatx8(p.x), madd(y, floatx8(p.y), madd(z, floatx8(p.z), floatx8(p.w)))) >= floatx8(0.0f));
+        }
+        n = compact(movemask(inside), static_cast<uint32_t>(i), lanes, visible, n);
+    }
+    return n;
+}
+
+} // namespace glsl_math
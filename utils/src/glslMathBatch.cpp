@@ -0,0 +1,200 @@
+// GLSL-like math library - batch transformations of vertex arrays
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <glslMathBatch.h>
+#include <threadPool.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace glsl_math
+{
+
+// Below this many vertices the threading overhead is not worth it.
+static constexpr size_t parallelThreshold = 1 << 14;
+static constexpr size_t parallelGrain = 1 << 12;
+
+static void transformPointsScalar(const mat4f& m, const float* src, float* dst,
+    size_t begin, size_t end, size_t stride, size_t components)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        const float* s = src + i * stride;
+        float* d = dst + i * stride;
+        const vec4f r = m * vec4f(s[0], s[1], s[2], (components == 4) ? s[3] : 1.0f);
+        d[0] = r.x;
+        d[1] = r.y;
+        d[2] = r.z;
+        if (components == 4)
+            d[3] = r.w;
+    }
+}
+
+static void transformNormalsScalar(const mat3f& m, const float* src, float* dst,
+    size_t begin, size_t end, size_t stride, bool renormalize)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        const float* s = src + i * stride;
+        float* d = dst + i * stride;
+        vec3f r = m * vec3f(s[0], s[1], s[2]);
+        if (renormalize)
+            r = normalize(r);
+        d[0] = r.x;
+        d[1] = r.y;
+        d[2] = r.z;
+    }
+}
+
+#if defined(__AVX2__)
+static inline __m256 madd(__m256 a, __m256 b, __m256 c)
+{
+#if defined(__FMA__)
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+static inline __m256i strideIndices(size_t stride)
+{
+    return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+        _mm256_set1_epi32(static_cast<int>(stride)));
+}
+
+static void transformPointsAvx2(const mat4f& m, const float* src, float* dst,
+    size_t begin, size_t end, size_t stride, size_t components)
+{
+    const __m256i idx = strideIndices(stride);
+    __m256 mm[4][4];
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 4; ++r)
+            mm[c][r] = _mm256_set1_ps((&m[c].x)[r]);
+    alignas(32) float out[4][8];
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        const float* s = src + i * stride;
+        const __m256 x = _mm256_i32gather_ps(s, idx, 4);
+        const __m256 y = _mm256_i32gather_ps(s + 1, idx, 4);
+        const __m256 z = _mm256_i32gather_ps(s + 2, idx, 4);
+        const __m256 w = (components == 4) ? _mm256_i32gather_ps(s + 3, idx, 4) : _mm256_set1_ps(1.0f);
+        for (size_t r = 0; r < components; ++r)
+        {
+            __m256 v = _mm256_mul_ps(mm[3][r], w);
+            v = madd(mm[2][r], z, v);
+            v = madd(mm[1][r], y, v);
+            v = madd(mm[0][r], x, v);
+            _mm256_store_ps(out[r], v);
+        }
+        float* d = dst + i * stride;
+        for (int k = 0; k < 8; ++k, d += stride)
+            for (size_t r = 0; r < components; ++r)
+                d[r] = out[r][k];
+    }
+    transformPointsScalar(m, src, dst, i, end, stride, components);
+}
+
+static void transformNormalsAvx2(const mat3f& m, const float* src, float* dst,
+    size_t begin, size_t end, size_t stride, bool renormalize)
+{
+    const __m256i idx = strideIndices(stride);
+    __m256 mm[3][3];
+    for (int c = 0; c < 3; ++c)
+        for (int r = 0; r < 3; ++r)
+            mm[c][r] = _mm256_set1_ps((&m[c].x)[r]);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    alignas(32) float out[3][8];
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        const float* s = src + i * stride;
+        const __m256 x = _mm256_i32gather_ps(s, idx, 4);
+        const __m256 y = _mm256_i32gather_ps(s + 1, idx, 4);
+        const __m256 z = _mm256_i32gather_ps(s + 2, idx, 4);
+        __m256 v[3];
+        for (int r = 0; r < 3; ++r)
+            v[r] = madd(mm[0][r], x, madd(mm[1][r], y, _mm256_mul_ps(mm[2][r], z)));
+        if (renormalize)
+        {
+            const __m256 len = _mm256_sqrt_ps(madd(v[0], v[0], madd(v[1], v[1], _mm256_mul_ps(v[2], v[2]))));
+            // zero-length normals stay zero, same as normalize()
+            const __m256 f = _mm256_blendv_ps(_mm256_div_ps(one, len), zero,
+                _mm256_cmp_ps(len, zero, _CMP_EQ_OQ));
+            for (int r = 0; r < 3; ++r)
+                v[r] = _mm256_mul_ps(v[r], f);
+        }
+        for (int r = 0; r < 3; ++r)
+            _mm256_store_ps(out[r], v[r]);
+        float* d = dst + i * stride;
+        for (int k = 0; k < 8; ++k, d += stride)
+        {
+            d[0] = out[0][k];
+            d[1] = out[1][k];
+            d[2] = out[2][k];
+        }
+    }
+    transformNormalsScalar(m, src, dst, i, end, stride, renormalize);
+}
+#endif
+
+void transformPoints(const mat4f& m, const float* src, float* dst,
+    size_t count, size_t stride, size_t components)
+{
+    ThreadPool::global().parallelFor(count, parallelGrain, parallelThreshold, [&](size_t begin, size_t end) {
+#if defined(__AVX2__)
+        transformPointsAvx2(m, src, dst, begin, end, stride, components);
+#else
+        transformPointsScalar(m, src, dst, begin, end, stride, components);
+#endif
+    });
+}
+
+void transformPoints(const mat4& m, const float* src, float* dst,
+    size_t count, size_t stride, size_t components)
+{
+    transformPoints(mat4f(m), src, dst, count, stride, components);
+}
+
+void transformNormals(const mat3f& normalMatrix, const float* src, float* dst,
+    size_t count, size_t stride, bool renormalize)
+{
+    ThreadPool::global().parallelFor(count, parallelGrain, parallelThreshold, [&](size_t begin, size_t end) {
+#if defined(__AVX2__)
+        transformNormalsAvx2(normalMatrix, src, dst, begin, end, stride, renormalize);
+#else
+        transformNormalsScalar(normalMatrix, src, dst, begin, end, stride, renormalize);
+#endif
+    });
+}
+
+void transformNormals(const mat4f& m, const float* src, float* dst,
+    size_t count, size_t stride, bool renormalize)
+{
+    transformNormals(transpose(inverse(mat3f(m))), src, dst, count, stride, renormalize);
+}
+
+void transformNormals(const mat4& m, const float* src, float* dst,
+    size_t count, size_t stride, bool renormalize)
+{
+    transformNormals(mat3f(transpose(inverse(mat3(m)))), src, dst, count, stride, renormalize);
+}
+
+} // namespace glsl_math
@@ -16,9 +16,23 @@
 
 
 #include <glslMath.h>
+#include <fractalNoise.h>
+#include <glslCulling.h>
+#include <glslFastMath.h>
+#include <glslMathBatch.h>
+#include <glslMathPacket.h>
+#include <glslPacking.h>
+#include <glslQuat.h>
+#include <meshOptimizer.h>
+#include <perlinNoise.h>
+#include <simplexNoise.h>
 
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
 
 namespace glsl_math
 {
@@ -31,6 +45,96 @@ static void assertTest(bool value)
     assert(value);
 }
 
+// Unit sphere of w x h row-major quads, vertices (x, y, z, vertex number).
+// Triangles are counter-clockwise from outside, or from inside with the
+// quads of genGridIndices when outward is false.
+static void uvSphere(uint32_t w, uint32_t h, std::vector<float>& vertices, std::vector<uint32_t>& indices,
+    bool outward = true)
+{
+    for (uint32_t y = 0; y <= h; ++y)
+        for (uint32_t x = 0; x <= w; ++x)
+        {
+            const float a = x * 6.2831853f / w, b = y * 3.1415926f / h;
+            const float v[4] = { sinf(b) * cosf(a), sinf(b) * sinf(a), cosf(b), static_cast<float>(x + y * (w + 1)) };
+            vertices.insert(vertices.end(), v, v + 4);
+        }
+    for (uint32_t y = 0, v = 0; y < h; ++y, ++v)
+        for (uint32_t x = 0; x < w; ++x, ++v)
+        {
+            const uint32_t out[6] = { v, v + w + 1, v + 1, v + 1, v + w + 1, v + w + 2 };
+            const uint32_t in[6] = { v, v + 1, v + w + 1, v + 1, v + w + 2, v + w + 1 };
+            const uint32_t* q = outward ? out : in;
+            indices.insert(indices.end(), q, q + 6);
+        }
+}
+
+// n points in [-600, 600)^4 from an LCG; every 7th z is an integer and
+// every 5th w equals x, so lattice planes and ties get sampled too.
+static void randomPoints(uint32_t seed, size_t n, std::vector<float>& x, std::vector<float>& y,
+    std::vector<float>& z, std::vector<float>& w)
+{
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    w.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        float r[4];
+        for (float& v : r)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            v = static_cast<float>(static_cast<int32_t>(seed) * (600.0 / 2147483648.0));
+        }
+        x[i] = r[0];
+        y[i] = r[1];
+        z[i] = (i % 7 == 0) ? std::floor(r[2]) : r[2];
+        w[i] = (i % 5 == 0) ? x[i] : r[3];
+    }
+}
+
+// Runs grid(x0, y0, dx, dy, width, height, out) on a fixed 19 x 7 grid and
+// compares every sample with scalar(x, y), row by row.
+template <typename Grid, typename Scalar>
+static bool gridMatches2d(const Grid& grid, const Scalar& scalar, float tolerance)
+{
+    std::vector<float> out(19 * 7);
+    grid(-3.3f, 2.0f, 0.17f, -0.31f, size_t(19), size_t(7), out.data());
+    bool ok = true;
+    for (size_t j = 0; j < 7; ++j)
+        for (size_t i = 0; i < 19; ++i)
+            ok &= fabs(out[j*19 + i] - scalar(-3.3f + i*0.17f, 2.0f + j*-0.31f)) <= tolerance;
+    return ok;
+}
+
+// The same for grid(x0, y0, z0, dx, dy, dz, width, height, depth, out) on
+// 11 x 5 x 4 samples against scalar(x, y, z).
+template <typename Grid, typename Scalar>
+static bool gridMatches3d(const Grid& grid, const Scalar& scalar, float tolerance)
+{
+    std::vector<float> out(11 * 5 * 4);
+    grid(-3.3f, 2.0f, 0.5f, 0.17f, -0.31f, 0.23f, size_t(11), size_t(5), size_t(4), out.data());
+    bool ok = true;
+    for (size_t k = 0; k < 4; ++k)
+        for (size_t j = 0; j < 5; ++j)
+            for (size_t i = 0; i < 11; ++i)
+                ok &= fabs(out[(k*5 + j)*11 + i] - scalar(-3.3f + i*0.17f, 2.0f + j*-0.31f, 0.5f + k*0.23f)) <= tolerance;
+    return ok;
+}
+
+// Triangles rotated to start at the lowest index, sorted.
+static std::vector<uint64_t> canonicalTriangles(const std::vector<uint32_t>& indices)
+{
+    std::vector<uint64_t> tris;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const uint32_t* t = &indices[i];
+        const int r = (t[1] < t[0] && t[1] < t[2]) ? 1 : (t[2] < t[0] && t[2] < t[1]) ? 2 : 0;
+        tris.push_back((uint64_t(t[r]) << 40) | (uint64_t(t[(r + 1) % 3]) << 20) | t[(r + 2) % 3]);
+    }
+    std::sort(tris.begin(), tris.end());
+    return tris;
+}
+
 void runUnitTests()
 {
     constexpr double eps = 1e-8;
@@ -80,6 +184,784 @@ void runUnitTests()
         assertTest(length(n) - 1.0f < 1e-8f);
         assertTest(sign(n.x) == -1.0f);
     }
+    {
+        // Single precision specializations against the generic double templates.
+        const mat4 md = mat4(1, 2, 3, 4, 6, 5, 4, 3, 7, 9, 8, 6, 9, 6, 3, 2);
+        mat4 rd(1.0);
+        rotate(rd, 30.0, 1.0, 2.0, 3.0);
+        translate(rd, 1.0, -2.0, 0.5);
+        const mat4f m = mat4f(md), r = mat4f(rd);
+        const vec4f a = vec4f(1, 2, 3, 4);
+        const auto near = [](const mat4f& x, const mat4& y, double e) {
+            for (int i = 0; i < 4; ++i)
+                for (int j = 0; j < 4; ++j)
+                    if (fabs((&x[i].x)[j] - (&y[i].x)[j]) > e * (1 + fabs((&y[i].x)[j])))
+                        return false;
+            return true;
+        };
+        assertTest(m*a == vec4f(70, 63, 47, 36));
+        assertTest(a*m == vec4f(30, 40, 73, 38));
+        assertTest(near(m*r*m, md*mat4(r)*md, 1e-6));
+        assertTest(near(transpose(r), transpose(mat4(r)), 0));
+        assertTest(near(inverse(m), inverse(md), 1e-5));
+        assertTest(near(inverse(r), inverse(mat4(r)), 1e-5));
+        mat4f id = r*inverse(r);
+        assertTest(near(id, mat4(1.0), 1e-6));
+    }
+    {
+        // Batch transforms of XYZUVN vertices (stride 8, normals at 5).
+        mat4 m(1.0);
+        translate(m, 1.0, 2.0, 3.0);
+        rotate(m, 40.0, 1.0, 1.0, 0.0);
+        const mat3 nm = transpose(inverse(mat3(m)));
+        const size_t count = 20003, stride = 8;
+        std::vector<float> src(count * stride);
+        for (size_t i = 0; i < src.size(); ++i)
+            src[i] = static_cast<float>((i * 7919) % 1000) * 0.01f - 5.0f;
+        std::vector<float> dst = src;
+        transformPoints(m, src.data(), dst.data(), count, stride);
+        transformNormals(m, src.data() + 5, dst.data() + 5, count, stride);
+        bool ok = true;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float* s = &src[i * stride];
+            const float* d = &dst[i * stride];
+            const vec3 p = vec3(m * vec4(s[0], s[1], s[2], 1));
+            const vec3 n = normalize(nm * vec3(s[5], s[6], s[7]));
+            for (int k = 0; k < 3; ++k)
+            {
+                ok = ok && fabs(d[k] - (&p.x)[k]) < 1e-4 * (1 + fabs((&p.x)[k]));
+                ok = ok && fabs(d[5 + k] - (&n.x)[k]) < 1e-5;
+            }
+            ok = ok && d[3] == s[3] && d[4] == s[4];
+        }
+        assertTest(ok);
+    }
+    {
+        // Packets against the scalar functions, lane by lane (PTNC layout).
+        const size_t stride = 15;
+        float data[8 * stride];
+        for (size_t i = 0; i < 8 * stride; ++i)
+            data[i] = static_cast<float>((i * 37) % 23) * 0.37f - 4.0f;
+        vec3x8 a, b;
+        gather(a, data, stride);
+        gather(b, data + 8, stride);
+        const vec3x8 n = normalize(cross(a, b));
+        const floatx8 d = dot(a, b);
+        const vec3x8 m = mix(min(a, b), max(a, b), floatx8(0.25f));
+        const vec3x8 f = fract(a);
+        const floatx8 s = smoothmin(a.x, b.x, floatx8(2.0f));
+        // FMA contraction may differ between the two paths.
+        const auto close = [](float x, float y) { return fabs(x - y) <= 1e-5f * (1 + fabs(y)); };
+        bool ok = true;
+        for (int i = 0; i < 8; ++i)
+        {
+            const vec3f sa(data[i * stride], data[i * stride + 1], data[i * stride + 2]);
+            const vec3f sb(data[i * stride + 8], data[i * stride + 9], data[i * stride + 10]);
+            const vec3f sn = normalize(cross(sa, sb));
+            const vec3f sm = mix(min(sa, sb), max(sa, sb), 0.25f);
+            const vec3f sf = fract(sa);
+            ok = ok && close(n.x[i], sn.x) && close(n.y[i], sn.y) && close(n.z[i], sn.z);
+            ok = ok && close(d[i], dot(sa, sb));
+            ok = ok && close(m.x[i], sm.x) && close(m.y[i], sm.y) && close(m.z[i], sm.z);
+            ok = ok && f.x[i] == sf.x && f.y[i] == sf.y && f.z[i] == sf.z;
+            ok = ok && close(s[i], smoothmin(sa.x, sb.x, 2.0f));
+        }
+        assertTest(ok);
+        assertTest(movemask(d > floatx8(0.0f)) == ((d[0] > 0) | (d[1] > 0) << 1 | (d[2] > 0) << 2
+            | (d[3] > 0) << 3 | (d[4] > 0) << 4 | (d[5] > 0) << 5 | (d[6] > 0) << 6 | (d[7] > 0) << 7));
+        // Partial scatter leaves the remaining vertices untouched.
+        float out[8 * stride] = {};
+        scatter(n, out + 8, stride, 5);
+        vec3x8 r;
+        gather(r, out + 8, stride, 5);
+        for (int i = 0; i < 8; ++i)
+            ok = ok && r.x[i] == ((i < 5) ? n.x[i] : 0.0f) && out[i * stride] == 0.0f;
+        assertTest(ok);
+    }
+    {
+        // Compile-time transforms.
+        constexpr mat4 p = ctPerspectiveProjection(90.0, 2.0, 0.1, 100.0);
+        static_assert(p[1].y > 1 - 1e-12 && p[1].y < 1 + 1e-12 && p[0].x == p[1].y / 2, "");
+        constexpr mat4 o = orthographicProjection(-1.0, 3.0, -1.0, 1.0, 0.0, 1.0);
+        static_assert(o * vec4(3, 1, 0, 1) == vec4(1, 1, -1, 1), "");
+        constexpr mat3 r = ctRotation(90.0, 0.0, 0.0, 2.0);
+        constexpr vec3 v = r * vec3(1, 0, 0);
+        static_assert(v.x * v.x < 1e-24 && (v.y - 1) * (v.y - 1) < 1e-24 && v.z == 0, "");
+        static_assert(ctSqrt(2.0) * ctSqrt(2.0) - 2 < 1e-15 && ctSqrt(0.0) == 0, "");
+        static constexpr SinCosTable<float, 64> table;
+        static_assert(table.sin[0] == 0 && table.sin[16] == 1 && table.cos[32] == -1, "");
+        const mat4 pp = perspectiveProjection(90.0, 2.0, 0.1, 100.0);
+        const mat3 rr = rotation(90.0, 0.0, 0.0, 2.0);
+        bool ok = true;
+        for (int i = 0; i < 4; ++i)
+            ok = ok && length(p[i] - pp[i]) < 1e-14;
+        for (int i = 0; i < 3; ++i)
+            ok = ok && length(r[i] - rr[i]) < 1e-14;
+        for (int i = -1000; i <= 1000; ++i)
+        {
+            const double x = i * 0.0137;
+            ok = ok && fabs(ctSin(x) - sin(x)) < 1e-14 && fabs(ctCos(x) - cos(x)) < 1e-14;
+            ok = ok && fabs(ctTan(x * 0.1) - tan(x * 0.1)) < 1e-13;
+            ok = ok && fabs(ctSqrt(x * x) - fabs(x)) < 1e-14;
+        }
+        for (size_t i = 0; i < 64; ++i)
+            ok = ok && fabs(table.sin[i] - sin(2 * M_PI * i / 64)) < 1e-6;
+        assertTest(ok);
+    }
+    {
+        // Fast math: float and both packet widths against libm.
+        bool ok = true;
+        const auto err = [](float x, double r) { return fabs(x - r) / max(1.0, fabs(r)); };
+        for (int i = 0; i < 4000; i += 8)
+        {
+            float x[8], s[8], c[8], e[8], l[8], r[8];
+            for (int k = 0; k < 8; ++k)
+                x[k] = static_cast<float>((i + k - 2000) * 0.0371);
+            floatx8 sx8, cx8;
+            fast::sincos(floatx8::load(x), sx8, cx8);
+            sx8.store(s);
+            cx8.store(c);
+            fast::exp(floatx8::load(x)).store(e);
+            fast::log<fast::High>(abs(floatx8::load(x))).store(l);
+            fast::rsqrt(abs(floatx4::load(x))).store(r);
+            fast::rsqrt(abs(floatx4::load(x + 4))).store(r + 4);
+            for (int k = 0; k < 8; ++k)
+            {
+                const double ax = fabs(x[k]);
+                const float cx = static_cast<float>(cos(x[k]));
+                ok = ok && fabs(fast::acos(cx) - acos(cx)) < 1e-6 && fabs(fast::acos<fast::Low>(cx) - acos(cx)) < 5e-5;
+                ok = ok && s[k] == fast::sin(x[k]) && c[k] == fast::cos(x[k]);
+                ok = ok && err(s[k], sin(x[k])) < 2e-6 && err(c[k], cos(x[k])) < 2e-6;
+                ok = ok && err(fast::sin<fast::Low>(x[k]), sin(x[k])) < 5e-4;
+                ok = ok && err(fast::cos<fast::High>(x[k]), cos(x[k])) < 2e-7;
+                ok = ok && fabs(e[k] - exp(x[k])) < 4e-6 * exp(x[k]);
+                ok = ok && (ax == 0 || err(l[k], log(ax)) < 2e-7);
+                ok = ok && (ax == 0 || fabs(r[k] * sqrt(ax) - 1) < 1e-5);
+                ok = ok && fabs(fast::pow(2.5f, x[k] * 0.1f) - pow(2.5, x[k] * 0.1f)) < 2e-5 * pow(2.5, x[k] * 0.1f);
+            }
+        }
+        ok = ok && fast::log(0.0f) == -std::numeric_limits<float>::infinity();
+        ok = ok && fast::exp(-100.0f) == 0 && fast::exp(0.0f) == 1;
+        const vec3f v(3, -4, 12);
+        ok = ok && length(fast::normalize(v) - normalize(v)) < 1e-5f;
+        ok = ok && fast::normalize(vec3x4(floatx4(0.0f))).x[0] == 0;
+        assertTest(ok);
+    }
+    {
+        // Structured inverses and the cached transform.
+        mat4 rigid(1);
+        translate(rigid, 1.0, -2.0, 3.0);
+        rotate(rigid, 40.0, 1.0, 1.0, 0.0);
+        const mat4 affine = rigid * mat4(mat3(2, 0, 0, 0.3, 0.5, 0, 0, 0, 3));
+        const mat4 proj = perspectiveProjection(60.0, 1.5, 0.5, 50.0);
+        bool ok = true;
+        const mat4 ir = inverseRigid(rigid), ia = inverseAffine(affine), ga = inverse(affine);
+        const mat3 na = normalMatrix(affine), ga3 = transpose(inverse(mat3(affine)));
+        for (int i = 0; i < 4; ++i)
+            ok = ok && length(ir[i] - inverse(rigid)[i]) < 1e-12 && length(ia[i] - ga[i]) < 1e-12;
+        for (int i = 0; i < 3; ++i)
+            ok = ok && length(na[i] - ga3[i]) < 1e-12;
+        transform t(affine), tr(rigid, transform::Rigid), tp(proj, transform::General);
+        for (int i = 0; i < 3; ++i)
+            ok = ok && length(t.normalMatrix()[i] - ga3[i]) < 1e-12 && length(tr.normalMatrix()[i] - mat3(rigid)[i]) < 1e-12;
+        ok = ok && length(t.inverse()[3] - ga[3]) < 1e-12 && length(tp.inverse()[2] - inverse(proj)[2]) < 1e-12;
+        t.set(rigid);
+        ok = ok && length(t.inverse()[3] - ir[3]) < 1e-12 && length(t.normalMatrix()[0] - mat3(rigid)[0]) < 1e-12;
+        vec3 pos0, dir0, pos1, dir1;
+        calculate_ray(pos0, dir0, 100.0, 50.0, affine, proj, 0, 0, 640, 480);
+        calculate_ray(pos1, dir1, 100.0, 50.0, transform(affine), tp, 0, 0, 640, 480);
+        ok = ok && length(pos0 - pos1) < 1e-12 && length(dir0 - dir1) < 1e-12;
+        ok = ok && length(pos0 - vec3(ga[3])) < 1e-12;
+        assertTest(ok);
+    }
+    {
+        // Frustum culling: scalar tests against clip space, batch against scalar.
+        mat4 view(1);
+        translate(view, 0.0, 0.0, -10.0);
+        rotate(view, 30.0, 0.0, 1.0, 0.0);
+        const mat4 mvp = perspectiveProjection(60.0, 1.5, 0.5, 50.0) * view;
+        const frustum f(mvp);
+        const frustum fo(orthographicProjection(-2.0, 2.0, -1.0, 1.0, 0.0, 10.0));
+        const frustumf ff = frustumf(mat4f(mvp));
+        bool ok = isVisible(f, vec3(0, 0, 0), 0.1) && !isVisible(f, vec3(0, 0, 30), 1.0);
+        ok = ok && isVisible(fo, aabb(vec3(1.9, 0.9, -5), vec3(3, 3, -4))) && !isVisible(fo, aabb(vec3(2.1, 0, -5), vec3(3, 1, -4)));
+        ok = ok && !isVisible(fo, vec3(0, 0, 0.5), 0.4) && isVisible(fo, vec3(0, 0, 0.5), 0.6);
+        const size_t n = 1000;
+        std::vector<vec4f> spheres(n);
+        std::vector<aabbf> boxes(n);
+        std::vector<uint32_t> vis(n);
+        size_t inside = 0, visibleSpheres = 0, visibleBoxes = 0;
+        uint32_t seed = 7;
+        for (size_t i = 0; i < n; ++i)
+        {
+            float r[4];
+            for (float& x : r)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                x = (seed >> 8) / 16777216.0f;
+            }
+            const vec3f c = vec3f(r[0], r[1], r[2]) * 80.0f - 40.0f;
+            spheres[i] = vec4f(c, r[3] * 3);
+            boxes[i] = aabbf(c - r[3] * 3, c + r[3]);
+            // points strictly inside clip space must never be culled
+            const vec4 clip = mvp * vec4(vec3(c), 1);
+            if (fabs(clip.x) < clip.w && fabs(clip.y) < clip.w && fabs(clip.z) < clip.w)
+            {
+                ++inside;
+                ok = ok && isVisible(f, vec3(c), 0.0);
+            }
+            visibleSpheres += isVisible(ff, vec3f(spheres[i]), spheres[i].w);
+            visibleBoxes += isVisible(ff, boxes[i]);
+        }
+        for (size_t count : { n, size_t(13), size_t(0) })
+        {
+            size_t k = cullSpheres(ff, spheres.data(), count, vis.data());
+            for (size_t i = 0, j = 0; i < count; ++i)
+                if (isVisible(ff, vec3f(spheres[i]), spheres[i].w))
+                    ok = ok && j < k && vis[j++] == i;
+            ok = ok && (count < n || k == visibleSpheres);
+            k = cullBoxes(ff, boxes.data(), count, vis.data());
+            for (size_t i = 0, j = 0; i < count; ++i)
+                if (isVisible(ff, boxes[i]))
+                    ok = ok && j < k && vis[j++] == i;
+            ok = ok && (count < n || k == visibleBoxes);
+        }
+        ok = ok && inside > 10 && visibleSpheres < n / 2;
+        assertTest(ok);
+    }
+    {
+        // Packed formats: scalar round trips, array versions bit-exact with scalar.
+        bool ok = packHalf(1.0f) == 0x3c00 && packHalf(-2.0f) == 0xc000 && packHalf(65520.0f) == 0x7c00;
+        ok = ok && packHalf(5.96046448e-08f) == 0x0001 && packHalf(1.0f + 1.0f / 2048) == 0x3c00;
+        ok = ok && unpackHalf(0x7bff) == 65504.0f && unpackHalf(0x0001) == 5.96046448e-08f && unpackHalf(0xfc00) < -3e38f;
+        ok = ok && packSnorm8(-2.0f) == -127 && unpackSnorm8(-128) == -1.0f && packSnorm16(0.5f) == 16384;
+        ok = ok && packInt2101010Rev(vec4f(1, -1, 0, -1)) == (0x1ffu | (0x201u << 10) | (3u << 30));
+        ok = ok && unpackInt2101010Rev(packInt2101010Rev(vec4f(1, -1, 0.25f, 1))) == vec4f(1, -1, 128 / 511.0f, 1);
+        ok = ok && packUnorm8(-0.5f) == 0 && packUnorm8(0.5f) == 128 && packUnorm8(2.0f) == 255;
+        ok = ok && packUnorm4x8(vec4f(1, 0, 0.2f, 1)) == 0xff3300ffu
+            && packUnorm4x8(unpackUnorm4x8(0x807f01feu)) == 0x807f01feu && unpackUnorm4x8(0xff00u).y == 1.0f;
+        const size_t n = 203;
+        std::vector<float> f(n * 4), g(n * 4), h(n * 4);
+        std::vector<uint16_t> hf(n * 4);
+        std::vector<int8_t> s8(n * 4);
+        std::vector<int16_t> s16(n * 4);
+        std::vector<uint32_t> p(n);
+        uint32_t seed = 3;
+        for (float& x : f)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            x = static_cast<float>(static_cast<int32_t>(seed) * (2.5 / 2147483648.0));
+        }
+        f[0] = 70000.0f;
+        f[1] = 1e-6f;
+        f[2] = -0.0f;
+        f[3] = std::numeric_limits<float>::infinity();
+        f[4] = 0.5f / 127;
+        const uint32_t nan = 0xffa5a5a5u; // signalling, with a payload
+        memcpy(&f[5], &nan, sizeof(nan));
+        ok = ok && packHalf(f[5]) == 0xff2d;
+        packHalf(f.data(), hf.data(), n * 4);
+        unpackHalf(hf.data(), g.data(), n * 4);
+        for (size_t i = 0; i < n * 4; ++i)
+        {
+            // bits, NaNs included
+            const float u = unpackHalf(hf[i]);
+            ok = ok && hf[i] == packHalf(f[i]) && memcmp(&g[i], &u, sizeof(u)) == 0
+                && (f[i] != f[i] || fabs(f[i]) > 65504 || fabs(g[i] - f[i]) <= max(fabs(f[i]) / 2048, 3e-8f));
+        }
+        // halves not made by packHalf: a signalling NaN unpacks quiet
+        hf[0] = 0x7c01;
+        unpackHalf(hf.data(), g.data(), 8);
+        const float scalar = unpackHalf(0x7c01);
+        uint32_t quiet;
+        memcpy(&quiet, &g[0], sizeof(quiet));
+        ok = ok && quiet == 0x7fc02000u && memcmp(&g[0], &scalar, sizeof(scalar)) == 0;
+        f[5] = 0.25f; // the other formats leave NaN undefined
+        packSnorm8(f.data(), s8.data(), n * 4);
+        unpackSnorm8(s8.data(), g.data(), n * 4);
+        for (size_t i = 0; i < n * 4; ++i)
+            ok = ok && s8[i] == packSnorm8(f[i]) && g[i] == unpackSnorm8(s8[i]);
+        packSnorm16(f.data(), s16.data(), n * 4);
+        unpackSnorm16(s16.data(), g.data(), n * 4);
+        for (size_t i = 0; i < n * 4; ++i)
+            ok = ok && s16[i] == packSnorm16(f[i]) && g[i] == unpackSnorm16(s16[i])
+                && fabs(g[i] - min(max(f[i], -1.0f), 1.0f)) <= 0.5f / 32767;
+        for (size_t components = 3; components <= 4; ++components)
+        {
+            packInt2101010Rev(f.data(), 4, components, p.data(), n);
+            unpackInt2101010Rev(p.data(), g.data(), 4, components, n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                const vec4f v(f[4 * i], f[4 * i + 1], f[4 * i + 2], (components == 4) ? f[4 * i + 3] : 1.0f);
+                const vec4f u = unpackInt2101010Rev(p[i]);
+                ok = ok && p[i] == packInt2101010Rev(v) && g[4 * i] == u.x && g[4 * i + 2] == u.z
+                    && (components == 3 || g[4 * i + 3] == u.w);
+            }
+        }
+        packOctahedral(f.data(), 4, s16.data(), n);
+        unpackOctahedral(s16.data(), g.data(), 4, n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            const vec3f v = normalize(vec3f(f[4 * i], f[4 * i + 1], f[4 * i + 2]));
+            const vec2f e = octEncode(v);
+            const vec3f d(g[4 * i], g[4 * i + 1], g[4 * i + 2]);
+            ok = ok && std::abs(s16[2 * i] - packSnorm16(e.x)) <= 1 && std::abs(s16[2 * i + 1] - packSnorm16(e.y)) <= 1;
+            ok = ok && (i == 0 || (length(d - v) < 1e-4f && length(octDecode(e) - v) < 1e-6f));
+        }
+        assertTest(ok);
+    }
+    {
+        // Batch noise against the scalar functions.
+        bool ok = true;
+        const size_t n = 1003;
+        std::vector<float> x, y, z, w, out(n);
+        randomPoints(11, n, x, y, z, w);
+        noise2dBatch(x.data(), y.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            ok = ok && fabs(out[i] - noise2d(x[i], y[i])) < 1e-6f;
+        noise3dBatch(x.data(), y.data(), z.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            ok = ok && fabs(out[i] - noise3d(x[i], y[i], z[i])) < 1e-6f;
+        ok = ok && gridMatches2d([](auto... a) { noise2dGrid(a...); },
+            [](float x, float y) { return noise2d(x, y); }, 1e-6f);
+        ok = ok && gridMatches3d([](auto... a) { noise3dGrid(a...); },
+            [](float x, float y, float z) { return noise3d(x, y, z); }, 1e-6f);
+
+        // Seeded fields: seed 1 is the free functions' field, others differ
+        // but stay within range, and batches use their own table.
+        const PerlinNoise a(1), b(2), c(12345);
+        int differ = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            ok = ok && a.noise3d(x[i], y[i], z[i]) == noise3d(x[i], y[i], z[i]);
+            ok = ok && a.noise2d(x[i], y[i]) == noise2d(x[i], y[i]);
+            ok = ok && a.noise1d(x[i]) == noise1d(x[i]);
+            const float fb = b.noise3d(x[i], y[i], z[i]);
+            ok = ok && fabs(fb) <= 1.5f;
+            differ += fb != c.noise3d(x[i], y[i], z[i]) && fb != a.noise3d(x[i], y[i], z[i]);
+        }
+        ok = ok && differ > static_cast<int>(n) * 9 / 10;
+        b.noise3dBatch(x.data(), y.data(), z.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            ok = ok && fabs(out[i] - b.noise3d(x[i], y[i], z[i])) < 1e-6f;
+        ok = ok && gridMatches2d([&](auto... a) { c.noise2dGrid(a...); },
+            [&](float x, float y) { return c.noise2d(x, y); }, 1e-6f);
+        assertTest(ok);
+    }
+    {
+        // Fractal noise: tiled grids and batches against the scalar sums.
+        bool ok = true;
+        const PerlinNoise noise(7);
+        std::vector<float> x(300), y(300), z(300), out(300);
+        for (size_t i = 0; i < x.size(); ++i)
+        {
+            x[i] = -20.0f + i * 0.137f;
+            y[i] = 3.0f - i * 0.071f;
+            z[i] = i * 0.029f;
+        }
+        for (int type = FractalNoise::FBm; type <= FractalNoise::Turbulence; ++type)
+            for (float warp : { 0.0f, 0.8f })
+            {
+                FractalNoise f;
+                f.type = static_cast<FractalNoise::Type>(type);
+                f.octaves = 5;
+                f.frequency = 0.3f;
+                f.warp = warp;
+                ok = ok && gridMatches2d([&](auto... a) { fractal2dGrid(noise, f, a...); },
+                    [&](float x, float y) { return fractal2d(noise, f, x, y); }, 1e-4f);
+                ok = ok && gridMatches3d([&](auto... a) { fractal3dGrid(noise, f, a...); },
+                    [&](float x, float y, float z) { return fractal3d(noise, f, x, y, z); }, 1e-4f);
+                fractal2dBatch(noise, f, x.data(), y.data(), out.data(), x.size());
+                for (size_t i = 0; i < x.size(); ++i)
+                    ok = ok && fabs(out[i] - fractal2d(noise, f, x[i], y[i])) < 1e-4f;
+                fractal3dBatch(noise, f, x.data(), y.data(), z.data(), out.data(), x.size());
+                for (size_t i = 0; i < x.size(); ++i)
+                    ok = ok && fabs(out[i] - fractal3d(noise, f, x[i], y[i], z[i])) < 1e-4f;
+            }
+        // one octave of fBm is the noise itself, turbulence its magnitude
+        FractalNoise f;
+        f.octaves = 1;
+        f.frequency = 1.0f;
+        ok = ok && fractal3d(noise, f, 1.3f, -2.2f, 0.7f) == noise.noise3d(1.3f, -2.2f, 0.7f);
+        f.type = FractalNoise::Turbulence;
+        ok = ok && fractal2d(noise, f, 1.3f, -2.2f) == fabs(noise.noise2d(1.3f, -2.2f));
+        assertTest(ok);
+    }
+    {
+        // Noise gradients against central differences; the values are the
+        // same as without the gradient.
+        const PerlinNoise noise(3);
+        const float h = 1e-3f;
+        int bad = 0, count = 0;
+        for (int i = 0; i < 200; ++i)
+        {
+            const float x = -7.3f + i * 0.0731f, y = 2.1f - i * 0.0413f, z = i * 0.0297f;
+            float g2[2], g3[3];
+            if (noise.noise2d(x, y, g2) != noise.noise2d(x, y) || noise.noise3d(x, y, z, g3) != noise.noise3d(x, y, z))
+                bad += 1000;
+            const float d2[2] = {
+                (noise.noise2d(x + h, y) - noise.noise2d(x - h, y)) / (2 * h),
+                (noise.noise2d(x, y + h) - noise.noise2d(x, y - h)) / (2 * h) };
+            const float d3[3] = {
+                (noise.noise3d(x + h, y, z) - noise.noise3d(x - h, y, z)) / (2 * h),
+                (noise.noise3d(x, y + h, z) - noise.noise3d(x, y - h, z)) / (2 * h),
+                (noise.noise3d(x, y, z + h) - noise.noise3d(x, y, z - h)) / (2 * h) };
+            for (int k = 0; k < 2; ++k)
+                bad += fabs(g2[k] - d2[k]) > 1e-2f;
+            for (int k = 0; k < 3; ++k)
+                bad += fabs(g3[k] - d3[k]) > 1e-2f;
+        }
+        assertTest(bad == 0);
+
+        // Fractal gradients; kinks of |n| and of the ridge weight may spoil
+        // a few of the differences.
+        for (int type = FractalNoise::FBm; type <= FractalNoise::Turbulence; ++type)
+            for (float warp : { 0.0f, 0.5f })
+            {
+                FractalNoise f;
+                f.type = static_cast<FractalNoise::Type>(type);
+                f.octaves = 4;
+                f.frequency = 0.3f;
+                f.warp = warp;
+                bad = 0;
+                count = 0;
+                for (int i = 0; i < 200; ++i)
+                {
+                    const float x = -7.3f + i * 0.0731f, y = 2.1f - i * 0.0413f, z = i * 0.0297f;
+                    float g2[2], g3[3];
+                    bad += 1000 * (fractal2d(noise, f, x, y, g2) != fractal2d(noise, f, x, y));
+                    bad += 1000 * (fractal3d(noise, f, x, y, z, g3) != fractal3d(noise, f, x, y, z));
+                    const float d[5] = {
+                        (fractal2d(noise, f, x + h, y) - fractal2d(noise, f, x - h, y)) / (2 * h),
+                        (fractal2d(noise, f, x, y + h) - fractal2d(noise, f, x, y - h)) / (2 * h),
+                        (fractal3d(noise, f, x + h, y, z) - fractal3d(noise, f, x - h, y, z)) / (2 * h),
+                        (fractal3d(noise, f, x, y + h, z) - fractal3d(noise, f, x, y - h, z)) / (2 * h),
+                        (fractal3d(noise, f, x, y, z + h) - fractal3d(noise, f, x, y, z - h)) / (2 * h) };
+                    const float g[5] = { g2[0], g2[1], g3[0], g3[1], g3[2] };
+                    for (int k = 0; k < 5; ++k, ++count)
+                        bad += fabs(g[k] - d[k]) > 2e-2f * (1 + fabs(d[k]));
+                }
+                assertTest(bad <= count / 50);
+            }
+
+        FractalNoise f;
+        f.type = FractalNoise::Ridged;
+        f.warp = 0.3f;
+        f.frequency = 0.2f;
+        // Grid gradients: the scalar reference is visited in grid order, so
+        // sample n checks gradient n.
+        std::vector<float> grad(3 * 11 * 5 * 4);
+        bool ok = true, gradOk = true;
+        size_t n = 0;
+        ok = ok && gridMatches2d([&](auto... a) { fractal2dGrid(noise, f, a..., grad.data()); },
+            [&](float x, float y) {
+                float g[2];
+                const float v = fractal2d(noise, f, x, y, g);
+                gradOk &= grad[2*n] == g[0] && grad[2*n + 1] == g[1];
+                ++n;
+                return v; }, 0);
+        n = 0;
+        ok = ok && gridMatches3d([&](auto... a) { fractal3dGrid(noise, f, a..., grad.data()); },
+            [&](float x, float y, float z) {
+                float g[3];
+                const float v = fractal3d(noise, f, x, y, z, g);
+                gradOk &= grad[3*n] == g[0] && grad[3*n + 1] == g[1] && grad[3*n + 2] == g[2];
+                ++n;
+                return v; }, 0);
+        assertTest(ok && gradOk);
+    }
+    {
+        // Simplex noise: batches and grids against the scalar functions,
+        // range, continuity and seeds.
+        bool ok = true;
+        const size_t n = 1003;
+        std::vector<float> x, y, z, w, out(n);
+        randomPoints(17, n, x, y, z, w);
+        simplex2dBatch(x.data(), y.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            ok = ok && fabs(out[i] - simplex2d(x[i], y[i])) < 1e-6f;
+        simplex3dBatch(x.data(), y.data(), z.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            ok = ok && fabs(out[i] - simplex3d(x[i], y[i], z[i])) < 1e-6f;
+        simplex4dBatch(x.data(), y.data(), z.data(), w.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            ok = ok && fabs(out[i] - simplex4d(x[i], y[i], z[i], w[i])) < 1e-6f;
+        ok = ok && gridMatches2d([](auto... a) { simplex2dGrid(a...); },
+            [](float x, float y) { return simplex2d(x, y); }, 1e-6f);
+        ok = ok && gridMatches3d([](auto... a) { simplex3dGrid(a...); },
+            [](float x, float y, float z) { return simplex3d(x, y, z); }, 1e-6f);
+        ok = ok && gridMatches3d([](float x0, float y0, float z0, auto... a) { simplex4dGrid(x0, y0, z0, 7.7f, a...); },
+            [](float x, float y, float z) { return simplex4d(x, y, z, 7.7f); }, 1e-6f);
+
+        // In range, not degenerate, and continuous across simplex borders:
+        // a step of 1e-3 changes the value by at most |gradient| * 1e-3.
+        const SimplexNoise a(1), b(2), c(12345);
+        const float h = 1e-3f;
+        float jump = 0;
+        double sum2 = 0;
+        int differ = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const float v2 = a.noise2d(x[i], y[i]);
+            const float v3 = a.noise3d(x[i], y[i], z[i]);
+            const float v4 = a.noise4d(x[i], y[i], z[i], w[i]);
+            ok = ok && v2 == simplex2d(x[i], y[i]) && v3 == simplex3d(x[i], y[i], z[i]);
+            ok = ok && v4 == simplex4d(x[i], y[i], z[i], w[i]);
+            ok = ok && fabs(v2) <= 1 && fabs(v3) <= 1 && fabs(v4) <= 1;
+            sum2 += v3 * v3;
+            jump = fmaxf(jump, fabsf(a.noise2d(x[i] + h, y[i] - h) - v2));
+            jump = fmaxf(jump, fabsf(a.noise3d(x[i] + h, y[i], z[i] - h) - v3));
+            jump = fmaxf(jump, fabsf(a.noise4d(x[i], y[i] + h, z[i], w[i] + h) - v4));
+            const float fb = b.noise4d(x[i], y[i], z[i], w[i]);
+            differ += fb != c.noise4d(x[i], y[i], z[i], w[i]) && fb != v4;
+        }
+        ok = ok && jump < 0.02f && sum2 / n > 0.05;
+        ok = ok && differ > static_cast<int>(n) * 9 / 10;
+        b.noise4dBatch(x.data(), y.data(), z.data(), w.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            ok = ok && fabs(out[i] - b.noise4d(x[i], y[i], z[i], w[i])) < 1e-6f;
+        ok = ok && gridMatches3d([&](auto... a) { c.noise3dGrid(a...); },
+            [&](float x, float y, float z) { return c.noise3d(x, y, z); }, 1e-6f);
+        assertTest(ok);
+    }
+    {
+        // Quaternions: conversions against matrices, slerp against matrix slerp.
+        bool ok = true;
+        const mat3 ra = rotation(30.0, 1.0, 2.0, 3.0);
+        const mat3 rb = rotation(170.0, -1.0, 0.5, 0.0);
+        const quat qa = quatRotation(30.0, 1.0, 2.0, 3.0);
+        const quat qb = toQuat(rb);
+        const vec3 v(0.3, -2, 1);
+        ok = ok && length(ra * v - qa * v) < 1e-12 && length(rb * v - qb * v) < 1e-12;
+        ok = ok && fabs(dot(toQuat(ra), qa)) > 1 - 1e-12;
+        for (int i = 0; i < 3; ++i)
+            ok = ok && length(toMat3(qb)[i] - rb[i]) < 1e-12;
+        ok = ok && length((qa * qb) * v - ra * (rb * v)) < 1e-12;
+        ok = ok && length(inverse(qa) * (qa * v) - v) < 1e-12;
+        for (int i = 0; i <= 8; ++i)
+        {
+            const double t = i / 8.0;
+            mat3 m;
+            slerp(m, ra, rb, t);
+            ok = ok && length(m * v - slerp(qa, qb, t) * v) < 1e-9;
+            ok = ok && length(slerp(qa, -qb, t) * v - slerp(qa, qb, t) * v) < 1e-12;
+        }
+        ok = ok && length(slerp(qa, qa, 0.5) * v - qa * v) < 1e-12;
+
+        const dualquat da(qa, vec3(1, 2, 3)), db(qb, vec3(-4, 0, 2));
+        mat4 ma = toMat4(da);
+        ok = ok && length(tvec3<double>(ma * vec4(v, 1)) - transformPoint(da, v)) < 1e-12;
+        ok = ok && length(transformPoint(da * db, v) - transformPoint(da, transformPoint(db, v))) < 1e-12;
+        ok = ok && length(transformPoint(conjugate(da), transformPoint(da, v)) - v) < 1e-12;
+        const dualquat dm = toDualQuat(ma);
+        ok = ok && length(getTranslation(dm) - vec3(1, 2, 3)) < 1e-12 && fabs(dot(dm.real, qa)) > 1 - 1e-12;
+        ok = ok && length(getTranslation(nlerp(da, db, 1.0)) - vec3(-4, 0, 2)) < 1e-12;
+
+        // batch versions against scalar, with a tail and in-place output
+        const size_t n = 21;
+        std::vector<quatf> a(n), b(n), out(n);
+        std::vector<dualquatf> dqa(n), dqb(n), dqout(n);
+        std::vector<float> t(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            a[i] = quatRotation(i * 17.0f, 1.0f, i - 5.0f, 2.0f);
+            b[i] = quatRotation(i * -23.0f + 90.0f, 0.0f, 1.0f, i * 0.1f);
+            b[i] = (i % 3 == 0) ? -b[i] : b[i];
+            t[i] = i / (n - 1.0f);
+            dqa[i] = dualquatf(a[i], vec3f(i * 1.0f, 0.0f, 1.0f));
+            dqb[i] = dualquatf(b[i], vec3f(0.0f, -1.0f, i * 0.5f));
+        }
+        slerp(a.data(), b.data(), t.data(), out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            ok = ok && length(out[i] - slerp(a[i], b[i], t[i])) < 1e-5f;
+        }
+        nlerp(a.data(), b.data(), 0.25f, out.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            ok = ok && length(out[i] - nlerp(a[i], b[i], 0.25f)) < 1e-5f;
+        slerp(a.data(), b.data(), 1.0f, a.data(), n);
+        for (size_t i = 0; i < n; ++i)
+            ok = ok && fabs(fabs(dot(a[i], b[i])) - 1) < 1e-5f;
+        nlerp(dqa.data(), dqb.data(), t.data(), dqout.data(), n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            const dualquatf r = nlerp(dqa[i], dqb[i], t[i]);
+            const vec3f p(1, 2, 3);
+            ok = ok && length(transformPoint(dqout[i], p) - transformPoint(r, p)) < 1e-4f;
+        }
+        assertTest(ok);
+    }
+    {
+        // Mesh optimizer on a UV sphere with row-major quads (as genGridIndices):
+        // same triangles with the same winding, better ACMR, first-use vertex order.
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+        uvSphere(48, 24, vertices, indices, false);
+        const size_t vertexCount = vertices.size() / 4;
+        const std::vector<uint64_t> reference = canonicalTriangles(indices);
+
+        const float acmr = vertexCacheAcmr(indices.data(), indices.size(), vertexCount);
+        std::vector<uint32_t> opt(indices.size());
+        optimizeVertexCache(opt.data(), indices.data(), indices.size(), vertexCount);
+        const float acmrCache = vertexCacheAcmr(opt.data(), opt.size(), vertexCount);
+        bool ok = acmr > 0.95f && acmrCache < 0.8f && canonicalTriangles(opt) == reference;
+        optimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount);
+        ok = ok && indices == opt;
+
+        optimizeOverdraw(opt.data(), opt.size(), vertices.data(), 4, vertexCount, 1.05f);
+        const float acmrOverdraw = vertexCacheAcmr(opt.data(), opt.size(), vertexCount);
+        ok = ok && canonicalTriangles(opt) == reference && opt != indices && acmrOverdraw < acmrCache * 1.1f;
+
+        std::vector<uint32_t> fetch = opt;
+        std::vector<float> fetched = vertices;
+        vertices.resize(4 * (vertexCount + 5), -1.0f); // unreferenced tail is dropped
+        fetched.resize(vertices.size(), -1.0f);
+        const size_t kept = optimizeVertexFetch(fetched.data(), fetch.data(), fetch.size(), vertexCount + 5,
+            4 * sizeof(float));
+        ok = ok && kept == vertexCount && fetch[0] == 0;
+        for (size_t i = 0, next = 0; i < fetch.size(); ++i)
+        {
+            ok = ok && fetch[i] <= next && fetched[4 * fetch[i] + 3] == vertices[4 * opt[i] + 3];
+            next = std::max<size_t>(next, fetch[i] + 1);
+        }
+        assertTest(ok);
+    }
+    {
+        // Welding a unit cube of 6 quads (24 corners, position + normal).
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+        for (int axis = 0; axis < 3; ++axis)
+            for (int side = 0; side < 2; ++side)
+            {
+                const uint32_t base = static_cast<uint32_t>(vertices.size() / 6);
+                for (int k = 0; k < 4; ++k)
+                {
+                    float v[6] = { 0, 0, 0, 0, 0, 0 };
+                    v[axis] = static_cast<float>(side);
+                    v[(axis + 1) % 3] = static_cast<float>(k == 1 || k == 2);
+                    v[(axis + 2) % 3] = static_cast<float>(k >= 2);
+                    v[3 + axis] = side ? 1.0f : -1.0f;
+                    // jitter well below the position epsilon
+                    v[0] += (k & 1) ? 1e-6f : -1e-6f;
+                    vertices.insert(vertices.end(), v, v + 6);
+                }
+                const uint32_t q[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+                indices.insert(indices.end(), q, q + 6);
+            }
+        std::vector<float> positions;
+        for (size_t i = 0; i < indices.size(); ++i)
+            positions.insert(positions.end(), &vertices[6 * indices[i]], &vertices[6 * indices[i]] + 3);
+
+        // position and normal: nothing to share between faces
+        const float withNormals[6] = { 1e-3f, 1e-3f, 1e-3f, 0, 0, 0 };
+        std::vector<float> welded = vertices;
+        std::vector<uint32_t> weldedIndices = indices;
+        bool ok = weldVertices(welded.data(), 6, weldedIndices.data(), weldedIndices.size(), 24, withNormals) == 24;
+        // positions only (stride 6, normals ignored by a huge epsilon): 8 corners
+        const float positionsOnly[6] = { 1e-3f, 1e-3f, 1e-3f, 4, 4, 4 };
+        const size_t kept = weldVertices(welded.data(), 6, weldedIndices.data(), weldedIndices.size(), 24,
+            positionsOnly);
+        ok = ok && kept == 8;
+        for (size_t i = 0; i < indices.size(); ++i)
+            for (int c = 0; c < 3; ++c)
+                ok = ok && weldedIndices[i] < kept && fabsf(welded[6 * weldedIndices[i] + c] - positions[3 * i + c]) < 1e-5f;
+        // bit-exact welding keeps the jittered corners apart
+        const float exact[6] = { 0, 0, 0, 4, 4, 4 };
+        welded = vertices;
+        weldedIndices = indices;
+        ok = ok && weldVertices(welded.data(), 6, weldedIndices.data(), weldedIndices.size(), 24, exact) > 8;
+        assertTest(ok);
+    }
+    {
+        // Meshlets of a UV sphere: all triangles kept, size limits, bounds
+        // containing their triangles, and cone culling only where every
+        // triangle really faces away.
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+        uvSphere(64, 32, vertices, indices);
+        const size_t vertexCount = vertices.size() / 4;
+        auto corner = [&vertices](uint32_t v) { return vec3f(vertices[4 * v], vertices[4 * v + 1], vertices[4 * v + 2]); };
+        const std::vector<uint64_t> reference = canonicalTriangles(indices);
+        std::vector<Meshlet> meshlets;
+        buildMeshlets(indices.data(), indices.size(), vertices.data(), 4, vertexCount, meshlets, 96, 64);
+        bool ok = canonicalTriangles(indices) == reference && meshlets.size() >= indices.size() / (3 * 96);
+        ok = ok && meshlets.size() < indices.size() / (3 * 48);
+        const vec3f eyes[3] = { vec3f(3, 0, 0), vec3f(0.5f, -1.5f, 1), vec3f(0, 0, -10) };
+        size_t next = 0, backFacing = 0;
+        for (const Meshlet& m : meshlets)
+        {
+            ok = ok && m.firstIndex == next && m.indexCount % 3 == 0 && m.indexCount <= 3 * 96 && m.vertexCount <= 64;
+            next += m.indexCount;
+            for (uint32_t i = m.firstIndex; i < m.firstIndex + m.indexCount; ++i)
+                ok = ok && length(corner(indices[i]) - vec3f(m.sphere)) <= m.sphere.w * 1.0001f;
+            for (const vec3f& eye : eyes)
+            {
+                if (!isBackFacing(m, eye))
+                    continue;
+                ++backFacing;
+                for (uint32_t i = m.firstIndex; i < m.firstIndex + m.indexCount; i += 3)
+                {
+                    const vec3f a = corner(indices[i]), b = corner(indices[i + 1]), c = corner(indices[i + 2]);
+                    ok = ok && dot(cross(b - a, c - a), a - eye) >= 0;
+                }
+            }
+        }
+        ok = ok && next == indices.size() && backFacing > meshlets.size() / 2;
+        assertTest(ok);
+    }
+    {
+        // Simplifying a flat 16 x 16 grid keeps its square outline exactly
+        // and turns no triangle over, down to the 2 triangles of the square.
+        const uint32_t n = 16;
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+        for (uint32_t y = 0; y <= n; ++y)
+            for (uint32_t x = 0; x <= n; ++x)
+            {
+                const float v[3] = { static_cast<float>(x), static_cast<float>(y), 0 };
+                vertices.insert(vertices.end(), v, v + 3);
+            }
+        for (uint32_t y = 0, v = 0; y < n; ++y, ++v)
+            for (uint32_t x = 0; x < n; ++x, ++v)
+            {
+                const uint32_t q[6] = { v, v + 1, v + n + 2, v, v + n + 2, v + n + 1 };
+                indices.insert(indices.end(), q, q + 6);
+            }
+        auto corner = [&vertices](uint32_t v) { return vec3f(vertices[3 * v], vertices[3 * v + 1], vertices[3 * v + 2]); };
+        std::vector<uint32_t> simplified(indices.size());
+        float error = -1;
+        const size_t count = simplify(simplified.data(), indices.data(), indices.size(), vertices.data(), 3,
+            vertices.size() / 3, 0, 1e-3f, &error);
+        bool ok = count == 6 && error == 0;
+        float area = 0;
+        for (size_t i = 0; i < count; i += 3)
+        {
+            const vec3f a = corner(simplified[i]), b = corner(simplified[i + 1]), c = corner(simplified[i + 2]);
+            ok = ok && cross(b - a, c - a).z > 0;
+            area += cross(b - a, c - a).z * 0.5f;
+        }
+        ok = ok && area == n * n;
+
+        // A UV sphere halved and halved again: the error grows, stays well
+        // under the radius, and the error limit stops the simplification.
+        vertices.clear();
+        indices.clear();
+        uvSphere(64, 32, vertices, indices);
+        const size_t vertexCount = vertices.size() / 4;
+        simplified.resize(indices.size());
+        float halfError = 0, quarterError = 0;
+        ok = ok && simplify(simplified.data(), indices.data(), indices.size(), vertices.data(), 4, vertexCount,
+            indices.size() / 2, 1.0f, &halfError) <= indices.size() / 2;
+        ok = ok && simplify(simplified.data(), indices.data(), indices.size(), vertices.data(), 4, vertexCount,
+            indices.size() / 4, 1.0f, &quarterError) <= indices.size() / 4;
+        ok = ok && halfError > 0 && halfError < quarterError && quarterError < 0.1f;
+        ok = ok && simplify(simplified.data(), indices.data(), indices.size(), vertices.data(), 4, vertexCount,
+            indices.size() / 4, 1e-3f, &error) > indices.size() / 2 && error <= 1e-3f;
+        for (size_t i = 0; i < indices.size() / 4; ++i)
+            ok = ok && simplified[i] < vertexCount;
+        assertTest(ok);
+    }
 }
 #endif
 
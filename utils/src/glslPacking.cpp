@@ -0,0 +1,310 @@
+// GLSL-like math library - packed vertex attribute formats
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <glslPacking.h>
+#include <glslMathPacket.h>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace glsl_math
+{
+
+#if GlslMathSimd
+static inline __m128i set1(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+
+// round(clamp(f, -1, 1) * scale), same as packSnorm()
+static inline __m128i packSnorm(__m128 f, __m128 scale)
+{
+    return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(f, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f)), scale));
+}
+
+// max(c * scale, -1), same as unpackSnorm8/16()
+static inline __m128 unpackSnorm(__m128i c, __m128 scale)
+{
+    return _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(c), scale), _mm_set1_ps(-1.0f));
+}
+
+// Low 16 bits of each lane, without the signed saturation of packs.
+static inline __m128i pack16(__m128i a, __m128i b)
+{
+    return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+}
+
+// Same steps as packHalf(float), on 4 lanes.
+static inline __m128i packHalf(__m128 f)
+{
+    const __m128 sign = _mm_and_ps(f, _mm_castsi128_ps(set1(0x80000000u)));
+    const __m128 a = _mm_xor_ps(f, sign);
+    const __m128i ai = _mm_castps_si128(a);
+    const __m128i regular = _mm_cmpgt_epi32(set1(143u << 23), ai);
+    const __m128i subnormal = _mm_cmpgt_epi32(set1(113u << 23), ai);
+    const __m128i payload = _mm_or_si128(set1(0x200), _mm_and_si128(_mm_srli_epi32(ai, 13), set1(0x3ff)));
+    const __m128i infNan = _mm_or_si128(set1(0x7c00),
+        _mm_and_si128(_mm_castps_si128(_mm_cmpunord_ps(a, a)), payload));
+    const __m128i sub = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(a, _mm_set1_ps(0.5f))), set1(126u << 23));
+    const __m128i odd = _mm_srli_epi32(_mm_slli_epi32(ai, 18), 31);
+    const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(ai, set1(((15u - 127u) << 23) + 0xfff)), odd), 13);
+    __m128i h = _mm_or_si128(_mm_and_si128(subnormal, sub), _mm_andnot_si128(subnormal, normal));
+    h = _mm_or_si128(_mm_and_si128(regular, h), _mm_andnot_si128(regular, infNan));
+    return _mm_or_si128(h, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+}
+
+// Same result as unpackHalf(uint16_t): scaling by 2^112 rebiases normal
+// and subnormal halves at once, inf/NaN get the full exponent and NaNs the
+// quiet bit.
+static inline __m128 unpackHalf(__m128i h)
+{
+    const __m128i em = _mm_and_si128(h, set1(0x7fff));
+    const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(em, 13)), _mm_set1_ps(5.19229686e+33f));
+    const __m128i infNan = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi32(em, set1(0x7bff)), set1(255u << 23)),
+        _mm_and_si128(_mm_cmpgt_epi32(em, set1(0x7c00)), set1(0x400000)));
+    const __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, em), 16);
+    return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNan)));
+}
+#endif
+
+void packHalf(const float* src, uint16_t* dst, size_t count)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+            _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#elif GlslMathSimd
+    for (; i + 8 <= count; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+            pack16(packHalf(_mm_loadu_ps(src + i)), packHalf(_mm_loadu_ps(src + i + 4))));
+#endif
+    for (; i < count; ++i)
+        dst[i] = packHalf(src[i]);
+}
+
+void unpackHalf(const uint16_t* src, float* dst, size_t count)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+#elif GlslMathSimd
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_ps(dst + i, unpackHalf(_mm_unpacklo_epi16(h, zero)));
+        _mm_storeu_ps(dst + i + 4, unpackHalf(_mm_unpackhi_epi16(h, zero)));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = unpackHalf(src[i]);
+}
+
+void packSnorm8(const float* src, int8_t* dst, size_t count)
+{
+    size_t i = 0;
+#if GlslMathSimd
+    const __m128 scale = _mm_set1_ps(127.0f);
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i lo = _mm_packs_epi32(packSnorm(_mm_loadu_ps(src + i), scale), packSnorm(_mm_loadu_ps(src + i + 4), scale));
+        const __m128i hi = _mm_packs_epi32(packSnorm(_mm_loadu_ps(src + i + 8), scale), packSnorm(_mm_loadu_ps(src + i + 12), scale));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi16(lo, hi));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = packSnorm8(src[i]);
+}
+
+void unpackSnorm8(const int8_t* src, float* dst, size_t count)
+{
+    size_t i = 0;
+#if GlslMathSimd
+    const __m128 scale = _mm_set1_ps(1.0f / 127.0f);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        // sign extend by moving each byte to the top and shifting back
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i lo = _mm_unpacklo_epi8(zero, c);
+        const __m128i hi = _mm_unpackhi_epi8(zero, c);
+        _mm_storeu_ps(dst + i, unpackSnorm(_mm_srai_epi32(_mm_unpacklo_epi16(zero, lo), 24), scale));
+        _mm_storeu_ps(dst + i + 4, unpackSnorm(_mm_srai_epi32(_mm_unpackhi_epi16(zero, lo), 24), scale));
+        _mm_storeu_ps(dst + i + 8, unpackSnorm(_mm_srai_epi32(_mm_unpacklo_epi16(zero, hi), 24), scale));
+        _mm_storeu_ps(dst + i + 12, unpackSnorm(_mm_srai_epi32(_mm_unpackhi_epi16(zero, hi), 24), scale));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = unpackSnorm8(src[i]);
+}
+
+void packSnorm16(const float* src, int16_t* dst, size_t count)
+{
+    size_t i = 0;
+#if GlslMathSimd
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+            _mm_packs_epi32(packSnorm(_mm_loadu_ps(src + i), scale), packSnorm(_mm_loadu_ps(src + i + 4), scale)));
+#endif
+    for (; i < count; ++i)
+        dst[i] = packSnorm16(src[i]);
+}
+
+void unpackSnorm16(const int16_t* src, float* dst, size_t count)
+{
+    size_t i = 0;
+#if GlslMathSimd
+    const __m128 scale = _mm_set1_ps(1.0f / 32767.0f);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_ps(dst + i, unpackSnorm(_mm_srai_epi32(_mm_unpacklo_epi16(zero, c), 16), scale));
+        _mm_storeu_ps(dst + i + 4, unpackSnorm(_mm_srai_epi32(_mm_unpackhi_epi16(zero, c), 16), scale));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = unpackSnorm16(src[i]);
+}
+
+void packInt2101010Rev(const float* src, size_t stride, size_t components, uint32_t* dst, size_t count)
+{
+    size_t i = 0;
+#if GlslMathSimd
+    const __m128 scale = _mm_set1_ps(511.0f);
+    const __m128i mask = set1(0x3ff);
+    for (; i + 4 <= count; i += 4)
+    {
+        const float* s = src + i * stride;
+        __m128 x, y, z, w;
+        if (components == 4)
+        {
+            x = _mm_loadu_ps(s);
+            y = _mm_loadu_ps(s + stride);
+            z = _mm_loadu_ps(s + 2 * stride);
+            w = _mm_loadu_ps(s + 3 * stride);
+        }
+        else
+        {
+            x = _mm_setr_ps(s[0], s[1], s[2], 1.0f);
+            y = _mm_setr_ps(s[stride], s[stride + 1], s[stride + 2], 1.0f);
+            z = _mm_setr_ps(s[2 * stride], s[2 * stride + 1], s[2 * stride + 2], 1.0f);
+            w = _mm_setr_ps(s[3 * stride], s[3 * stride + 1], s[3 * stride + 2], 1.0f);
+        }
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        __m128i p = _mm_and_si128(packSnorm(x, scale), mask);
+        p = _mm_or_si128(p, _mm_slli_epi32(_mm_and_si128(packSnorm(y, scale), mask), 10));
+        p = _mm_or_si128(p, _mm_slli_epi32(_mm_and_si128(packSnorm(z, scale), mask), 20));
+        p = _mm_or_si128(p, _mm_slli_epi32(packSnorm(w, _mm_set1_ps(1.0f)), 30));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), p);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const float* s = src + i * stride;
+        dst[i] = packInt2101010Rev(vec4f(s[0], s[1], s[2], (components == 4) ? s[3] : 1.0f));
+    }
+}
+
+void unpackInt2101010Rev(const uint32_t* src, float* dst, size_t stride, size_t components, size_t count)
+{
+    size_t i = 0;
+#if GlslMathSimd
+    const __m128 scale = _mm_set1_ps(1.0f / 511.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128 x = unpackSnorm(_mm_srai_epi32(_mm_slli_epi32(p, 22), 22), scale);
+        __m128 y = unpackSnorm(_mm_srai_epi32(_mm_slli_epi32(p, 12), 22), scale);
+        __m128 z = unpackSnorm(_mm_srai_epi32(_mm_slli_epi32(p, 2), 22), scale);
+        __m128 w = unpackSnorm(_mm_srai_epi32(p, 30), _mm_set1_ps(1.0f));
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        const __m128 v[4] = { x, y, z, w };
+        float* d = dst + i * stride;
+        for (int k = 0; k < 4; ++k, d += stride)
+        {
+            if (components == 4)
+                _mm_storeu_ps(d, v[k]);
+            else
+            {
+                float t[4];
+                _mm_storeu_ps(t, v[k]);
+                d[0] = t[0];
+                d[1] = t[1];
+                d[2] = t[2];
+            }
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const vec4f v = unpackInt2101010Rev(src[i]);
+        float* d = dst + i * stride;
+        d[0] = v.x;
+        d[1] = v.y;
+        d[2] = v.z;
+        if (components == 4)
+            d[3] = v.w;
+    }
+}
+
+// Branch-free octEncode/octDecode on 8 lanes.
+static inline floatx8 signNotZero(const floatx8& v)
+{
+    return select(v >= floatx8(0.0f), floatx8(1.0f), floatx8(-1.0f));
+}
+
+void packOctahedral(const float* src, size_t stride, int16_t* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i += floatx8::size)
+    {
+        const size_t n = min(count - i, static_cast<size_t>(floatx8::size));
+        vec3x8 v;
+        gather(v, src + i * stride, stride, n);
+        const floatx8 d = abs(v.x) + abs(v.y) + abs(v.z);
+        const floatx8 s = select(d > floatx8(0.0f), floatx8(1.0f) / d, floatx8(0.0f));
+        const floatx8 x = v.x * s, y = v.y * s;
+        const maskx8 lower = v.z >= floatx8(0.0f);
+        const vec2x8 e(
+            select(lower, x, (floatx8(1.0f) - abs(y)) * signNotZero(x)),
+            select(lower, y, (floatx8(1.0f) - abs(x)) * signNotZero(y)));
+        float t[2 * floatx8::size];
+        scatter(e, t, 2, n);
+        packSnorm16(t, dst + 2 * i, 2 * n);
+    }
+}
+
+void unpackOctahedral(const int16_t* src, float* dst, size_t stride, size_t count)
+{
+    for (size_t i = 0; i < count; i += floatx8::size)
+    {
+        const size_t n = min(count - i, static_cast<size_t>(floatx8::size));
+        float t[2 * floatx8::size];
+        unpackSnorm16(src + 2 * i, t, 2 * n);
+        vec2x8 e;
+        gather(e, t, 2, n);
+        const floatx8 z = floatx8(1.0f) - abs(e.x) - abs(e.y);
+        const maskx8 lower = z >= floatx8(0.0f);
+        const vec3x8 v(
+            select(lower, e.x, (floatx8(1.0f) - abs(e.y)) * signNotZero(e.x)),
+            select(lower, e.y, (floatx8(1.0f) - abs(e.x)) * signNotZero(e.y)),
+            z);
+        scatter(normalize(v), dst + i * stride, stride, n);
+    }
+}
+
+} // namespace glsl_math
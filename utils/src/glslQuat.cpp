@@ -0,0 +1,136 @@
+// GLSL-like math library - batch quaternion interpolation
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <glslQuat.h>
+#include <glslFastMath.h>
+#include <threadPool.h>
+
+namespace glsl_math
+{
+
+// Below this many quaternions the threading overhead is not worth it.
+static constexpr size_t parallelThreshold = 1 << 14;
+static constexpr size_t parallelGrain = 1 << 12;
+
+static floatx8 loadT(float t, size_t, size_t)
+{
+    return floatx8(t);
+}
+
+static floatx8 loadT(const float* t, size_t i, size_t n)
+{
+    if (n == floatx8::size)
+        return floatx8::load(t + i);
+    float lanes[floatx8::size] = {};
+    for (size_t k = 0; k < n; ++k)
+        lanes[k] = t[i + k];
+    return floatx8::load(lanes);
+}
+
+// Weights of a and b for slerp; b is flipped to the shorter arc by the caller.
+static void slerpWeights(const floatx8& c, const floatx8& t, floatx8& wa, floatx8& wb)
+{
+    const floatx8 theta = fast::acos(c);
+    const floatx8 s = sqrt(max(floatx8(1.0f) - c * c, floatx8(0.0f)));
+    const floatx8 is = floatx8(1.0f) / s;
+    // nearly parallel: sin(x*theta)/sin(theta) -> x
+    const maskx8 small = s < floatx8(1e-4f);
+    const floatx8 ta = floatx8(1.0f) - t;
+    wa = select(small, ta, fast::sin(ta * theta) * is);
+    wb = select(small, t, fast::sin(t * theta) * is);
+}
+
+template <bool Slerp, typename TT>
+static void interpolateQuats(const quatf* a, const quatf* b, TT t, quatf* out, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i += floatx8::size)
+    {
+        const size_t n = min(end - i, static_cast<size_t>(floatx8::size));
+        vec4x8 qa, qb;
+        gather(qa, &a[i].x, 4, n);
+        gather(qb, &b[i].x, 4, n);
+        const floatx8 ti = loadT(t, i, n);
+        const floatx8 c = dot(qa, qb);
+        const floatx8 sb = select(c < floatx8(0.0f), floatx8(-1.0f), floatx8(1.0f));
+        floatx8 wa = floatx8(1.0f) - ti, wb = ti;
+        if (Slerp)
+            slerpWeights(c * sb, ti, wa, wb);
+        scatter(fast::normalize(qa * wa + qb * (wb * sb)), &out[i].x, 4, n);
+    }
+}
+
+template <typename TT>
+static void interpolateDualQuats(const dualquatf* a, const dualquatf* b, TT t, dualquatf* out, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i += floatx8::size)
+    {
+        const size_t n = min(end - i, static_cast<size_t>(floatx8::size));
+        vec4x8 ra, da, rb, db;
+        gather(ra, &a[i].real.x, 8, n);
+        gather(da, &a[i].dual.x, 8, n);
+        gather(rb, &b[i].real.x, 8, n);
+        gather(db, &b[i].dual.x, 8, n);
+        const floatx8 ti = loadT(t, i, n);
+        const floatx8 wa = floatx8(1.0f) - ti;
+        const floatx8 wb = select(dot(ra, rb) < floatx8(0.0f), -ti, ti);
+        const vec4x8 r = ra * wa + rb * wb;
+        const vec4x8 d = da * wa + db * wb;
+        // same as normalize(tdualquat)
+        const floatx8 f = fast::inverseLength<fast::Medium>(dot(r, r));
+        const vec4x8 rn = r * f;
+        const vec4x8 dn = d * f;
+        scatter(rn, &out[i].real.x, 8, n);
+        scatter(dn - rn * dot(rn, dn), &out[i].dual.x, 8, n);
+    }
+}
+
+void slerp(const quatf* a, const quatf* b, float t, quatf* out, size_t count)
+{
+    ThreadPool::global().parallelFor(count, parallelGrain, parallelThreshold,
+        [&](size_t begin, size_t end) { interpolateQuats<true>(a, b, t, out, begin, end); });
+}
+
+void slerp(const quatf* a, const quatf* b, const float* t, quatf* out, size_t count)
+{
+    ThreadPool::global().parallelFor(count, parallelGrain, parallelThreshold,
+        [&](size_t begin, size_t end) { interpolateQuats<true>(a, b, t, out, begin, end); });
+}
+
+void nlerp(const quatf* a, const quatf* b, float t, quatf* out, size_t count)
+{
+    ThreadPool::global().parallelFor(count, parallelGrain, parallelThreshold,
+        [&](size_t begin, size_t end) { interpolateQuats<false>(a, b, t, out, begin, end); });
+}
+
+void nlerp(const quatf* a, const quatf* b, const float* t, quatf* out, size_t count)
+{
+    ThreadPool::global().parallelFor(count, parallelGrain, parallelThreshold,
+        [&](size_t begin, size_t end) { interpolateQuats<false>(a, b, t, out, begin, end); });
+}
+
+void nlerp(const dualquatf* a, const dualquatf* b, float t, dualquatf* out, size_t count)
+{
+    ThreadPool::global().parallelFor(count, parallelGrain, parallelThreshold,
+        [&](size_t begin, size_t end) { interpolateDualQuats(a, b, t, out, begin, end); });
+}
+
+void nlerp(const dualquatf* a, const dualquatf* b, const float* t, dualquatf* out, size_t count)
+{
+    ThreadPool::global().parallelFor(count, parallelGrain, parallelThreshold,
+        [&](size_t begin, size_t end) { interpolateDualQuats(a, b, t, out, begin, end); });
+}
+
+} // namespace glsl_math
@@ -0,0 +1,782 @@
+// Triangle mesh optimization
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <meshOptimizer.h>
+#include <glslMath.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace glsl_math;
+
+static const uint32_t NoVertex = ~0u;
+
+// Triangles around each vertex: those of v are triangles[offsets[v]] to
+// triangles[offsets[v + 1] - 1], once per corner.
+static void buildVertexTriangles(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    std::vector<uint32_t>& offsets, std::vector<uint32_t>& triangles)
+{
+    offsets.assign(vertexCount + 1, 0);
+    triangles.resize(indexCount);
+    for (size_t i = 0; i < indexCount; ++i)
+        ++offsets[indices[i] + 1];
+    for (size_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indexCount; ++i)
+        triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+}
+
+// Cell of f for weldVertices, bits of f for epsilon 0.
+static uint32_t quantize(float f, float epsilon)
+{
+    if (epsilon <= 0)
+    {
+        uint32_t u;
+        memcpy(&u, &f, sizeof(u));
+        return u;
+    }
+    const float q = floorf(f / epsilon + 0.5f);
+    return static_cast<uint32_t>(static_cast<int32_t>(std::min(std::max(q, -2147483648.0f), 2147483520.0f)));
+}
+
+size_t weldVertices(float* vertices, size_t stride, uint32_t* indices, size_t indexCount, size_t vertexCount,
+    const float* epsilons)
+{
+    std::vector<uint32_t> keys(vertexCount * stride);
+    for (size_t v = 0; v < vertexCount; ++v)
+        for (size_t c = 0; c < stride; ++c)
+            keys[v * stride + c] = quantize(vertices[v * stride + c], epsilons[c]);
+
+    // Open addressing, at most half full.
+    size_t tableSize = 16;
+    while (tableSize < 2 * vertexCount)
+        tableSize *= 2;
+    std::vector<uint32_t> table(tableSize, NoVertex);
+    std::vector<uint32_t> remap(vertexCount);
+    uint32_t next = 0;
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        const uint32_t* key = &keys[v * stride];
+        uint32_t hash = 2166136261u;
+        for (size_t c = 0; c < stride; ++c)
+            hash = (hash ^ key[c]) * 16777619u;
+        hash ^= hash >> 15;
+        size_t slot = hash & (tableSize - 1);
+        while (table[slot] != NoVertex && memcmp(&keys[table[slot] * stride], key, sizeof(uint32_t) * stride))
+            slot = (slot + 1) & (tableSize - 1);
+        if (table[slot] != NoVertex)
+        {
+            remap[v] = remap[table[slot]];
+            continue;
+        }
+        table[slot] = static_cast<uint32_t>(v);
+        remap[v] = next;
+        if (next != v)
+            memcpy(vertices + next * stride, vertices + v * stride, sizeof(float) * stride);
+        ++next;
+    }
+    for (size_t i = 0; i < indexCount; ++i)
+        indices[i] = remap[indices[i]];
+    return next;
+}
+
+float vertexCacheAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return 0;
+    // A vertex is cached while fewer than cacheSize misses happened since
+    // its own miss.
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    size_t misses = 0;
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+    {
+        const uint32_t v = indices[i];
+        if (time - timestamps[v] > cacheSize)
+        {
+            timestamps[v] = time++;
+            ++misses;
+        }
+    }
+    return static_cast<float>(misses) / triangleCount;
+}
+
+void optimizeVertexCache(uint32_t* dst, const uint32_t* src, size_t indexCount, size_t vertexCount,
+    unsigned cacheSize)
+{
+    const size_t triangleCount = indexCount / 3;
+    const std::vector<uint32_t> input(src, src + triangleCount * 3);
+    std::vector<uint32_t> offsets, triangles;
+    buildVertexTriangles(input.data(), input.size(), vertexCount, offsets, triangles);
+
+    std::vector<uint32_t> live(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        live[v] = offsets[v + 1] - offsets[v];
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd, candidates;
+    deadEnd.reserve(input.size());
+    uint32_t time = cacheSize + 1;
+    size_t cursor = 0, out = 0;
+
+    uint32_t fan = NoVertex;
+    while (cursor < vertexCount && !live[cursor])
+        ++cursor;
+    if (cursor < vertexCount)
+        fan = static_cast<uint32_t>(cursor);
+    while (fan != NoVertex)
+    {
+        // Emit all remaining triangles around fan.
+        candidates.clear();
+        for (uint32_t k = offsets[fan]; k < offsets[fan + 1]; ++k)
+        {
+            const uint32_t t = triangles[k];
+            if (emitted[t])
+                continue;
+            emitted[t] = 1;
+            for (int c = 0; c < 3; ++c)
+            {
+                const uint32_t v = input[3 * t + c];
+                dst[out++] = v;
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - timestamps[v] > cacheSize)
+                    timestamps[v] = time++;
+            }
+        }
+
+        // Next fan: the oldest candidate that stays cached while its own
+        // triangles are emitted, else any live one.
+        fan = NoVertex;
+        int bestPriority = -1;
+        for (const uint32_t v : candidates)
+        {
+            if (!live[v])
+                continue;
+            int priority = 0;
+            if (time - timestamps[v] + 2 * live[v] <= cacheSize)
+                priority = static_cast<int>(time - timestamps[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fan = v;
+            }
+        }
+        if (fan != NoVertex)
+            continue;
+
+        // Dead end: the most recent vertex still having triangles, then
+        // the first one in input order.
+        while (!deadEnd.empty() && fan == NoVertex)
+        {
+            if (live[deadEnd.back()])
+                fan = deadEnd.back();
+            deadEnd.pop_back();
+        }
+        while (fan == NoVertex && cursor < vertexCount)
+        {
+            if (live[cursor])
+                fan = static_cast<uint32_t>(cursor);
+            ++cursor;
+        }
+    }
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t stride,
+    size_t vertexCount, float threshold, unsigned cacheSize)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Cache misses of each triangle in the current order.
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    std::vector<uint8_t> misses(triangleCount, 0);
+    size_t totalMisses = 0;
+    for (size_t t = 0; t < triangleCount; ++t)
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t v = indices[3 * t + c];
+            if (time - timestamps[v] > cacheSize)
+            {
+                timestamps[v] = time++;
+                ++misses[t];
+                ++totalMisses;
+            }
+        }
+    const float acmrLimit = threshold * totalMisses / triangleCount;
+
+    // Hard boundaries where a triangle misses all 3 vertices (a jump to
+    // cold vertices), soft ones where a cluster drawn with a cold cache
+    // would still be within acmrLimit.
+    std::vector<size_t> clusters;
+    size_t clusterStart = 0, clusterMisses = 0;
+    time += cacheSize + 1;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        if (t > clusterStart && misses[t] == 3)
+        {
+            clusters.push_back(clusterStart);
+            clusterStart = t;
+            clusterMisses = 0;
+            time += cacheSize + 1;
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t v = indices[3 * t + c];
+            if (time - timestamps[v] > cacheSize)
+            {
+                timestamps[v] = time++;
+                ++clusterMisses;
+            }
+        }
+        if (t + 1 < triangleCount && clusterMisses <= acmrLimit * (t + 1 - clusterStart))
+        {
+            clusters.push_back(clusterStart);
+            clusterStart = t + 1;
+            clusterMisses = 0;
+            time += cacheSize + 1;
+        }
+    }
+    clusters.push_back(clusterStart);
+    clusters.push_back(triangleCount);
+    const size_t clusterCount = clusters.size() - 1;
+    if (clusterCount < 2)
+        return;
+
+    // Area weighted centroids and normals of the clusters and the mesh.
+    std::vector<vec3f> centroids(clusterCount, vec3f(0)), normals(clusterCount, vec3f(0));
+    std::vector<float> areas(clusterCount, 0);
+    vec3f meshCentroid(0);
+    float meshArea = 0;
+    for (size_t k = 0; k < clusterCount; ++k)
+    {
+        for (size_t t = clusters[k]; t < clusters[k + 1]; ++t)
+        {
+            const float* p0 = positions + stride * indices[3 * t];
+            const float* p1 = positions + stride * indices[3 * t + 1];
+            const float* p2 = positions + stride * indices[3 * t + 2];
+            const vec3f a(p0[0], p0[1], p0[2]), b(p1[0], p1[1], p1[2]), c(p2[0], p2[1], p2[2]);
+            const vec3f n = cross(b - a, c - a);
+            const float area = length(n);
+            centroids[k] += (a + b + c) * (area / 3);
+            normals[k] += n;
+            areas[k] += area;
+        }
+        meshCentroid += centroids[k];
+        meshArea += areas[k];
+        if (areas[k] > 0)
+            centroids[k] /= areas[k];
+    }
+    if (meshArea > 0)
+        meshCentroid /= meshArea;
+
+    std::vector<float> keys(clusterCount);
+    for (size_t k = 0; k < clusterCount; ++k)
+    {
+        const float len = length(normals[k]);
+        keys[k] = (len > 0) ? dot(centroids[k] - meshCentroid, normals[k]) / len : 0;
+    }
+    std::vector<uint32_t> order(clusterCount);
+    for (size_t k = 0; k < clusterCount; ++k)
+        order[k] = static_cast<uint32_t>(k);
+    std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    const std::vector<uint32_t> input(indices, indices + triangleCount * 3);
+    size_t out = 0;
+    for (const uint32_t k : order)
+    {
+        const size_t count = 3 * (clusters[k + 1] - clusters[k]);
+        memcpy(indices + out, input.data() + 3 * clusters[k], sizeof(uint32_t) * count);
+        out += count;
+    }
+}
+
+size_t optimizeVertexFetch(void* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount,
+    size_t vertexSize)
+{
+    std::vector<uint32_t> remap(vertexCount, NoVertex);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t& r = remap[indices[i]];
+        if (r == NoVertex)
+            r = next++;
+        indices[i] = r;
+    }
+
+    char* data = static_cast<char*>(vertices);
+    const std::vector<char> input(data, data + vertexCount * vertexSize);
+    for (size_t v = 0; v < vertexCount; ++v)
+        if (remap[v] != NoVertex)
+            memcpy(data + remap[v] * vertexSize, input.data() + v * vertexSize, vertexSize);
+    return next;
+}
+
+static vec3f position(const float* positions, size_t stride, uint32_t v)
+{
+    const float* p = positions + stride * v;
+    return vec3f(p[0], p[1], p[2]);
+}
+
+static void meshletBounds(Meshlet& m, const uint32_t* indices, const float* positions, size_t stride)
+{
+    const uint32_t* tri = indices + m.firstIndex;
+    vec3f lo(position(positions, stride, tri[0])), hi(lo);
+    vec3f normalSum(0);
+    for (uint32_t i = 0; i < m.indexCount; i += 3)
+    {
+        const vec3f a = position(positions, stride, tri[i]);
+        const vec3f b = position(positions, stride, tri[i + 1]);
+        const vec3f c = position(positions, stride, tri[i + 2]);
+        lo = min(lo, min(a, min(b, c)));
+        hi = max(hi, max(a, max(b, c)));
+        const vec3f n = cross(b - a, c - a);
+        const float len = length(n);
+        if (len > 0)
+            normalSum += n / len;
+    }
+
+    const vec3f center = (lo + hi) * 0.5f;
+    float radius = 0;
+    for (uint32_t i = 0; i < m.indexCount; ++i)
+        radius = std::max(radius, length(position(positions, stride, tri[i]) - center));
+    m.sphere = vec4f(center, radius);
+
+    const float sumLength = length(normalSum);
+    m.cone = vec4f(0, 0, 1, 1);
+    if (sumLength <= 0)
+        return;
+    const vec3f axis = normalSum / sumLength;
+    float minDot = 1;
+    for (uint32_t i = 0; i < m.indexCount; i += 3)
+    {
+        const vec3f a = position(positions, stride, tri[i]);
+        const vec3f n = cross(position(positions, stride, tri[i + 1]) - a, position(positions, stride, tri[i + 2]) - a);
+        const float len = length(n);
+        if (len > 0)
+            minDot = std::min(minDot, dot(n, axis) / len);
+    }
+    m.cone = vec4f(axis, (minDot > 0) ? sqrtf(std::max(1 - minDot * minDot, 0.0f)) : 1.0f);
+}
+
+void buildMeshlets(uint32_t* indices, size_t indexCount, const float* positions, size_t stride,
+    size_t vertexCount, std::vector<Meshlet>& meshlets, size_t maxTriangles, size_t maxVertices)
+{
+    meshlets.clear();
+    const size_t triangleCount = indexCount / 3;
+    const std::vector<uint32_t> input(indices, indices + triangleCount * 3);
+    std::vector<uint32_t> offsets, triangles;
+    buildVertexTriangles(input.data(), input.size(), vertexCount, offsets, triangles);
+
+    std::vector<vec3f> centroids(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        centroids[t] = (position(positions, stride, input[3 * t]) + position(positions, stride, input[3 * t + 1])
+            + position(positions, stride, input[3 * t + 2])) * (1.0f / 3);
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    // Meshlet that last took each vertex.
+    std::vector<uint32_t> owner(vertexCount, NoVertex);
+    std::vector<uint32_t> candidates;
+    size_t cursor = 0, out = 0;
+    while (out < triangleCount * 3)
+    {
+        const uint32_t id = static_cast<uint32_t>(meshlets.size());
+        Meshlet m;
+        m.firstIndex = static_cast<uint32_t>(out);
+        m.vertexCount = 0;
+        m.padding = 0;
+
+        // Seed next to the previous meshlet, else the first triangle left.
+        uint32_t t = NoVertex;
+        for (const uint32_t c : candidates)
+            if (!emitted[c])
+            {
+                t = c;
+                break;
+            }
+        while (t == NoVertex)
+        {
+            if (!emitted[cursor])
+                t = static_cast<uint32_t>(cursor);
+            ++cursor;
+        }
+        candidates.clear();
+
+        size_t meshletTriangles = 0;
+        vec3f centroidSum(0);
+        while (t != NoVertex)
+        {
+            emitted[t] = 1;
+            for (int c = 0; c < 3; ++c)
+            {
+                const uint32_t v = input[3 * t + c];
+                indices[out++] = v;
+                if (owner[v] == id)
+                    continue;
+                owner[v] = id;
+                ++m.vertexCount;
+                for (uint32_t k = offsets[v]; k < offsets[v + 1]; ++k)
+                    if (!emitted[triangles[k]])
+                        candidates.push_back(triangles[k]);
+            }
+            centroidSum += centroids[t];
+            if (++meshletTriangles == maxTriangles)
+                break;
+
+            // Fewest new vertices first, then nearest to the centroid.
+            const vec3f center = centroidSum / static_cast<float>(meshletTriangles);
+            t = NoVertex;
+            uint32_t bestNew = 4;
+            float bestDistance = 0;
+            for (size_t k = 0; k < candidates.size();)
+            {
+                const uint32_t c = candidates[k];
+                if (emitted[c])
+                {
+                    candidates[k] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                ++k;
+                const uint32_t newVertices = (owner[input[3 * c]] != id) + (owner[input[3 * c + 1]] != id)
+                    + (owner[input[3 * c + 2]] != id);
+                if (m.vertexCount + newVertices > maxVertices || newVertices > bestNew)
+                    continue;
+                const vec3f d = centroids[c] - center;
+                const float distance = dot(d, d);
+                if (newVertices < bestNew || distance < bestDistance)
+                {
+                    t = c;
+                    bestNew = newVertices;
+                    bestDistance = distance;
+                }
+            }
+        }
+
+        m.indexCount = static_cast<uint32_t>(out) - m.firstIndex;
+        meshletBounds(m, indices, positions, stride);
+        meshlets.push_back(m);
+    }
+}
+
+// Symmetric plane quadric: the sum of squared distances of p to its planes,
+// each weighted, is p.A.p + 2 b.p + c; w is the sum of weights.
+struct Quadric
+{
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c, w;
+};
+
+// Plane dot(n, p) + d = 0 with unit n.
+static void addPlane(Quadric& q, const vec3f& n, float d, float weight)
+{
+    const double x = n.x, y = n.y, z = n.z, w = weight;
+    q.a00 += w * x * x;
+    q.a01 += w * x * y;
+    q.a02 += w * x * z;
+    q.a11 += w * y * y;
+    q.a12 += w * y * z;
+    q.a22 += w * z * z;
+    q.b0 += w * x * d;
+    q.b1 += w * y * d;
+    q.b2 += w * z * d;
+    q.c += w * d * d;
+    q.w += w;
+}
+
+static void addQuadric(Quadric& q, const Quadric& r)
+{
+    q.a00 += r.a00;
+    q.a01 += r.a01;
+    q.a02 += r.a02;
+    q.a11 += r.a11;
+    q.a12 += r.a12;
+    q.a22 += r.a22;
+    q.b0 += r.b0;
+    q.b1 += r.b1;
+    q.b2 += r.b2;
+    q.c += r.c;
+    q.w += r.w;
+}
+
+static double evaluate(const Quadric& q, const vec3f& p)
+{
+    const double x = p.x, y = p.y, z = p.z;
+    return q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + 2 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+        + 2 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+}
+
+// Weighted mean squared distance of p to the planes of q and r. Orders the
+// collapses; as a mean it is at most planeDistance squared, slivers aside.
+static double collapseError(const Quadric& q, const Quadric& r, const vec3f& p)
+{
+    const double w = q.w + r.w;
+    return (w > 0) ? std::max(evaluate(q, p) + evaluate(r, p), 0.0) / w : 0;
+}
+
+// Largest distance of p to the planes (n, d) listed in a and b.
+static float planeDistance(const std::vector<vec4f>& planes, const std::vector<uint32_t>& a,
+    const std::vector<uint32_t>& b, const vec3f& p)
+{
+    float distance = 0;
+    for (const std::vector<uint32_t>* list : { &a, &b })
+        for (uint32_t i : *list)
+            distance = std::max(distance, fabsf(dot(vec3f(planes[i]), p) + planes[i].w));
+    return distance;
+}
+
+// Whether a triangle around a has the edge a -> b.
+static bool hasEdge(const uint32_t* indices, const std::vector<uint32_t>& offsets,
+    const std::vector<uint32_t>& triangles, uint32_t a, uint32_t b)
+{
+    for (uint32_t k = offsets[a]; k < offsets[a + 1]; ++k)
+    {
+        const uint32_t* t = indices + 3 * triangles[k];
+        if ((t[0] == a && t[1] == b) || (t[1] == a && t[2] == b) || (t[2] == a && t[0] == b))
+            return true;
+    }
+    return false;
+}
+
+static const uint8_t InteriorVertex = 0;
+static const uint8_t BorderVertex = 1;
+static const uint8_t LockedVertex = 2;
+
+struct Collapse
+{
+    uint32_t from;
+    uint32_t to;
+    double error;
+};
+
+// Moving from onto to keeps the surface a manifold without folds: no
+// triangle left turns over, and the neighbours shared by both vertices are
+// the third corners of the triangles on their edge (link condition).
+static bool isCollapseValid(const uint32_t* indices, const std::vector<uint32_t>& offsets,
+    const std::vector<uint32_t>& triangles, const float* positions, size_t stride, uint32_t from, uint32_t to)
+{
+    size_t sharedTriangles = 0;
+    for (uint32_t k = offsets[from]; k < offsets[from + 1]; ++k)
+    {
+        const uint32_t* t = indices + 3 * triangles[k];
+        if (t[0] == to || t[1] == to || t[2] == to)
+        {
+            ++sharedTriangles;
+            continue;
+        }
+        vec3f p[3], q[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            p[c] = position(positions, stride, t[c]);
+            q[c] = position(positions, stride, (t[c] == from) ? to : t[c]);
+        }
+        const vec3f before = cross(p[1] - p[0], p[2] - p[0]);
+        const vec3f after = cross(q[1] - q[0], q[2] - q[0]);
+        if (dot(before, before) > 0 && dot(before, after) <= 0)
+            return false;
+    }
+
+    size_t sharedNeighbours = 0;
+    for (uint32_t k = offsets[from]; k < offsets[from + 1]; ++k)
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t n = indices[3 * triangles[k] + c];
+            if (n == from || n == to)
+                continue;
+            // count each neighbour once: at its first corner around from
+            bool seen = false;
+            for (uint32_t j = offsets[from]; j < k && !seen; ++j)
+                for (int e = 0; e < 3; ++e)
+                    seen = seen || indices[3 * triangles[j] + e] == n;
+            bool shared = false;
+            for (uint32_t j = offsets[to]; j < offsets[to + 1] && !shared; ++j)
+                for (int e = 0; e < 3; ++e)
+                    shared = shared || indices[3 * triangles[j] + e] == n;
+            sharedNeighbours += !seen && shared;
+        }
+    return sharedNeighbours == sharedTriangles;
+}
+
+size_t simplify(uint32_t* dst, const uint32_t* indices, size_t indexCount, const float* positions, size_t stride,
+    size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError)
+{
+    std::vector<uint32_t> result(indices, indices + indexCount / 3 * 3);
+    size_t count = result.size();
+    std::vector<uint32_t> offsets, triangles;
+    buildVertexTriangles(result.data(), count, vertexCount, offsets, triangles);
+
+    // Quadrics of the triangle planes weighted by area, and of planes
+    // through border edges perpendicular to their triangle, which keep the
+    // border in place. The planes themselves are kept too, listed at each
+    // vertex they touch, for the error bound.
+    std::vector<Quadric> quadrics(vertexCount, Quadric{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 });
+    std::vector<vec4f> planes;
+    std::vector<std::vector<uint32_t>> vertexPlanes(vertexCount);
+    std::vector<uint8_t> kind(vertexCount, InteriorVertex);
+    for (size_t i = 0; i < count; i += 3)
+    {
+        const uint32_t* t = &result[i];
+        const vec3f a = position(positions, stride, t[0]);
+        const vec3f n = cross(position(positions, stride, t[1]) - a, position(positions, stride, t[2]) - a);
+        const float len = length(n);
+        if (len <= 0)
+            continue;
+        const vec3f normal = n / len;
+        for (int c = 0; c < 3; ++c)
+            addPlane(quadrics[t[c]], normal, -dot(normal, a), len * 0.5f);
+        // Slivers have no reliable planes for the bound, their long edges
+        // lie in the planes of the neighbours.
+        float longest = 0;
+        for (int c = 0; c < 3; ++c)
+        {
+            const vec3f edge = position(positions, stride, t[(c + 1) % 3]) - position(positions, stride, t[c]);
+            longest = std::max(longest, dot(edge, edge));
+        }
+        const bool isSliver = len <= 1e-4f * longest;
+        if (!isSliver)
+        {
+            planes.push_back(vec4f(normal, -dot(normal, a)));
+            for (int c = 0; c < 3; ++c)
+                vertexPlanes[t[c]].push_back(static_cast<uint32_t>(planes.size() - 1));
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t e0 = t[c], e1 = t[(c + 1) % 3];
+            if (hasEdge(result.data(), offsets, triangles, e1, e0))
+                continue;
+            kind[e0] = std::max(kind[e0], BorderVertex);
+            kind[e1] = std::max(kind[e1], BorderVertex);
+            const vec3f p0 = position(positions, stride, e0);
+            const vec3f edge = position(positions, stride, e1) - p0;
+            const vec3f side = normalize(cross(edge, normal));
+            addPlane(quadrics[e0], side, -dot(side, p0), dot(edge, edge));
+            addPlane(quadrics[e1], side, -dot(side, p0), dot(edge, edge));
+            if (isSliver)
+                continue;
+            planes.push_back(vec4f(side, -dot(side, p0)));
+            vertexPlanes[e0].push_back(static_cast<uint32_t>(planes.size() - 1));
+            vertexPlanes[e1].push_back(static_cast<uint32_t>(planes.size() - 1));
+        }
+    }
+
+    // Vertices at the same position are split by their other attributes.
+    std::vector<uint32_t> order;
+    for (size_t v = 0; v < vertexCount; ++v)
+        if (offsets[v + 1] > offsets[v])
+            order.push_back(static_cast<uint32_t>(v));
+    auto less = [positions, stride](uint32_t a, uint32_t b) {
+        const float* p = positions + stride * a;
+        const float* q = positions + stride * b;
+        return std::lexicographical_compare(p, p + 3, q, q + 3);
+    };
+    std::sort(order.begin(), order.end(), less);
+    for (size_t i = 1; i < order.size(); ++i)
+        if (!less(order[i - 1], order[i]))
+            kind[order[i - 1]] = kind[order[i]] = LockedVertex;
+
+    // Passes of independent collapses, cheapest first, each on the
+    // triangles left by the previous one. A collapse is taken when the
+    // vertex it keeps stays within targetError of all the planes the two
+    // vertices stand for; the quadric error stops the pass early.
+    const double maxError = static_cast<double>(targetError) * targetError;
+    float error = 0;
+    std::vector<Collapse> collapses;
+    std::vector<uint8_t> touched(vertexCount);
+    while (count > targetIndexCount)
+    {
+        collapses.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t u = result[i], v = result[i - i % 3 + (i + 1) % 3];
+            const bool isBorderEdge = !hasEdge(result.data(), offsets, triangles, v, u);
+            for (int direction = 0; direction < 2; ++direction)
+            {
+                const uint32_t from = direction ? v : u, to = direction ? u : v;
+                if (kind[from] == LockedVertex
+                    || (kind[from] == BorderVertex && (!isBorderEdge || kind[to] == InteriorVertex)))
+                    continue;
+                collapses.push_back(Collapse{ from, to,
+                    collapseError(quadrics[from], quadrics[to], position(positions, stride, to)) });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+            [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        std::fill(touched.begin(), touched.end(), 0);
+        const size_t removeTriangles = (count - targetIndexCount + 2) / 3;
+        size_t removed = 0, applied = 0;
+        for (const Collapse& c : collapses)
+        {
+            if (c.error > maxError || removed >= removeTriangles)
+                break;
+            if (touched[c.from] || touched[c.to]
+                || !isCollapseValid(result.data(), offsets, triangles, positions, stride, c.from, c.to))
+                continue;
+            const float distance = planeDistance(planes, vertexPlanes[c.from], vertexPlanes[c.to],
+                position(positions, stride, c.to));
+            if (distance > targetError)
+                continue;
+            for (uint32_t k = offsets[c.from]; k < offsets[c.from + 1]; ++k)
+            {
+                uint32_t* t = &result[3 * triangles[k]];
+                removed += (t[0] == c.to || t[1] == c.to || t[2] == c.to);
+                for (int e = 0; e < 3; ++e)
+                {
+                    t[e] = (t[e] == c.from) ? c.to : t[e];
+                    touched[t[e]] = 1;
+                }
+            }
+            touched[c.from] = 1;
+            addQuadric(quadrics[c.to], quadrics[c.from]);
+            std::vector<uint32_t>& merged = vertexPlanes[c.to];
+            merged.insert(merged.end(), vertexPlanes[c.from].begin(), vertexPlanes[c.from].end());
+            std::sort(merged.begin(), merged.end());
+            merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+            std::vector<uint32_t>().swap(vertexPlanes[c.from]);
+            error = std::max(error, distance);
+            ++applied;
+        }
+        if (applied == 0)
+            break;
+
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i += 3)
+        {
+            const uint32_t a = result[i], b = result[i + 1], c = result[i + 2];
+            if (a == b || b == c || c == a)
+                continue;
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        count = kept;
+        buildVertexTriangles(result.data(), count, vertexCount, offsets, triangles);
+    }
+
+    std::copy(result.begin(), result.begin() + count, dst);
+    if (resultError)
+        *resultError = error;
+    return count;
+}
@@ -14,9 +14,15 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <perlinNoise.h>
+
 #include <cstdint>
-#include <array>
 #include <cmath>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 int32_t crand(uint32_t& seed) {
   seed = seed * 214013 + 2531011;
@@ -47,6 +53,43 @@ inline float fgrad(uint32_t h, float x, float y, float z)
     return(0);
 }
 
+// Gradient vectors of fgrad: fgrad(h, x, y, z) = dot(gradVector[h&15], (x, y, z)).
+static const float gradVector[16][3] = {
+    { 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+    { 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+    { 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 },
+    { 1, 1, 0 }, { -1, 1, 0 }, { 0, 1, -1 }, { 0, -1, -1 } };
+
+// Value and gradient of a corner (or of a lerp of corners).
+template <int D>
+struct NoiseGrad
+{
+    float v;
+    float g[D];
+};
+
+template <int D>
+static inline NoiseGrad<D> corner(uint32_t h, float x, float y, float z)
+{
+    NoiseGrad<D> r;
+    r.v = fgrad(h, x, y, z);
+    for (int d = 0; d < D; ++d)
+        r.g[d] = gradVector[h&15][d];
+    return r;
+}
+
+// (b - a)*t + a, with t = fade(f) along axis k and dt = fade'(f).
+template <int D>
+static inline NoiseGrad<D> lerp(const NoiseGrad<D>& a, const NoiseGrad<D>& b, float t, float dt, int k)
+{
+    NoiseGrad<D> r;
+    r.v = (b.v-a.v)*t + a.v;
+    for (int d = 0; d < D; ++d)
+        r.g[d] = (b.g[d]-a.g[d])*t + a.g[d];
+    r.g[k] += (b.v-a.v)*dt;
+    return r;
+}
+
 inline uint32_t floormod256(float x)
 {
     // -1 => 255
@@ -57,28 +100,29 @@ inline uint32_t floormod256(float x)
         : (static_cast<uint32_t>(x) & 255);
 }
 
-using NoiseLUT = std::array<uint32_t, 768>;
-
-static NoiseLUT gen_table()
+PerlinNoise::PerlinNoise(uint32_t seed)
 {
-    NoiseLUT arr;
     uint32_t i;
-    uint32_t seed = 1;
-    for(i=0; i<256; ++i) arr[i] = i;
+    for(i=0; i<256; ++i) perm[i] = static_cast<uint8_t>(i);
     for(i=256-1;i> 0;i--) {
         uint32_t j = ((static_cast<uint32_t>(crand(seed))*(i+1)) >> 15);
-        std::swap(arr[i], arr[j]);
-    }
-    for(i=0; i<256; ++i) {
-        arr[i+256] = arr[i];
-        arr[i+512] = arr[i];
+        std::swap(perm[i], perm[j]);
     }
-    return arr;
+    for(i=0; i<256; ++i)
+        perm[i+256] = perm[i];
+    for(i=512; i<sizeof(perm); ++i)
+        perm[i] = 0;
 }
 
-static NoiseLUT noisep = gen_table();
+constexpr size_t PerlinNoise::permutationSize;
 
-float noise1d(float fx)
+const PerlinNoise& PerlinNoise::global()
+{
+    static const PerlinNoise noise(1);
+    return noise;
+}
+
+float PerlinNoise::noise1d(float fx) const
 {
     uint32_t l0;
     float p0, t0, f0, f1;
@@ -86,12 +130,12 @@ float noise1d(float fx)
     p0 = std::floor(fx);
     fx -= p0; t0 = (3.0f - 2.0f*fx)*fx*fx;
     l0 = floormod256(p0);
-    f0 = fgrad(noisep[noisep[noisep[l0  ]]],fx  ,0,0);
-    f1 = fgrad(noisep[noisep[noisep[l0+1]]],fx-1,0,0);
+    f0 = fgrad(perm[perm[perm[l0  ]]],fx  ,0,0);
+    f1 = fgrad(perm[perm[perm[l0+1]]],fx-1,0,0);
     return ((f1-f0)*t0 + f0);
 }
 
-float noise2d(float fx, float fy)
+float PerlinNoise::noise2d(float fx, float fy) const
 {
     uint32_t i, l0, l1, a0, a1, a2, a3;
     float p0, p1, t0, t1, f0, f1, f2, f3;
@@ -102,18 +146,18 @@ float noise2d(float fx, float fy)
     fy -= p1; t1 = (3.0f - 2.0f*fy)*fy*fy;
     l0 = floormod256(p0);
     l1 = floormod256(p1);
-    i = noisep[l0  ]; a0 = noisep[i+l1]; a2 = noisep[i+l1+1];
-    i = noisep[l0+1]; a1 = noisep[i+l1]; a3 = noisep[i+l1+1];
-    f0 = fgrad(noisep[a0],fx  ,fy,0);
-    f1 = fgrad(noisep[a1],fx-1,fy,0); fy--;
-    f2 = fgrad(noisep[a2],fx  ,fy,0);
-    f3 = fgrad(noisep[a3],fx-1,fy,0);
+    i = perm[l0  ]; a0 = perm[i+l1]; a2 = perm[i+l1+1];
+    i = perm[l0+1]; a1 = perm[i+l1]; a3 = perm[i+l1+1];
+    f0 = fgrad(perm[a0],fx  ,fy,0);
+    f1 = fgrad(perm[a1],fx-1,fy,0); fy--;
+    f2 = fgrad(perm[a2],fx  ,fy,0);
+    f3 = fgrad(perm[a3],fx-1,fy,0);
     f0 = (f1-f0)*t0 + f0;
     f1 = (f3-f2)*t0 + f2;
     return((f1-f0)*t1 + f0);
 }
 
-float noise3d(float fx, float fy, float fz)
+float PerlinNoise::noise3d(float fx, float fy, float fz) const
 {
     uint32_t i, l0, l1, l2, a0, a1, a2, a3;
     float p0, p1, p2, t0, t1, t2, f0, f1, f2, f3, f4, f5, f6, f7;
@@ -127,16 +171,16 @@ float noise3d(float fx, float fy, float fz)
     l0 = floormod256(p0);
     l1 = floormod256(p1);
     l2 = floormod256(p2);
-    i = noisep[l0  ]; a0 = noisep[i+l1]; a2 = noisep[i+l1+1];
-    i = noisep[l0+1]; a1 = noisep[i+l1]; a3 = noisep[i+l1+1];
-    f0 = fgrad(noisep[a0+l2  ],fx  ,fy  ,fz);
-    f1 = fgrad(noisep[a1+l2  ],fx-1,fy  ,fz);
-    f2 = fgrad(noisep[a2+l2  ],fx  ,fy-1,fz);
-    f3 = fgrad(noisep[a3+l2  ],fx-1,fy-1,fz); fz--;
-    f4 = fgrad(noisep[a0+l2+1],fx  ,fy  ,fz);
-    f5 = fgrad(noisep[a1+l2+1],fx-1,fy  ,fz);
-    f6 = fgrad(noisep[a2+l2+1],fx  ,fy-1,fz);
-    f7 = fgrad(noisep[a3+l2+1],fx-1,fy-1,fz);
+    i = perm[l0  ]; a0 = perm[i+l1]; a2 = perm[i+l1+1];
+    i = perm[l0+1]; a1 = perm[i+l1]; a3 = perm[i+l1+1];
+    f0 = fgrad(perm[a0+l2  ],fx  ,fy  ,fz);
+    f1 = fgrad(perm[a1+l2  ],fx-1,fy  ,fz);
+    f2 = fgrad(perm[a2+l2  ],fx  ,fy-1,fz);
+    f3 = fgrad(perm[a3+l2  ],fx-1,fy-1,fz); fz--;
+    f4 = fgrad(perm[a0+l2+1],fx  ,fy  ,fz);
+    f5 = fgrad(perm[a1+l2+1],fx-1,fy  ,fz);
+    f6 = fgrad(perm[a2+l2+1],fx  ,fy-1,fz);
+    f7 = fgrad(perm[a3+l2+1],fx-1,fy-1,fz);
     f0 = (f1-f0)*t0 + f0;
     f1 = (f3-f2)*t0 + f2;
     f2 = (f5-f4)*t0 + f4;
@@ -145,3 +189,269 @@ float noise3d(float fx, float fy, float fz)
     f1 = (f3-f2)*t1 + f2;
     return((f1-f0)*t2 + f0);
 }
+
+// The same steps as noise2d/noise3d (so the same values), carrying the
+// gradients along; fade'(f) = 6*f*(1 - f).
+float PerlinNoise::noise2d(float fx, float fy, float grad[2]) const
+{
+    uint32_t i, l0, l1, a0, a1, a2, a3;
+    float p0, p1, t0, t1, d0, d1;
+
+    p0 = std::floor(fx);
+    p1 = std::floor(fy);
+    fx -= p0; t0 = (3.0f - 2.0f*fx)*fx*fx; d0 = 6.0f*fx*(1.0f - fx);
+    fy -= p1; t1 = (3.0f - 2.0f*fy)*fy*fy; d1 = 6.0f*fy*(1.0f - fy);
+    l0 = floormod256(p0);
+    l1 = floormod256(p1);
+    i = perm[l0  ]; a0 = perm[i+l1]; a2 = perm[i+l1+1];
+    i = perm[l0+1]; a1 = perm[i+l1]; a3 = perm[i+l1+1];
+    const NoiseGrad<2> f0 = corner<2>(perm[a0],fx  ,fy,0);
+    const NoiseGrad<2> f1 = corner<2>(perm[a1],fx-1,fy,0); fy--;
+    const NoiseGrad<2> f2 = corner<2>(perm[a2],fx  ,fy,0);
+    const NoiseGrad<2> f3 = corner<2>(perm[a3],fx-1,fy,0);
+    const NoiseGrad<2> r = lerp(lerp(f0, f1, t0, d0, 0), lerp(f2, f3, t0, d0, 0), t1, d1, 1);
+    grad[0] = r.g[0];
+    grad[1] = r.g[1];
+    return r.v;
+}
+
+float PerlinNoise::noise3d(float fx, float fy, float fz, float grad[3]) const
+{
+    uint32_t i, l0, l1, l2, a0, a1, a2, a3;
+    float p0, p1, p2, t0, t1, t2, d0, d1, d2;
+
+    p0 = std::floor(fx);
+    p1 = std::floor(fy);
+    p2 = std::floor(fz);
+    fx -= p0; t0 = (3.0f - 2.0f*fx)*fx*fx; d0 = 6.0f*fx*(1.0f - fx);
+    fy -= p1; t1 = (3.0f - 2.0f*fy)*fy*fy; d1 = 6.0f*fy*(1.0f - fy);
+    fz -= p2; t2 = (3.0f - 2.0f*fz)*fz*fz; d2 = 6.0f*fz*(1.0f - fz);
+    l0 = floormod256(p0);
+    l1 = floormod256(p1);
+    l2 = floormod256(p2);
+    i = perm[l0  ]; a0 = perm[i+l1]; a2 = perm[i+l1+1];
+    i = perm[l0+1]; a1 = perm[i+l1]; a3 = perm[i+l1+1];
+    const NoiseGrad<3> f0 = corner<3>(perm[a0+l2  ],fx  ,fy  ,fz);
+    const NoiseGrad<3> f1 = corner<3>(perm[a1+l2  ],fx-1,fy  ,fz);
+    const NoiseGrad<3> f2 = corner<3>(perm[a2+l2  ],fx  ,fy-1,fz);
+    const NoiseGrad<3> f3 = corner<3>(perm[a3+l2  ],fx-1,fy-1,fz); fz--;
+    const NoiseGrad<3> f4 = corner<3>(perm[a0+l2+1],fx  ,fy  ,fz);
+    const NoiseGrad<3> f5 = corner<3>(perm[a1+l2+1],fx-1,fy  ,fz);
+    const NoiseGrad<3> f6 = corner<3>(perm[a2+l2+1],fx  ,fy-1,fz);
+    const NoiseGrad<3> f7 = corner<3>(perm[a3+l2+1],fx-1,fy-1,fz);
+    const NoiseGrad<3> g0 = lerp(lerp(f0, f1, t0, d0, 0), lerp(f2, f3, t0, d0, 0), t1, d1, 1);
+    const NoiseGrad<3> g1 = lerp(lerp(f4, f5, t0, d0, 0), lerp(f6, f7, t0, d0, 0), t1, d1, 1);
+    const NoiseGrad<3> r = lerp(g0, g1, t2, d2, 2);
+    grad[0] = r.g[0];
+    grad[1] = r.g[1];
+    grad[2] = r.g[2];
+    return r.v;
+}
+
+#if defined(__AVX2__)
+// 8 lanes of the scalar functions above, operation for operation.
+
+// perm[index], as 32-bit gathers at byte offsets keeping the low byte.
+static inline __m256i lookup(const uint8_t* perm, __m256i index)
+{
+    return _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(perm), index, 1),
+        _mm256_set1_epi32(255));
+}
+
+// fgrad without the switch: h = 12..15 reuse the gradients of 0, 1, 10, 11,
+// then u = (h < 8) ? x : y, v = (h < 4) ? y : z, negated by bits 0 and 1.
+static inline __m256 fgrad(__m256i h, __m256 x, __m256 y, __m256 z)
+{
+    h = _mm256_and_si256(h, _mm256_set1_epi32(15));
+    const __m256i high = _mm256_cmpgt_epi32(h, _mm256_set1_epi32(11));
+    const __m256i shift = _mm256_sub_epi32(_mm256_set1_epi32(12),
+        _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 2));
+    h = _mm256_sub_epi32(h, _mm256_and_si256(high, shift));
+    const __m256 u = _mm256_blendv_ps(x, y, _mm256_castsi256_ps(_mm256_cmpgt_epi32(h, _mm256_set1_epi32(7))));
+    const __m256 v = _mm256_blendv_ps(y, z, _mm256_castsi256_ps(_mm256_cmpgt_epi32(h, _mm256_set1_epi32(3))));
+    const __m256 su = _mm256_castsi256_ps(_mm256_slli_epi32(h, 31));
+    const __m256 sv = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(h, 1), 31));
+    return _mm256_add_ps(_mm256_xor_ps(u, su), _mm256_xor_ps(v, sv));
+}
+
+// (3 - 2*f)*f*f
+static inline __m256 fade(__m256 f)
+{
+    const __m256 t = _mm256_sub_ps(_mm256_set1_ps(3.0f), _mm256_mul_ps(_mm256_set1_ps(2.0f), f));
+    return _mm256_mul_ps(_mm256_mul_ps(t, f), f);
+}
+
+// (b - a)*t + a
+static inline __m256 lerp(__m256 a, __m256 b, __m256 t)
+{
+    return _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(b, a), t), a);
+}
+
+// floormod256 of integral p: the low byte of two's complement p.
+static inline __m256i floormod256(__m256 p)
+{
+    return _mm256_and_si256(_mm256_cvttps_epi32(p), _mm256_set1_epi32(255));
+}
+
+static __m256 noise2d8(const uint8_t* perm, __m256 fx, __m256 fy)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i i1 = _mm256_set1_epi32(1);
+    const __m256 p0 = _mm256_floor_ps(fx);
+    const __m256 p1 = _mm256_floor_ps(fy);
+    fx = _mm256_sub_ps(fx, p0);
+    fy = _mm256_sub_ps(fy, p1);
+    const __m256 t0 = fade(fx), t1 = fade(fy);
+    const __m256i l0 = floormod256(p0);
+    const __m256i l1 = floormod256(p1);
+    __m256i i = _mm256_add_epi32(lookup(perm, l0), l1);
+    const __m256i a0 = lookup(perm, i), a2 = lookup(perm, _mm256_add_epi32(i, i1));
+    i = _mm256_add_epi32(lookup(perm, _mm256_add_epi32(l0, i1)), l1);
+    const __m256i a1 = lookup(perm, i), a3 = lookup(perm, _mm256_add_epi32(i, i1));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 fx1 = _mm256_sub_ps(fx, one);
+    const __m256 f0 = fgrad(lookup(perm, a0), fx, fy, zero);
+    const __m256 f1 = fgrad(lookup(perm, a1), fx1, fy, zero);
+    fy = _mm256_sub_ps(fy, one);
+    const __m256 f2 = fgrad(lookup(perm, a2), fx, fy, zero);
+    const __m256 f3 = fgrad(lookup(perm, a3), fx1, fy, zero);
+    return lerp(lerp(f0, f1, t0), lerp(f2, f3, t0), t1);
+}
+
+static __m256 noise3d8(const uint8_t* perm, __m256 fx, __m256 fy, __m256 fz)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i i1 = _mm256_set1_epi32(1);
+    const __m256 p0 = _mm256_floor_ps(fx);
+    const __m256 p1 = _mm256_floor_ps(fy);
+    const __m256 p2 = _mm256_floor_ps(fz);
+    fx = _mm256_sub_ps(fx, p0);
+    fy = _mm256_sub_ps(fy, p1);
+    fz = _mm256_sub_ps(fz, p2);
+    const __m256 t0 = fade(fx), t1 = fade(fy), t2 = fade(fz);
+    const __m256i l0 = floormod256(p0);
+    const __m256i l1 = floormod256(p1);
+    const __m256i l2 = floormod256(p2);
+    __m256i i = _mm256_add_epi32(lookup(perm, l0), l1);
+    const __m256i a0 = _mm256_add_epi32(lookup(perm, i), l2);
+    const __m256i a2 = _mm256_add_epi32(lookup(perm, _mm256_add_epi32(i, i1)), l2);
+    i = _mm256_add_epi32(lookup(perm, _mm256_add_epi32(l0, i1)), l1);
+    const __m256i a1 = _mm256_add_epi32(lookup(perm, i), l2);
+    const __m256i a3 = _mm256_add_epi32(lookup(perm, _mm256_add_epi32(i, i1)), l2);
+    const __m256 fx1 = _mm256_sub_ps(fx, one);
+    const __m256 fy1 = _mm256_sub_ps(fy, one);
+    const __m256 f0 = fgrad(lookup(perm, a0), fx, fy, fz);
+    const __m256 f1 = fgrad(lookup(perm, a1), fx1, fy, fz);
+    const __m256 f2 = fgrad(lookup(perm, a2), fx, fy1, fz);
+    const __m256 f3 = fgrad(lookup(perm, a3), fx1, fy1, fz);
+    fz = _mm256_sub_ps(fz, one);
+    const __m256 f4 = fgrad(lookup(perm, _mm256_add_epi32(a0, i1)), fx, fy, fz);
+    const __m256 f5 = fgrad(lookup(perm, _mm256_add_epi32(a1, i1)), fx1, fy, fz);
+    const __m256 f6 = fgrad(lookup(perm, _mm256_add_epi32(a2, i1)), fx, fy1, fz);
+    const __m256 f7 = fgrad(lookup(perm, _mm256_add_epi32(a3, i1)), fx1, fy1, fz);
+    const __m256 g0 = lerp(lerp(f0, f1, t0), lerp(f2, f3, t0), t1);
+    const __m256 g1 = lerp(lerp(f4, f5, t0), lerp(f6, f7, t0), t1);
+    return lerp(g0, g1, t2);
+}
+
+// x0 + (i..i+7)*dx, same as the scalar expression per element.
+static inline __m256 ramp(float x0, float dx, size_t i)
+{
+    const __m256 k = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)),
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    return _mm256_add_ps(_mm256_set1_ps(x0), _mm256_mul_ps(k, _mm256_set1_ps(dx)));
+}
+#endif
+
+void PerlinNoise::noise2dBatch(const float* x, const float* y, float* out, size_t count) const
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, noise2d8(perm, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+#endif
+    for (; i < count; ++i)
+        out[i] = noise2d(x[i], y[i]);
+}
+
+void PerlinNoise::noise3dBatch(const float* x, const float* y, const float* z, float* out, size_t count) const
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, noise3d8(perm, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i)));
+#endif
+    for (; i < count; ++i)
+        out[i] = noise3d(x[i], y[i], z[i]);
+}
+
+void PerlinNoise::noise2dGrid(float x0, float y0, float dx, float dy, size_t width, size_t height, float* out) const
+{
+    for (size_t j = 0; j < height; ++j, out += width)
+    {
+        const float y = y0 + j*dy;
+        size_t i = 0;
+#if defined(__AVX2__)
+        for (; i + 8 <= width; i += 8)
+            _mm256_storeu_ps(out + i, noise2d8(perm, ramp(x0, dx, i), _mm256_set1_ps(y)));
+#endif
+        for (; i < width; ++i)
+            out[i] = noise2d(x0 + i*dx, y);
+    }
+}
+
+void PerlinNoise::noise3dGrid(float x0, float y0, float z0, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out) const
+{
+    for (size_t k = 0; k < depth; ++k)
+    {
+        const float z = z0 + k*dz;
+        for (size_t j = 0; j < height; ++j, out += width)
+        {
+            const float y = y0 + j*dy;
+            size_t i = 0;
+#if defined(__AVX2__)
+            for (; i + 8 <= width; i += 8)
+                _mm256_storeu_ps(out + i, noise3d8(perm, ramp(x0, dx, i), _mm256_set1_ps(y), _mm256_set1_ps(z)));
+#endif
+            for (; i < width; ++i)
+                out[i] = noise3d(x0 + i*dx, y, z);
+        }
+    }
+}
+
+float noise1d(float fx)
+{
+    return PerlinNoise::global().noise1d(fx);
+}
+
+float noise2d(float fx, float fy)
+{
+    return PerlinNoise::global().noise2d(fx, fy);
+}
+
+float noise3d(float fx, float fy, float fz)
+{
+    return PerlinNoise::global().noise3d(fx, fy, fz);
+}
+
+void noise2dBatch(const float* x, const float* y, float* out, size_t count)
+{
+    PerlinNoise::global().noise2dBatch(x, y, out, count);
+}
+
+void noise3dBatch(const float* x, const float* y, const float* z, float* out, size_t count)
+{
+    PerlinNoise::global().noise3dBatch(x, y, z, out, count);
+}
+
+void noise2dGrid(float x0, float y0, float dx, float dy, size_t width, size_t height, float* out)
+{
+    PerlinNoise::global().noise2dGrid(x0, y0, dx, dy, width, height, out);
+}
+
+void noise3dGrid(float x0, float y0, float z0, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out)
+{
+    PerlinNoise::global().noise3dGrid(x0, y0, z0, dx, dy, dz, width, height, depth, out);
+}
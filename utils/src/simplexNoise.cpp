@@ -0,0 +1,517 @@
+// Simplex-noise implementation
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <simplexNoise.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Skew (F) and unskew (G) factors between the simplex grid and the
+// hypercube grid: F = (sqrt(N + 1) - 1)/N, G = (1 - 1/sqrt(N + 1))/N.
+static const float F2 = 0.366025403784f, G2 = 0.211324865405f;
+static const float F3 = 1.0f / 3.0f, G3 = 1.0f / 6.0f;
+static const float F4 = 0.309016994375f, G4 = 0.138196601125f;
+
+// Bring the sums of the corner kernels to [-1, 1]; the extremes reached
+// are about 0.998, 0.989 and 0.988.
+static const float Scale2 = 70.0f, Scale3 = 76.0f, Scale4 = 62.0f;
+
+// Corner gradients by component, indexed by the hashed corner:
+// 2D the 8 directions to the edges and corners of a square,
+// 3D the 12 edges of a cube (as fgrad in perlinNoise.cpp, 4 repeated),
+// 4D the 32 edges of a tesseract.
+static const float grad2[2][8] = {
+    { 1, -1, 1, -1, 1, -1, 0, 0 },
+    { 1, 1, -1, -1, 0, 0, 1, -1 } };
+static const float grad3[3][16] = {
+    { 1, -1, 1, -1, 1, -1, 1, -1, 0, 0, 0, 0, 1, -1, 0, 0 },
+    { 1, 1, -1, -1, 0, 0, 0, 0, 1, -1, 1, -1, 1, 1, 1, -1 },
+    { 0, 0, 0, 0, 1, 1, -1, -1, 1, 1, -1, -1, 0, 0, -1, -1 } };
+static const float grad4[4][32] = {
+    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, -1, -1, -1, -1,
+      1, 1, 1, 1, -1, -1, -1, -1, 1, 1, 1, 1, -1, -1, -1, -1 },
+    { 1, 1, 1, 1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0,
+      1, 1, -1, -1, 1, 1, -1, -1, 1, 1, -1, -1, 1, 1, -1, -1 },
+    { 1, 1, -1, -1, 1, 1, -1, -1, 1, 1, -1, -1, 1, 1, -1, -1,
+      0, 0, 0, 0, 0, 0, 0, 0, 1, -1, 1, -1, 1, -1, 1, -1 },
+    { 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1,
+      1, -1, 1, -1, 1, -1, 1, -1, 0, 0, 0, 0, 0, 0, 0, 0 } };
+
+// The low byte of two's complement floor(x), given p = floor(x).
+static inline uint32_t wrap256(float p)
+{
+    return static_cast<uint32_t>(static_cast<int32_t>(p)) & 255;
+}
+
+// Corner kernel: max(0.5 - |d|^2, 0)^4 * dot(g, d) for the offset d of
+// the point from the corner.
+static inline float kernel(float t, float dot)
+{
+    t = std::max(t, 0.0f);
+    t *= t;
+    return t*t*dot;
+}
+
+static inline float corner2(uint32_t h, float x, float y)
+{
+    h &= 7;
+    return kernel(0.5f - x*x - y*y, grad2[0][h]*x + grad2[1][h]*y);
+}
+
+static inline float corner3(uint32_t h, float x, float y, float z)
+{
+    h &= 15;
+    return kernel(0.5f - x*x - y*y - z*z, grad3[0][h]*x + grad3[1][h]*y + grad3[2][h]*z);
+}
+
+static inline float corner4(uint32_t h, float x, float y, float z, float w)
+{
+    h &= 31;
+    return kernel(0.5f - x*x - y*y - z*z - w*w,
+        grad4[0][h]*x + grad4[1][h]*y + grad4[2][h]*z + grad4[3][h]*w);
+}
+
+SimplexNoise::SimplexNoise(uint32_t seed)
+{
+    const PerlinNoise noise(seed);
+    memcpy(perm, noise.permutation(), sizeof(perm));
+}
+
+const SimplexNoise& SimplexNoise::global()
+{
+    static const SimplexNoise noise(1);
+    return noise;
+}
+
+// The corners of the simplex containing the point are visited in the order
+// of decreasing coordinates of its offset in the skewed cell: the axis of
+// rank N - 1 steps first. The rank of an axis is the number of axes it is
+// greater than, ties counting against the first axis of the pair, so the
+// ranks are always a permutation of 0..N-1 (and no branches are needed).
+
+float SimplexNoise::noise2d(float fx, float fy) const
+{
+    const float s = (fx + fy)*F2;
+    const float p0 = std::floor(fx + s);
+    const float p1 = std::floor(fy + s);
+    const float t = (p0 + p1)*G2;
+    const float x0 = fx - (p0 - t);
+    const float y0 = fy - (p1 - t);
+    const int32_t i1 = (x0 > y0) ? 1 : 0, j1 = 1 - i1;
+    const float x1 = x0 - i1 + G2, y1 = y0 - j1 + G2;
+    const float x2 = x0 - 1.0f + 2.0f*G2, y2 = y0 - 1.0f + 2.0f*G2;
+    const uint32_t l0 = wrap256(p0), l1 = wrap256(p1);
+    const float n0 = corner2(perm[l0 + perm[l1]], x0, y0);
+    const float n1 = corner2(perm[l0 + i1 + perm[l1 + j1]], x1, y1);
+    const float n2 = corner2(perm[l0 + 1 + perm[l1 + 1]], x2, y2);
+    return Scale2*(n0 + n1 + n2);
+}
+
+float SimplexNoise::noise3d(float fx, float fy, float fz) const
+{
+    const float s = (fx + fy + fz)*F3;
+    const float p0 = std::floor(fx + s);
+    const float p1 = std::floor(fy + s);
+    const float p2 = std::floor(fz + s);
+    const float t = (p0 + p1 + p2)*G3;
+    const float x0 = fx - (p0 - t);
+    const float y0 = fy - (p1 - t);
+    const float z0 = fz - (p2 - t);
+    const int32_t xy = x0 > y0, xz = x0 > z0, yz = y0 > z0;
+    const int32_t rx = xy + xz, ry = 1 - xy + yz, rz = 2 - (xz + yz);
+    const int32_t i1 = rx >= 2, j1 = ry >= 2, k1 = rz >= 2;
+    const int32_t i2 = rx >= 1, j2 = ry >= 1, k2 = rz >= 1;
+    const float x1 = x0 - i1 + G3, y1 = y0 - j1 + G3, z1 = z0 - k1 + G3;
+    const float x2 = x0 - i2 + 2.0f*G3, y2 = y0 - j2 + 2.0f*G3, z2 = z0 - k2 + 2.0f*G3;
+    const float x3 = x0 - 1.0f + 3.0f*G3, y3 = y0 - 1.0f + 3.0f*G3, z3 = z0 - 1.0f + 3.0f*G3;
+    const uint32_t l0 = wrap256(p0), l1 = wrap256(p1), l2 = wrap256(p2);
+    const float n0 = corner3(perm[l0 + perm[l1 + perm[l2]]], x0, y0, z0);
+    const float n1 = corner3(perm[l0 + i1 + perm[l1 + j1 + perm[l2 + k1]]], x1, y1, z1);
+    const float n2 = corner3(perm[l0 + i2 + perm[l1 + j2 + perm[l2 + k2]]], x2, y2, z2);
+    const float n3 = corner3(perm[l0 + 1 + perm[l1 + 1 + perm[l2 + 1]]], x3, y3, z3);
+    return Scale3*(n0 + n1 + n2 + n3);
+}
+
+float SimplexNoise::noise4d(float fx, float fy, float fz, float fw) const
+{
+    const float s = (fx + fy + fz + fw)*F4;
+    const float p0 = std::floor(fx + s);
+    const float p1 = std::floor(fy + s);
+    const float p2 = std::floor(fz + s);
+    const float p3 = std::floor(fw + s);
+    const float t = (p0 + p1 + p2 + p3)*G4;
+    const float x0 = fx - (p0 - t);
+    const float y0 = fy - (p1 - t);
+    const float z0 = fz - (p2 - t);
+    const float w0 = fw - (p3 - t);
+    const int32_t xy = x0 > y0, xz = x0 > z0, xw = x0 > w0;
+    const int32_t yz = y0 > z0, yw = y0 > w0, zw = z0 > w0;
+    const int32_t rx = xy + xz + xw, ry = 1 - xy + yz + yw;
+    const int32_t rz = 2 - (xz + yz) + zw, rw = 3 - (xw + yw + zw);
+    const int32_t i1 = rx >= 3, j1 = ry >= 3, k1 = rz >= 3, m1 = rw >= 3;
+    const int32_t i2 = rx >= 2, j2 = ry >= 2, k2 = rz >= 2, m2 = rw >= 2;
+    const int32_t i3 = rx >= 1, j3 = ry >= 1, k3 = rz >= 1, m3 = rw >= 1;
+    const float x1 = x0 - i1 + G4, y1 = y0 - j1 + G4, z1 = z0 - k1 + G4, w1 = w0 - m1 + G4;
+    const float x2 = x0 - i2 + 2.0f*G4, y2 = y0 - j2 + 2.0f*G4, z2 = z0 - k2 + 2.0f*G4, w2 = w0 - m2 + 2.0f*G4;
+    const float x3 = x0 - i3 + 3.0f*G4, y3 = y0 - j3 + 3.0f*G4, z3 = z0 - k3 + 3.0f*G4, w3 = w0 - m3 + 3.0f*G4;
+    const float x4 = x0 - 1.0f + 4.0f*G4, y4 = y0 - 1.0f + 4.0f*G4, z4 = z0 - 1.0f + 4.0f*G4, w4 = w0 - 1.0f + 4.0f*G4;
+    const uint32_t l0 = wrap256(p0), l1 = wrap256(p1), l2 = wrap256(p2), l3 = wrap256(p3);
+    const float n0 = corner4(perm[l0 + perm[l1 + perm[l2 + perm[l3]]]], x0, y0, z0, w0);
+    const float n1 = corner4(perm[l0 + i1 + perm[l1 + j1 + perm[l2 + k1 + perm[l3 + m1]]]], x1, y1, z1, w1);
+    const float n2 = corner4(perm[l0 + i2 + perm[l1 + j2 + perm[l2 + k2 + perm[l3 + m2]]]], x2, y2, z2, w2);
+    const float n3 = corner4(perm[l0 + i3 + perm[l1 + j3 + perm[l2 + k3 + perm[l3 + m3]]]], x3, y3, z3, w3);
+    const float n4 = corner4(perm[l0 + 1 + perm[l1 + 1 + perm[l2 + 1 + perm[l3 + 1]]]], x4, y4, z4, w4);
+    return Scale4*(n0 + n1 + n2 + n3 + n4);
+}
+
+#if defined(__AVX2__)
+// 8 lanes of the scalar functions above, operation for operation.
+
+// perm[index], as 32-bit gathers at byte offsets keeping the low byte.
+static inline __m256i lookup(const uint8_t* perm, __m256i index)
+{
+    return _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(perm), index, 1),
+        _mm256_set1_epi32(255));
+}
+
+// table[h & 7], table[h & 15] and table[h & 31] with in-register permutes.
+static inline __m256 select8(const float* table, __m256i h)
+{
+    return _mm256_permutevar8x32_ps(_mm256_loadu_ps(table), h);
+}
+
+static inline __m256 select16(const float* table, __m256i h)
+{
+    return _mm256_blendv_ps(select8(table, h), select8(table + 8, h),
+        _mm256_castsi256_ps(_mm256_slli_epi32(h, 28)));
+}
+
+static inline __m256 select32(const float* table, __m256i h)
+{
+    return _mm256_blendv_ps(select16(table, h), select16(table + 16, h),
+        _mm256_castsi256_ps(_mm256_slli_epi32(h, 27)));
+}
+
+static inline __m256 kernel(__m256 t, __m256 dot)
+{
+    t = _mm256_max_ps(t, _mm256_setzero_ps());
+    t = _mm256_mul_ps(t, t);
+    return _mm256_mul_ps(_mm256_mul_ps(t, t), dot);
+}
+
+static inline __m256 corner2(__m256i h, __m256 x, __m256 y)
+{
+    const __m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y));
+    return kernel(t, _mm256_add_ps(_mm256_mul_ps(select8(grad2[0], h), x), _mm256_mul_ps(select8(grad2[1], h), y)));
+}
+
+static inline __m256 corner3(__m256i h, __m256 x, __m256 y, __m256 z)
+{
+    __m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y));
+    t = _mm256_sub_ps(t, _mm256_mul_ps(z, z));
+    __m256 d = _mm256_add_ps(_mm256_mul_ps(select16(grad3[0], h), x), _mm256_mul_ps(select16(grad3[1], h), y));
+    d = _mm256_add_ps(d, _mm256_mul_ps(select16(grad3[2], h), z));
+    return kernel(t, d);
+}
+
+static inline __m256 corner4(__m256i h, __m256 x, __m256 y, __m256 z, __m256 w)
+{
+    __m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y));
+    t = _mm256_sub_ps(_mm256_sub_ps(t, _mm256_mul_ps(z, z)), _mm256_mul_ps(w, w));
+    __m256 d = _mm256_add_ps(_mm256_mul_ps(select32(grad4[0], h), x), _mm256_mul_ps(select32(grad4[1], h), y));
+    d = _mm256_add_ps(_mm256_add_ps(d, _mm256_mul_ps(select32(grad4[2], h), z)), _mm256_mul_ps(select32(grad4[3], h), w));
+    return kernel(t, d);
+}
+
+// wrap256 of integral p: the low byte of two's complement p.
+static inline __m256i wrap256(__m256 p)
+{
+    return _mm256_and_si256(_mm256_cvttps_epi32(p), _mm256_set1_epi32(255));
+}
+
+// 1 where a > b, else 0.
+static inline __m256i greater(__m256 a, __m256 b)
+{
+    return _mm256_srli_epi32(_mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)), 31);
+}
+
+// 1 where rank >= r, else 0.
+static inline __m256i atLeast(__m256i rank, int r)
+{
+    return _mm256_srli_epi32(_mm256_cmpgt_epi32(rank, _mm256_set1_epi32(r - 1)), 31);
+}
+
+// c - o + g, o the 0/1 step of the corner along the axis.
+static inline __m256 offset(__m256 c, __m256i o, float g)
+{
+    return _mm256_add_ps(_mm256_sub_ps(c, _mm256_cvtepi32_ps(o)), _mm256_set1_ps(g));
+}
+
+static __m256 simplex2d8(const uint8_t* perm, __m256 fx, __m256 fy)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256 s = _mm256_mul_ps(_mm256_add_ps(fx, fy), _mm256_set1_ps(F2));
+    const __m256 p0 = _mm256_floor_ps(_mm256_add_ps(fx, s));
+    const __m256 p1 = _mm256_floor_ps(_mm256_add_ps(fy, s));
+    const __m256 t = _mm256_mul_ps(_mm256_add_ps(p0, p1), _mm256_set1_ps(G2));
+    const __m256 x0 = _mm256_sub_ps(fx, _mm256_sub_ps(p0, t));
+    const __m256 y0 = _mm256_sub_ps(fy, _mm256_sub_ps(p1, t));
+    const __m256i i1 = greater(x0, y0), j1 = _mm256_sub_epi32(one, i1);
+    const __m256 x1 = offset(x0, i1, G2), y1 = offset(y0, j1, G2);
+    const __m256 x2 = offset(x0, one, 2.0f*G2), y2 = offset(y0, one, 2.0f*G2);
+    const __m256i l0 = wrap256(p0), l1 = wrap256(p1);
+    const __m256 n0 = corner2(lookup(perm, _mm256_add_epi32(l0, lookup(perm, l1))), x0, y0);
+    const __m256 n1 = corner2(lookup(perm, _mm256_add_epi32(_mm256_add_epi32(l0, i1),
+        lookup(perm, _mm256_add_epi32(l1, j1)))), x1, y1);
+    const __m256 n2 = corner2(lookup(perm, _mm256_add_epi32(_mm256_add_epi32(l0, one),
+        lookup(perm, _mm256_add_epi32(l1, one)))), x2, y2);
+    return _mm256_mul_ps(_mm256_set1_ps(Scale2), _mm256_add_ps(_mm256_add_ps(n0, n1), n2));
+}
+
+// perm[l0 + a + perm[l1 + b + perm[l2 + c]]]
+static inline __m256i hash3(const uint8_t* perm, __m256i l0, __m256i l1, __m256i l2, __m256i a, __m256i b, __m256i c)
+{
+    __m256i h = lookup(perm, _mm256_add_epi32(l2, c));
+    h = lookup(perm, _mm256_add_epi32(_mm256_add_epi32(l1, b), h));
+    return lookup(perm, _mm256_add_epi32(_mm256_add_epi32(l0, a), h));
+}
+
+static __m256 simplex3d8(const uint8_t* perm, __m256 fx, __m256 fy, __m256 fz)
+{
+    const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi32(1);
+    const __m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(fx, fy), fz), _mm256_set1_ps(F3));
+    const __m256 p0 = _mm256_floor_ps(_mm256_add_ps(fx, s));
+    const __m256 p1 = _mm256_floor_ps(_mm256_add_ps(fy, s));
+    const __m256 p2 = _mm256_floor_ps(_mm256_add_ps(fz, s));
+    const __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(p0, p1), p2), _mm256_set1_ps(G3));
+    const __m256 x0 = _mm256_sub_ps(fx, _mm256_sub_ps(p0, t));
+    const __m256 y0 = _mm256_sub_ps(fy, _mm256_sub_ps(p1, t));
+    const __m256 z0 = _mm256_sub_ps(fz, _mm256_sub_ps(p2, t));
+    const __m256i xy = greater(x0, y0), xz = greater(x0, z0), yz = greater(y0, z0);
+    const __m256i rx = _mm256_add_epi32(xy, xz);
+    const __m256i ry = _mm256_add_epi32(_mm256_sub_epi32(one, xy), yz);
+    const __m256i rz = _mm256_sub_epi32(_mm256_set1_epi32(2), _mm256_add_epi32(xz, yz));
+    const __m256i i1 = atLeast(rx, 2), j1 = atLeast(ry, 2), k1 = atLeast(rz, 2);
+    const __m256i i2 = atLeast(rx, 1), j2 = atLeast(ry, 1), k2 = atLeast(rz, 1);
+    const __m256 x1 = offset(x0, i1, G3), y1 = offset(y0, j1, G3), z1 = offset(z0, k1, G3);
+    const __m256 x2 = offset(x0, i2, 2.0f*G3), y2 = offset(y0, j2, 2.0f*G3), z2 = offset(z0, k2, 2.0f*G3);
+    const __m256 x3 = offset(x0, one, 3.0f*G3), y3 = offset(y0, one, 3.0f*G3), z3 = offset(z0, one, 3.0f*G3);
+    const __m256i l0 = wrap256(p0), l1 = wrap256(p1), l2 = wrap256(p2);
+    const __m256 n0 = corner3(hash3(perm, l0, l1, l2, zero, zero, zero), x0, y0, z0);
+    const __m256 n1 = corner3(hash3(perm, l0, l1, l2, i1, j1, k1), x1, y1, z1);
+    const __m256 n2 = corner3(hash3(perm, l0, l1, l2, i2, j2, k2), x2, y2, z2);
+    const __m256 n3 = corner3(hash3(perm, l0, l1, l2, one, one, one), x3, y3, z3);
+    const __m256 n = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), n3);
+    return _mm256_mul_ps(_mm256_set1_ps(Scale3), n);
+}
+
+// perm[l0 + a + perm[l1 + b + perm[l2 + c + perm[l3 + d]]]]
+static inline __m256i hash4(const uint8_t* perm, const __m256i l[4], __m256i a, __m256i b, __m256i c, __m256i d)
+{
+    __m256i h = lookup(perm, _mm256_add_epi32(l[3], d));
+    h = lookup(perm, _mm256_add_epi32(_mm256_add_epi32(l[2], c), h));
+    h = lookup(perm, _mm256_add_epi32(_mm256_add_epi32(l[1], b), h));
+    return lookup(perm, _mm256_add_epi32(_mm256_add_epi32(l[0], a), h));
+}
+
+static __m256 simplex4d8(const uint8_t* perm, __m256 fx, __m256 fy, __m256 fz, __m256 fw)
+{
+    const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi32(1);
+    const __m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(fx, fy), fz), fw), _mm256_set1_ps(F4));
+    const __m256 p0 = _mm256_floor_ps(_mm256_add_ps(fx, s));
+    const __m256 p1 = _mm256_floor_ps(_mm256_add_ps(fy, s));
+    const __m256 p2 = _mm256_floor_ps(_mm256_add_ps(fz, s));
+    const __m256 p3 = _mm256_floor_ps(_mm256_add_ps(fw, s));
+    const __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(p0, p1), p2), p3), _mm256_set1_ps(G4));
+    const __m256 x0 = _mm256_sub_ps(fx, _mm256_sub_ps(p0, t));
+    const __m256 y0 = _mm256_sub_ps(fy, _mm256_sub_ps(p1, t));
+    const __m256 z0 = _mm256_sub_ps(fz, _mm256_sub_ps(p2, t));
+    const __m256 w0 = _mm256_sub_ps(fw, _mm256_sub_ps(p3, t));
+    const __m256i xy = greater(x0, y0), xz = greater(x0, z0), xw = greater(x0, w0);
+    const __m256i yz = greater(y0, z0), yw = greater(y0, w0), zw = greater(z0, w0);
+    const __m256i rx = _mm256_add_epi32(_mm256_add_epi32(xy, xz), xw);
+    const __m256i ry = _mm256_add_epi32(_mm256_sub_epi32(one, xy), _mm256_add_epi32(yz, yw));
+    const __m256i rz = _mm256_add_epi32(_mm256_sub_epi32(_mm256_set1_epi32(2), _mm256_add_epi32(xz, yz)), zw);
+    const __m256i rw = _mm256_sub_epi32(_mm256_set1_epi32(3), _mm256_add_epi32(_mm256_add_epi32(xw, yw), zw));
+    const __m256i i1 = atLeast(rx, 3), j1 = atLeast(ry, 3), k1 = atLeast(rz, 3), m1 = atLeast(rw, 3);
+    const __m256i i2 = atLeast(rx, 2), j2 = atLeast(ry, 2), k2 = atLeast(rz, 2), m2 = atLeast(rw, 2);
+    const __m256i i3 = atLeast(rx, 1), j3 = atLeast(ry, 1), k3 = atLeast(rz, 1), m3 = atLeast(rw, 1);
+    const __m256i l[4] = { wrap256(p0), wrap256(p1), wrap256(p2), wrap256(p3) };
+    const __m256 n0 = corner4(hash4(perm, l, zero, zero, zero, zero), x0, y0, z0, w0);
+    const __m256 n1 = corner4(hash4(perm, l, i1, j1, k1, m1),
+        offset(x0, i1, G4), offset(y0, j1, G4), offset(z0, k1, G4), offset(w0, m1, G4));
+    const __m256 n2 = corner4(hash4(perm, l, i2, j2, k2, m2),
+        offset(x0, i2, 2.0f*G4), offset(y0, j2, 2.0f*G4), offset(z0, k2, 2.0f*G4), offset(w0, m2, 2.0f*G4));
+    const __m256 n3 = corner4(hash4(perm, l, i3, j3, k3, m3),
+        offset(x0, i3, 3.0f*G4), offset(y0, j3, 3.0f*G4), offset(z0, k3, 3.0f*G4), offset(w0, m3, 3.0f*G4));
+    const __m256 n4 = corner4(hash4(perm, l, one, one, one, one),
+        offset(x0, one, 4.0f*G4), offset(y0, one, 4.0f*G4), offset(z0, one, 4.0f*G4), offset(w0, one, 4.0f*G4));
+    const __m256 n = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), n3), n4);
+    return _mm256_mul_ps(_mm256_set1_ps(Scale4), n);
+}
+
+// x0 + (i..i+7)*dx, same as the scalar expression per element.
+static inline __m256 ramp(float x0, float dx, size_t i)
+{
+    const __m256 k = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)),
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    return _mm256_add_ps(_mm256_set1_ps(x0), _mm256_mul_ps(k, _mm256_set1_ps(dx)));
+}
+#endif
+
+void SimplexNoise::noise2dBatch(const float* x, const float* y, float* out, size_t count) const
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, simplex2d8(perm, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+#endif
+    for (; i < count; ++i)
+        out[i] = noise2d(x[i], y[i]);
+}
+
+void SimplexNoise::noise3dBatch(const float* x, const float* y, const float* z, float* out, size_t count) const
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, simplex3d8(perm, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i)));
+#endif
+    for (; i < count; ++i)
+        out[i] = noise3d(x[i], y[i], z[i]);
+}
+
+void SimplexNoise::noise4dBatch(const float* x, const float* y, const float* z, const float* w,
+    float* out, size_t count) const
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, simplex4d8(perm, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i),
+            _mm256_loadu_ps(z + i), _mm256_loadu_ps(w + i)));
+#endif
+    for (; i < count; ++i)
+        out[i] = noise4d(x[i], y[i], z[i], w[i]);
+}
+
+void SimplexNoise::noise2dGrid(float x0, float y0, float dx, float dy, size_t width, size_t height, float* out) const
+{
+    for (size_t j = 0; j < height; ++j, out += width)
+    {
+        const float y = y0 + j*dy;
+        size_t i = 0;
+#if defined(__AVX2__)
+        for (; i + 8 <= width; i += 8)
+            _mm256_storeu_ps(out + i, simplex2d8(perm, ramp(x0, dx, i), _mm256_set1_ps(y)));
+#endif
+        for (; i < width; ++i)
+            out[i] = noise2d(x0 + i*dx, y);
+    }
+}
+
+void SimplexNoise::noise3dGrid(float x0, float y0, float z0, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out) const
+{
+    for (size_t k = 0; k < depth; ++k)
+    {
+        const float z = z0 + k*dz;
+        for (size_t j = 0; j < height; ++j, out += width)
+        {
+            const float y = y0 + j*dy;
+            size_t i = 0;
+#if defined(__AVX2__)
+            for (; i + 8 <= width; i += 8)
+                _mm256_storeu_ps(out + i, simplex3d8(perm, ramp(x0, dx, i), _mm256_set1_ps(y), _mm256_set1_ps(z)));
+#endif
+            for (; i < width; ++i)
+                out[i] = noise3d(x0 + i*dx, y, z);
+        }
+    }
+}
+
+void SimplexNoise::noise4dGrid(float x0, float y0, float z0, float w, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out) const
+{
+    for (size_t k = 0; k < depth; ++k)
+    {
+        const float z = z0 + k*dz;
+        for (size_t j = 0; j < height; ++j, out += width)
+        {
+            const float y = y0 + j*dy;
+            size_t i = 0;
+#if defined(__AVX2__)
+            for (; i + 8 <= width; i += 8)
+                _mm256_storeu_ps(out + i, simplex4d8(perm, ramp(x0, dx, i), _mm256_set1_ps(y),
+                    _mm256_set1_ps(z), _mm256_set1_ps(w)));
+#endif
+            for (; i < width; ++i)
+                out[i] = noise4d(x0 + i*dx, y, z, w);
+        }
+    }
+}
+
+float simplex2d(float fx, float fy)
+{
+    return SimplexNoise::global().noise2d(fx, fy);
+}
+
+float simplex3d(float fx, float fy, float fz)
+{
+    return SimplexNoise::global().noise3d(fx, fy, fz);
+}
+
+float simplex4d(float fx, float fy, float fz, float fw)
+{
+    return SimplexNoise::global().noise4d(fx, fy, fz, fw);
+}
+
+void simplex2dBatch(const float* x, const float* y, float* out, size_t count)
+{
+    SimplexNoise::global().noise2dBatch(x, y, out, count);
+}
+
+void simplex3dBatch(const float* x, const float* y, const float* z, float* out, size_t count)
+{
+    SimplexNoise::global().noise3dBatch(x, y, z, out, count);
+}
+
+void simplex4dBatch(const float* x, const float* y, const float* z, const float* w, float* out, size_t count)
+{
+    SimplexNoise::global().noise4dBatch(x, y, z, w, out, count);
+}
+
+void simplex2dGrid(float x0, float y0, float dx, float dy, size_t width, size_t height, float* out)
+{
+    SimplexNoise::global().noise2dGrid(x0, y0, dx, dy, width, height, out);
+}
+
+void simplex3dGrid(float x0, float y0, float z0, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out)
+{
+    SimplexNoise::global().noise3dGrid(x0, y0, z0, dx, dy, dz, width, height, depth, out);
+}
+
+void simplex4dGrid(float x0, float y0, float z0, float w, float dx, float dy, float dz,
+    size_t width, size_t height, size_t depth, float* out)
+{
+    SimplexNoise::global().noise4dGrid(x0, y0, z0, w, dx, dy, dz, width, height, depth, out);
+}
@@ -0,0 +1,123 @@
+// Simple persistent thread pool
+// Copyright (C) 2019 Tomasz Dobrowolski
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <threadPool.h>
+
+#include <algorithm>
+
+static thread_local bool insidePool = false;
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : task(nullptr)
+    , taskCount(0)
+    , taskGrain(1)
+    , nextItem(0)
+    , pending(0)
+    , generation(0)
+    , stop(false)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 1; i < threadCount; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::runChunks()
+{
+    for (;;)
+    {
+        size_t begin;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            begin = nextItem;
+            if (begin >= taskCount)
+                return;
+            nextItem = std::min(taskCount, begin + taskGrain);
+        }
+        (*task)(begin, std::min(taskCount, begin + taskGrain));
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    insidePool = true;
+    uint64_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stop || generation != seen; });
+            if (stop)
+                return;
+            seen = generation;
+        }
+        runChunks();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0)
+                finished.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const Task& fn)
+{
+    if (count == 0)
+        return;
+    grain = std::max<size_t>(grain, 1);
+    if (workers.empty() || count <= grain || insidePool)
+    {
+        fn(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> serial(submitMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &fn;
+        taskCount = count;
+        taskGrain = grain;
+        nextItem = 0;
+        pending = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    insidePool = true;
+    runChunks();
+    insidePool = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return pending == 0; });
+    task = nullptr;
+}